@@ -0,0 +1,339 @@
+/* bench.c
+ *
+ * Time reading and solving synthetic MDPs of increasing size, reporting
+ * one CSV or JSON record per model and task so that runs can be compared
+ * to catch performance regressions.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "mdp.h"
+#include "generate.h"
+#include "sweep.h"
+#include "policy_evaluation.h"
+#include "solver.h"
+
+/* Tasks timed for each model */
+static const char * const tasks[] =
+  { "read", "value", "policy", "evaluation" };
+
+#define NUM_TASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+/* Settings shared by every run */
+typedef struct {
+  double gamma;
+  double epsilon;
+  unsigned long seed;
+  int json;
+} bench_config;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*  Procedure
+ *    bench_generate
+ *
+ *  Purpose
+ *    Construct the MDP named by a model specification
+ *
+ *  Parameters
+ *   spec
+ *   seed
+ *
+ *  Produces
+ *   p_mdp, an mdp*
+ *
+ *  Postconditions
+ *    p_mdp is built from spec, which is one of grid:W:H,
+ *    random:STATES:ACTIONS:BRANCHING or chain:STATES, or is NULL when
+ *    spec is malformed
+ */
+static mdp* bench_generate( const char* spec, unsigned long seed )
+{
+  unsigned int a, b, c;
+  char tail;
+
+  if (2 == sscanf(spec, "grid:%u:%u%c", &a, &b, &tail) && a > 0 && b > 0)
+    return mdp_generate_grid(a, b);
+
+  if (3 == sscanf(spec, "random:%u:%u:%u%c", &a, &b, &c, &tail) &&
+      a > 0 && b > 0 && c > 0 && c <= a)
+    return mdp_generate_random(a, b, c, seed);
+
+  if (1 == sscanf(spec, "chain:%u%c", &a, &tail) && a > 1)
+    return mdp_generate_chain(a);
+
+  return NULL;
+}
+
+/*  Procedure
+ *    bench_read
+ *
+ *  Purpose
+ *    Time reading a model back from a sparse text file
+ *
+ *  Parameters
+ *   p_mdp
+ *
+ *  Produces
+ *   seconds, a double
+ *
+ *  Postconditions
+ *    The temporary file is removed
+ */
+static double bench_read( const mdp* p_mdp )
+{
+  char fileName[] = "/tmp/bench_XXXXXX";
+  double start, seconds;
+  mdp *p_read;
+  FILE *stream;
+  int fd;
+
+  fd = mkstemp(fileName);
+
+  if (fd < 0 || NULL == (stream = fdopen(fd, "w")))
+  {
+    fprintf(stderr, "bench: Unable to create %s (%s)\n",
+	    fileName, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  mdp_write_sparse(p_mdp, stream);
+  fclose(stream);
+
+  start = now();
+  p_read = mdp_read(fileName);
+  seconds = now() - start;
+
+  mdp_free(p_read);
+  unlink(fileName);
+
+  return seconds;
+}
+
+/*  Procedure
+ *    bench_task
+ *
+ *  Purpose
+ *    Run one task on one model and print its record
+ *
+ *  Parameters
+ *   spec
+ *   task
+ *   p_config
+ *   first
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    One record is printed to stdout, preceded by a separator unless
+ *    first is nonzero. Peak RSS is that of the calling process, so the
+ *    caller should be a fresh process per task.
+ */
+static void bench_task( const char* spec, const char* task,
+			const bench_config* p_config, int first )
+{
+  double start, seconds, *utilities;
+  unsigned int *policy;
+  unsigned long backups;
+  struct rusage usage;
+  mdp *p_mdp;
+
+  p_mdp = bench_generate(spec, p_config->seed);
+
+  utilities = calloc(p_mdp->numStates, sizeof(double));
+  policy = calloc(p_mdp->numStates, sizeof(unsigned int));
+
+  if (NULL == utilities || NULL == policy)
+  {
+    fprintf(stderr, "bench: Unable to allocate utilities (%s)\n",
+	    strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  randomize_policy(p_mdp, policy);
+
+  backups = 0;
+  start = now();
+
+  if (0 == strcmp(task, "read"))
+    seconds = bench_read(p_mdp);
+  else
+  {
+    if (0 == strcmp(task, "value"))
+      backups = value_iteration(NULL, p_mdp, p_config->epsilon, 
+				p_config->gamma, utilities, SWEEP_JACOBI, 
+				NULL, NULL);
+    else if (0 == strcmp(task, "policy"))
+      backups = policy_iteration(NULL, p_mdp, p_config->epsilon, 
+				 p_config->gamma, policy, SWEEP_JACOBI, 0, 0, 
+				 NULL, NULL);
+    else
+      backups = policy_evaluation(policy, p_mdp, p_config->epsilon,
+				  p_config->gamma, utilities, SWEEP_JACOBI, 
+				  NULL, NULL, NULL);
+
+    seconds = now() - start;
+  }
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  if (p_config->json)
+    printf("%s  {\"model\": \"%s\", \"states\": %u, \"actions\": %u, "
+	   "\"transitions\": %u, \"gamma\": %g, \"task\": \"%s\", "
+	   "\"seconds\": %.6f, \"backups\": %lu, \"sweeps\": %.1f, "
+	   "\"backups_per_sec\": %.0f, \"peak_rss_kb\": %ld}",
+	   first ? "" : ",\n", spec, p_mdp->numStates, p_mdp->numActions,
+	   p_mdp->numTransitions, p_config->gamma, task, seconds, backups,
+	   (double)backups / p_mdp->numStates,
+	   seconds > 0 ? backups / seconds : 0, usage.ru_maxrss);
+  else
+    printf("%s,%u,%u,%u,%g,%s,%.6f,%lu,%.1f,%.0f,%ld\n",
+	   spec, p_mdp->numStates, p_mdp->numActions, p_mdp->numTransitions,
+	   p_config->gamma, task, seconds, backups,
+	   (double)backups / p_mdp->numStates,
+	   seconds > 0 ? backups / seconds : 0, usage.ru_maxrss);
+
+  fflush(stdout);
+
+  free(utilities);
+  free(policy);
+  mdp_free(p_mdp);
+}
+
+/*
+ * Main: bench [-f csv|json] [-g gamma] [-e epsilon] [-s seed] [model ...]
+ *
+ * Runs every task (read, value, policy, evaluation) on each model, given
+ * as grid:W:H, random:STATES:ACTIONS:BRANCHING or chain:STATES, or on a
+ * default set of sizes. Each run happens in its own process so that peak
+ * RSS is per run. Sweeps count backups in units of the number of states.
+ * Solvers use Jacobi updates in one thread; policy and evaluation start
+ * from the same random policy.
+ */
+int main(int argc, char* argv[])
+{
+  static const char * const models[] =
+    { "grid:32:32", "grid:128:128", "random:10000:4:8", "random:40000:4:8",
+      "chain:1000", "chain:4000" };
+  static const unsigned int numModels = sizeof(models) / sizeof(models[0]);
+
+  bench_config config = { 0.99, 0.001, 1, 0 };
+  const char * const * specs;
+  unsigned int numSpecs, i, t, first;
+  int opt, bad_option = 0, status;
+  char* endptr;
+  mdp *p_mdp;
+  pid_t child;
+
+  while ((opt = getopt(argc, argv, "f:g:e:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'f':
+      config.json = (0 == strcmp(optarg, "json"));
+      bad_option |= !config.json && (0 != strcmp(optarg, "csv"));
+      break;
+    case 'g':
+      config.gamma = strtod(optarg, &endptr);
+      bad_option |= ('\0' != *endptr || config.gamma <= 0 ||
+		     config.gamma >= 1);
+      break;
+    case 'e':
+      config.epsilon = strtod(optarg, &endptr);
+      bad_option |= ('\0' != *endptr || config.epsilon <= 0);
+      break;
+    case 's':
+      config.seed = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      bad_option = 1;
+    }
+  }
+
+  if (optind < argc)
+  {
+    specs = (const char * const *)(argv + optind);
+    numSpecs = argc - optind;
+  }
+  else
+  {
+    specs = models;
+    numSpecs = numModels;
+  }
+
+  // Check every model before running anything
+  for (i = 0 ; i < numSpecs && !bad_option ; i++)
+  {
+    p_mdp = bench_generate(specs[i], config.seed);
+
+    if (NULL == p_mdp)
+    {
+      fprintf(stderr, "%s: Unrecognized model %s\n", argv[0], specs[i]);
+      bad_option = 1;
+    }
+    else
+      mdp_free(p_mdp);
+  }
+
+  if (bad_option)
+  {
+    fprintf(stderr,
+	    "Usage: %s [-f csv|json] [-g gamma] [-e epsilon] [-s seed] "
+	    "[model ...]\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  if (config.json)
+    printf("[\n");
+  else
+    printf("model,states,actions,transitions,gamma,task,seconds,backups,"
+	   "sweeps,backups_per_sec,peak_rss_kb\n");
+
+  fflush(stdout);
+  first = 1;
+
+  for (i = 0 ; i < numSpecs ; i++)
+    for (t = 0 ; t < NUM_TASKS ; t++)
+    {
+      child = fork();
+
+      if (child < 0)
+      {
+	fprintf(stderr, "%s: Unable to fork (%s)\n", argv[0], strerror(errno));
+	exit(EXIT_FAILURE);
+      }
+      else if (0 == child)
+      {
+	bench_task(specs[i], tasks[t], &config, first);
+	exit(EXIT_SUCCESS);
+      }
+
+      if (child != waitpid(child, &status, 0) || !WIFEXITED(status) ||
+	  EXIT_SUCCESS != WEXITSTATUS(status))
+      {
+	fprintf(stderr, "%s: %s on %s failed\n", argv[0], tasks[t], specs[i]);
+	exit(EXIT_FAILURE);
+      }
+
+      first = 0;
+    }
+
+  if (config.json)
+    printf("\n]\n");
+
+  exit(EXIT_SUCCESS);
+}
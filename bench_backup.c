@@ -0,0 +1,166 @@
+/* bench_backup.c
+ *
+ * Time a single Bellman backup (calc_meu) under each available
+ * expected-utility kernel and transition storage, on MDP files and on
+ * synthetic grid worlds.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "mdp.h"
+#include "utilities.h"
+#include "generate.h"
+
+// Minimum measured time per kernel, in seconds
+#define MIN_SECONDS 0.25
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*  Procedure
+ *    bench_model
+ *
+ *  Purpose
+ *    Report nanoseconds per backup for each kernel and transition
+ *    storage on one model
+ *
+ *  Parameters
+ *   name
+ *   p_mdp
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid, complete mdp
+ *
+ *  Postconditions
+ *    One line per supported kernel and storage is printed to stdout,
+ *    giving the largest difference of any backup from the one computed
+ *    with double storage. p_mdp is left with double storage.
+ */
+static void bench_model( const char* name, mdp* p_mdp )
+{
+  static const char* kernels[] = { "scalar", "avx2", "avx512" };
+  static const char* storages[] = { "double", "float", "palette" };
+
+  double *utilities, *reference, meu, checksum, start, elapsed, error;
+  unsigned int state, action, k, p;
+  unsigned long sweeps;
+  mdp_precision precision;
+
+  utilities = malloc( sizeof(double) * p_mdp->numStates );
+  reference = malloc( sizeof(double) * p_mdp->numStates );
+
+  if (NULL == utilities || NULL == reference)
+  {
+    fprintf(stderr, "bench_backup: Unable to allocate utilities\n");
+    exit(EXIT_FAILURE);
+  }
+
+  srandom(42);
+  for (state = 0 ; state < p_mdp->numStates ; state++)
+    utilities[state] = (double)random() / RAND_MAX;
+
+  // Backups with double storage, which the others are checked against
+  for (state = 0 ; state < p_mdp->numStates ; state++)
+    calc_meu(p_mdp, state, utilities, reference + state, &action);
+
+  for (p = 0 ; p < sizeof(storages) / sizeof(storages[0]) ; p++)
+  {
+    mdp_precision_parse(storages[p], &precision);
+
+    if (!mdp_set_precision(p_mdp, precision, NULL))
+      continue; // Too many distinct probabilities for a palette
+
+    error = 0;
+    for (state = 0 ; state < p_mdp->numStates ; state++)
+    {
+      calc_meu(p_mdp, state, utilities, &meu, &action);
+
+      if (fabs(meu - reference[state]) > error)
+	error = fabs(meu - reference[state]);
+    }
+
+    for (k = 0 ; k < sizeof(kernels) / sizeof(kernels[0]) ; k++)
+    {
+      if (!calc_set_kernel(kernels[k]))
+	continue;
+
+      sweeps = 0;
+      checksum = 0;
+      start = now();
+
+      do
+      {
+	for (state = 0 ; state < p_mdp->numStates ; state++)
+	{
+	  calc_meu(p_mdp, state, utilities, &meu, &action);
+	  checksum += meu;
+	}
+	sweeps++;
+	elapsed = now() - start;
+      } while (elapsed < MIN_SECONDS);
+
+      printf("%-16s %10u %12u %-8s %-8s %10.2f %16.6f %10.3g\n",
+	     name, p_mdp->numStates, p_mdp->numTransitions, kernels[k],
+	     storages[p], elapsed * 1e9 / ((double)sweeps * p_mdp->numStates),
+	     checksum / sweeps, error);
+    }
+
+    calc_set_kernel(NULL);
+  }
+
+  mdp_set_precision(p_mdp, MDP_PRECISION_DOUBLE, NULL);
+  free(utilities);
+  free(reference);
+}
+
+/*
+ * Main: bench_backup [mdpfile ...]
+ *
+ * Times calc_meu on each mdpfile, then on synthetic grid worlds. Float
+ * and palette storage are checked against double storage: max_error is
+ * the largest difference of a backup from its double counterpart.
+ */
+int main(int argc, char* argv[])
+{
+  static const unsigned int sides[] = { 32, 128, 512, 1024 };
+
+  char name[32];
+  unsigned int i;
+  mdp *p_mdp;
+
+  printf("%-16s %10s %12s %-8s %-8s %10s %16s %10s\n",
+	 "model", "states", "transitions", "kernel", "storage", "ns/backup",
+	 "checksum", "max_error");
+
+  for (i = 1 ; i < argc ; i++)
+  {
+    p_mdp = mdp_read(argv[i]);
+
+    if (NULL == p_mdp)
+      exit(EXIT_FAILURE); // mdp_read prints a message
+
+    bench_model(argv[i], p_mdp);
+    mdp_free(p_mdp);
+  }
+
+  for (i = 0 ; i < sizeof(sides) / sizeof(sides[0]) ; i++)
+  {
+    snprintf(name, sizeof(name), "grid%ux%u", sides[i], sides[i]);
+    p_mdp = mdp_generate_grid(sides[i], sides[i]);
+    bench_model(name, p_mdp);
+    mdp_free(p_mdp);
+  }
+
+  exit(EXIT_SUCCESS);
+}
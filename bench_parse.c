@@ -0,0 +1,173 @@
+/* bench_parse.c
+ *
+ * Measure the throughput of reading text MDP files with mdp_read,
+ * against a plain fscanf loop over the same tokens and against loading
+ * the binary form of the same model.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mdp.h"
+#include "generate.h"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*  Procedure
+ *    time_fscanf
+ *
+ *  Purpose
+ *    Time reading every token of a file with fscanf("%lf")
+ *
+ *  Parameters
+ *   fileName
+ *
+ *  Produces
+ *   seconds, a double
+ */
+static double time_fscanf( const char* fileName )
+{
+  FILE *stream;
+  double value, start;
+
+  start = now();
+  stream = fopen(fileName, "r");
+
+  while (1 == fscanf(stream, "%lf", &value))
+    ;
+
+  fclose(stream);
+
+  return now() - start;
+}
+
+/*  Procedure
+ *    bench_file
+ *
+ *  Purpose
+ *    Report parse throughput for one generated grid world
+ *
+ *  Parameters
+ *   side
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    One line of results is printed to stdout; temporary files are removed
+ */
+static void bench_file( unsigned int side )
+{
+  char textName[] = "/tmp/bench_parse_XXXXXX";
+  char binaryName[sizeof(textName) + 4];
+  struct stat info;
+  double megabytes, scanf_seconds, read_seconds, map_seconds, start;
+  mdp *p_mdp;
+  FILE *stream;
+  int fd;
+
+  fd = mkstemp(textName);
+
+  if (fd < 0 || NULL == (stream = fdopen(fd, "w")))
+  {
+    fprintf(stderr, "bench_parse: Unable to create %s (%s)\n", 
+	    textName, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  p_mdp = mdp_generate_grid(side, side);
+  mdp_write(p_mdp, stream);
+  fclose(stream);
+
+  snprintf(binaryName, sizeof(binaryName), "%s.bin", textName);
+  mdp_write_binary(p_mdp, binaryName);
+  mdp_free(p_mdp);
+
+  stat(textName, &info);
+  megabytes = info.st_size / 1e6;
+
+  scanf_seconds = time_fscanf(textName);
+
+  start = now();
+  p_mdp = mdp_read(textName);
+  read_seconds = now() - start;
+
+  if (NULL == p_mdp)
+  { // mdp_read prints a message
+    unlink(textName);
+    unlink(binaryName);
+    exit(EXIT_FAILURE);
+  }
+
+  mdp_free(p_mdp);
+
+  start = now();
+  p_mdp = mdp_read(binaryName);
+  map_seconds = now() - start;
+
+  if (NULL == p_mdp)
+  {
+    unlink(textName);
+    unlink(binaryName);
+    exit(EXIT_FAILURE);
+  }
+
+  mdp_free(p_mdp);
+
+  printf("grid%ux%-8u %10.1f %12.1f %14.1f %12.3f\n", side, side, megabytes,
+	 megabytes / scanf_seconds, megabytes / read_seconds,
+	 map_seconds * 1e3);
+
+  unlink(textName);
+  unlink(binaryName);
+}
+
+/*
+ * Main: bench_parse [side ...]
+ *
+ * Generates square grid worlds with the given side lengths (positive
+ * integers; by default 20, 40 and 60) in text form and reports parse
+ * throughput.
+ */
+int main(int argc, char* argv[])
+{
+  static const unsigned int sides[] = { 20, 40, 60 };
+  unsigned int side;
+  char tail;
+  int i;
+
+  // Check every side before timing any
+  for (i = 1 ; i < argc ; i++)
+    if ('-' == argv[i][0] || 
+	1 != sscanf(argv[i], "%u%c", &side, &tail) || 0 == side)
+    {
+      fprintf(stderr, "%s: Illegal side %s\n", argv[0], argv[i]);
+      fprintf(stderr, "Usage: %s [side ...]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+
+  printf("%-16s %10s %12s %14s %12s\n", 
+	 "model", "MB", "fscanf MB/s", "mdp_read MB/s", "binary ms");
+
+  if (argc > 1)
+    for (i = 1 ; i < argc ; i++)
+    {
+      sscanf(argv[i], "%u", &side);
+      bench_file(side);
+    }
+  else
+    for (i = 0 ; i < sizeof(sides) / sizeof(sides[0]) ; i++)
+      bench_file(sides[i]);
+
+  exit(EXIT_SUCCESS);
+}
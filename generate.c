@@ -0,0 +1,406 @@
+/* generate.c
+ *
+ * Implementation of procedures that construct synthetic MDPs in memory.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "mdp.h"
+#include "lazy.h"
+#include "random.h"
+#include "generate.h"
+
+/*  Procedure
+ *    grid_successors
+ *
+ *  Purpose
+ *    List the successors of a grid world state and action
+ *
+ *  Parameters
+ *   width
+ *   height
+ *   state
+ *   action
+ *   successor
+ *   prob
+ *
+ *  Produces
+ *   count, an unsigned int
+ *
+ *  Preconditions
+ *    0 <= state < width*height, 0 <= action < 4
+ *    successor and prob point to arrays of length at least 3
+ *
+ *  Postconditions
+ *    successor[0..count-1] are distinct, ascending successor states with
+ *    nonzero probabilities prob[0..count-1] summing to one.
+ */
+static unsigned int grid_successors( unsigned int width, unsigned int height,
+				     unsigned int state, unsigned int action,
+				     unsigned int *successor, double *prob )
+{
+  // Offsets for up, down, left, right, and the perpendiculars of each
+  static const int dx[4] = { 0, 0, -1, 1 };
+  static const int dy[4] = { -1, 1, 0, 0 };
+  static const unsigned int side[4][2] = { {2,3}, {2,3}, {0,1}, {0,1} };
+
+  unsigned int moves[3] = { action, side[action][0], side[action][1] };
+  double moveProb[3] = { 0.8, 0.1, 0.1 };
+
+  unsigned int count, i, j, target;
+  int x, y, nx, ny;
+
+  x = state / height;
+  y = state % height;
+  count = 0;
+
+  for (i = 0 ; i < 3 ; i++)
+  {
+    nx = x + dx[moves[i]];
+    ny = y + dy[moves[i]];
+
+    // Bumping into a wall leaves the agent in place
+    if (nx < 0 || nx >= (int)width || ny < 0 || ny >= (int)height)
+      target = state;
+    else
+      target = nx * height + ny;
+
+    // Merge with an existing successor, or insert in ascending order
+    for (j = 0 ; j < count && successor[j] < target ; j++)
+      ;
+
+    if (j < count && successor[j] == target)
+      prob[j] += moveProb[i];
+    else
+    {
+      unsigned int k;
+      for (k = count ; k > j ; k--)
+      {
+	successor[k] = successor[k-1];
+	prob[k] = prob[k-1];
+      }
+      successor[j] = target;
+      prob[j] = moveProb[i];
+      count++;
+    }
+  }
+
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+mdp* mdp_generate_grid( unsigned int width, unsigned int height )
+{
+  const unsigned int numActions = 4;
+  unsigned int numStates, state, action, goal, pit, entry, count, i;
+  unsigned int successor[3];
+  double prob[3];
+  mdp* p_mdp;
+
+  numStates = width * height;
+  p_mdp = mdp_malloc(numStates, numActions);
+
+  p_mdp->numStates = numStates;
+  p_mdp->numActions = numActions;
+  p_mdp->start = height - 1;
+
+  goal = (width - 1) * height;
+  pit = (height > 1) ? goal + 1 : goal;
+
+  for (state = 0 ; state < numStates ; state++)
+  {
+    p_mdp->rewards[state] = -0.04;
+    p_mdp->numAvailableActions[state] = numActions;
+  }
+
+  p_mdp->rewards[goal] = 1.0;
+  p_mdp->terminal[goal] = 1;
+  p_mdp->numAvailableActions[goal] = 0;
+
+  if (pit != goal)
+  {
+    p_mdp->rewards[pit] = -1.0;
+    p_mdp->terminal[pit] = 1;
+    p_mdp->numAvailableActions[pit] = 0;
+  }
+
+  // Every non-terminal state offers every action
+  mdp_malloc_actions(p_mdp);
+
+  for (state = 0 ; state < numStates ; state++)
+    for (i = 0 ; i < p_mdp->numAvailableActions[state] ; i++)
+      p_mdp->actions[state][i] = i;
+
+  // Count transitions to size the rows, then fill them
+  entry = 0;
+  for (state = 0 ; state < numStates ; state++)
+    for (action = 0 ; action < numActions ; action++)
+    {
+      p_mdp->transitionStart[state * numActions + action] = entry;
+      if (!p_mdp->terminal[state])
+	entry += grid_successors(width, height, state, action, successor, prob);
+    }
+  p_mdp->transitionStart[numStates * numActions] = entry;
+
+  p_mdp->numTransitions = entry;
+  mdp_malloc_successors(p_mdp);
+
+  for (state = 0 ; state < numStates ; state++)
+    for (action = 0 ; action < numActions ; action++)
+    {
+      if (p_mdp->terminal[state])
+	continue;
+
+      entry = p_mdp->transitionStart[state * numActions + action];
+      count = grid_successors(width, height, state, action, successor, prob);
+
+      for (i = 0 ; i < count ; i++)
+      {
+	p_mdp->successor[entry + i] = successor[i];
+	p_mdp->transitionProb[entry + i] = prob[i];
+      }
+    }
+
+  return p_mdp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+mdp* mdp_generate_random( unsigned int numStates, unsigned int numActions,
+			  unsigned int branching, unsigned long seed )
+{
+  unsigned int state, action, row, entry, first, i, j, target;
+  unsigned long long rng;
+  double total;
+  mdp* p_mdp;
+
+  rng = seed;
+
+  p_mdp = mdp_malloc(numStates, numActions);
+
+  p_mdp->numStates = numStates;
+  p_mdp->numActions = numActions;
+  p_mdp->start = 0;
+
+  for (state = 0 ; state < numStates ; state++)
+  {
+    p_mdp->rewards[state] = 2 * random_uniform(&rng) - 1;
+    p_mdp->numAvailableActions[state] = numActions;
+  }
+
+  mdp_malloc_actions(p_mdp);
+
+  for (state = 0 ; state < numStates ; state++)
+    for (action = 0 ; action < numActions ; action++)
+      p_mdp->actions[state][action] = action;
+
+  // Every row has exactly branching entries
+  p_mdp->numTransitions = numStates * numActions * branching;
+
+  for (row = 0 ; row <= numStates * numActions ; row++)
+    p_mdp->transitionStart[row] = row * branching;
+
+  mdp_malloc_successors(p_mdp);
+
+  for (row = 0 ; row < numStates * numActions ; row++)
+  {
+    first = p_mdp->transitionStart[row];
+    entry = first;
+    total = 0;
+
+    while (entry < first + branching)
+    {
+      target = (unsigned int)(random_next(&rng) % numStates);
+
+      // Insert in ascending order, rejecting repeats
+      for (j = first ; j < entry && p_mdp->successor[j] < target ; j++)
+	;
+
+      if (j < entry && p_mdp->successor[j] == target)
+	continue;
+
+      for (i = entry ; i > j ; i--)
+	p_mdp->successor[i] = p_mdp->successor[i-1];
+
+      p_mdp->successor[j] = target;
+      entry++;
+    }
+
+    // Weights bounded away from zero, normalized to sum to one
+    for (i = first ; i < entry ; i++)
+    {
+      p_mdp->transitionProb[i] = 0.01 + random_uniform(&rng);
+      total += p_mdp->transitionProb[i];
+    }
+
+    for (i = first ; i < entry ; i++)
+      p_mdp->transitionProb[i] /= total;
+  }
+
+  return p_mdp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+mdp* mdp_generate_chain( unsigned int numStates )
+{
+  const unsigned int numActions = 2;
+  unsigned int state, row, entry, goal, target;
+  mdp* p_mdp;
+
+  p_mdp = mdp_malloc(numStates, numActions);
+
+  p_mdp->numStates = numStates;
+  p_mdp->numActions = numActions;
+  p_mdp->start = 0;
+
+  goal = numStates - 1;
+
+  for (state = 0 ; state < numStates ; state++)
+  {
+    p_mdp->rewards[state] = -0.04;
+    p_mdp->numAvailableActions[state] = numActions;
+  }
+
+  p_mdp->rewards[goal] = 1.0;
+  p_mdp->terminal[goal] = 1;
+  p_mdp->numAvailableActions[goal] = 0;
+
+  mdp_malloc_actions(p_mdp);
+
+  for (state = 0 ; state < goal ; state++)
+  {
+    p_mdp->actions[state][0] = 0;
+    p_mdp->actions[state][1] = 1;
+  }
+
+  // Left from state 0 has one successor; every other move has two
+  p_mdp->numTransitions = 4 * goal - 1;
+  mdp_malloc_successors(p_mdp);
+
+  entry = 0;
+
+  for (state = 0 ; state < numStates ; state++)
+    for (row = state * numActions ; row < (state + 1) * numActions ; row++)
+    {
+      p_mdp->transitionStart[row] = entry;
+
+      if (state == goal)
+	continue;
+
+      if (row % numActions == 0 && state == 0)
+      {
+	p_mdp->successor[entry] = 0;
+	p_mdp->transitionProb[entry++] = 1.0;
+	continue;
+      }
+
+      target = (row % numActions == 0) ? state - 1 : state + 1;
+
+      // Successors ascending: the move left precedes staying in place
+      if (target < state)
+      {
+	p_mdp->successor[entry] = target;
+	p_mdp->transitionProb[entry++] = 0.9;
+      }
+
+      p_mdp->successor[entry] = state;
+      p_mdp->transitionProb[entry++] = 0.1;
+
+      if (target > state)
+      {
+	p_mdp->successor[entry] = target;
+	p_mdp->transitionProb[entry++] = 0.9;
+      }
+    }
+
+  p_mdp->transitionStart[numStates * numActions] = entry;
+
+  return p_mdp;
+}
+
+/* Dimensions of a lazily generated grid world */
+typedef struct {
+  unsigned int width;
+  unsigned int height;
+  unsigned int goal;  /* Terminal state with reward +1 */
+  unsigned int pit;   /* Terminal state with reward -1 (goal if none) */
+} lazy_grid;
+
+// Callbacks of mdp_generate_lazy_grid, matching mdp_generate_grid
+
+static double lazy_grid_reward( const void* arg, unsigned int state )
+{
+  const lazy_grid *p_grid = arg;
+
+  if (state == p_grid->goal)
+    return 1.0;
+  else if (state == p_grid->pit)
+    return -1.0;
+  else
+    return -0.04;
+}
+
+static int lazy_grid_terminal( const void* arg, unsigned int state )
+{
+  const lazy_grid *p_grid = arg;
+
+  return state == p_grid->goal || state == p_grid->pit;
+}
+
+static unsigned int lazy_grid_actions( const void* arg, unsigned int state,
+				       unsigned int* actions )
+{
+  unsigned int action;
+
+  for (action = 0 ; action < 4 ; action++)
+    actions[action] = action;
+
+  return 4;
+}
+
+static unsigned int lazy_grid_successors( const void* arg, unsigned int state,
+					  unsigned int action,
+					  unsigned int* successor, double* prob )
+{
+  const lazy_grid *p_grid = arg;
+
+  return grid_successors(p_grid->width, p_grid->height, state, action,
+			 successor, prob);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+lazy_mdp* mdp_generate_lazy_grid( unsigned int width, unsigned int height )
+{
+  lazy_mdp *p_lazy;
+  lazy_grid *p_grid;
+
+  p_lazy = malloc(sizeof(lazy_mdp));
+  p_grid = malloc(sizeof(lazy_grid));
+
+  if (NULL == p_lazy || NULL == p_grid)
+  {
+    fprintf(stderr,"mdp_generate_lazy_grid failed: %s (%s)\n",
+	    "Could not allocate grid", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  p_grid->width = width;
+  p_grid->height = height;
+  p_grid->goal = (width - 1) * height;
+  p_grid->pit = (height > 1) ? p_grid->goal + 1 : p_grid->goal;
+
+  p_lazy->numStates = width * height;
+  p_lazy->numActions = 4;
+  p_lazy->start = height - 1;
+  p_lazy->maxSuccessors = 3;
+  p_lazy->reward = lazy_grid_reward;
+  p_lazy->terminal = lazy_grid_terminal;
+  p_lazy->actions = lazy_grid_actions;
+  p_lazy->successors = lazy_grid_successors;
+  p_lazy->arg = p_grid;
+  p_lazy->release = free;
+
+  return p_lazy;
+}
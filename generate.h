@@ -0,0 +1,126 @@
+/* generate.h
+ *
+ * Declarations for procedures that construct synthetic MDPs in memory,
+ * for benchmarking solvers on models larger than those we keep on disk.
+ *
+ */
+
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include "mdp.h"
+#include "lazy.h"
+
+/*  Procedure
+ *    mdp_generate_grid
+ *
+ *  Purpose
+ *    Construct a grid world in the style of 4x3.mdp
+ *
+ *  Parameters
+ *   width
+ *   height
+ *
+ *  Produces
+ *   p_mdp, an mdp*
+ *
+ *  Preconditions
+ *    width > 0
+ *    height > 0
+ *
+ *  Postconditions
+ *    p_mdp has width*height states, numbered column-major (state
+ *    x*height + y, with y=0 the top row), and four actions (0 up, 1 down,
+ *    2 left, 3 right). Each action moves in its direction with
+ *    probability 0.8 and to either perpendicular side with probability
+ *    0.1; moves off the grid leave the agent in place.
+ *    The top-right state is a terminal with reward +1; when height > 1
+ *    the state below it is a terminal with reward -1. All other states
+ *    have reward -0.04. The start is the bottom-left state.
+ *    Any failure causes program exit.
+ */
+mdp* mdp_generate_grid( unsigned int width, unsigned int height );
+
+/*  Procedure
+ *    mdp_generate_random
+ *
+ *  Purpose
+ *    Construct a random sparse MDP
+ *
+ *  Parameters
+ *   numStates
+ *   numActions
+ *   branching
+ *   seed
+ *
+ *  Produces
+ *   p_mdp, an mdp*
+ *
+ *  Preconditions
+ *    numStates > 0
+ *    numActions > 0
+ *    0 < branching <= numStates
+ *
+ *  Postconditions
+ *    Every action is available in every state and leads to branching
+ *    distinct successors chosen uniformly, with random probabilities.
+ *    Rewards are uniform on [-1,1]; no state is terminal. The start is
+ *    state 0. The same arguments always produce the same MDP.
+ *    Any failure causes program exit.
+ */
+mdp* mdp_generate_random( unsigned int numStates, unsigned int numActions,
+			  unsigned int branching, unsigned long seed );
+
+/*  Procedure
+ *    mdp_generate_chain
+ *
+ *  Purpose
+ *    Construct a chain MDP, whose values propagate one state per sweep
+ *
+ *  Parameters
+ *   numStates
+ *
+ *  Produces
+ *   p_mdp, an mdp*
+ *
+ *  Preconditions
+ *    numStates > 1
+ *
+ *  Postconditions
+ *    States form a line with two actions (0 left, 1 right). Each moves
+ *    one state in its direction with probability 0.9 and stays in place
+ *    otherwise; moving left from state 0 stays in place. The last state
+ *    is a terminal with reward +1, all others have reward -0.04, and the
+ *    start is state 0.
+ *    Any failure causes program exit.
+ */
+mdp* mdp_generate_chain( unsigned int numStates );
+
+/*  Procedure
+ *    mdp_generate_lazy_grid
+ *
+ *  Purpose
+ *    Describe a grid world whose transitions are generated on demand
+ *
+ *  Parameters
+ *   width
+ *   height
+ *
+ *  Produces
+ *   p_lazy, a lazy_mdp*
+ *
+ *  Preconditions
+ *    width > 0
+ *    height > 0
+ *    width*height fits in an unsigned int
+ *
+ *  Postconditions
+ *    p_lazy generates exactly the states, rewards and transitions of
+ *    mdp_generate_grid(width, height), storing nothing per state, so
+ *    grids far larger than memory would allow as an mdp can be solved.
+ *    The caller frees p_lazy with lazy_mdp_free.
+ *    Any failure causes program exit.
+ */
+lazy_mdp* mdp_generate_lazy_grid( unsigned int width, unsigned int height );
+
+#endif // GENERATE_H
@@ -0,0 +1,319 @@
+/* lazy.c
+ *
+ * Implementation of generator-backed MDPs and their cache of generated
+ * states.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "utilities.h"
+#include "lazy.h"
+
+// Marks the end of a slot chain or list
+#define LAZY_NONE UINT_MAX
+
+////////////////////////////////////////////////////////////////////////////////
+void lazy_mdp_free( lazy_mdp* p_lazy )
+{
+  if (NULL == p_lazy)
+    return;
+
+  if (NULL != p_lazy->release)
+    p_lazy->release(p_lazy->arg);
+
+  free(p_lazy);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+lazy_cache* lazy_cache_create( const lazy_mdp* p_lazy, unsigned int capacity )
+{
+  lazy_cache *p_cache;
+  unsigned int numBuckets, i;
+  size_t rowEntries, numInts;
+  unsigned int *ints;
+  double *doubles;
+
+  if (0 == capacity)
+    capacity = 1;
+
+  // At least two buckets per slot keeps chains short
+  for (numBuckets = 1 ; numBuckets < 2 * capacity ; numBuckets *= 2)
+    ;
+
+  rowEntries = (size_t)p_lazy->numActions * p_lazy->maxSuccessors;
+  numInts = numBuckets + 3 * (size_t)capacity +
+    (size_t)capacity * (2 * p_lazy->numActions + 1 + rowEntries);
+
+  p_cache = malloc(sizeof(lazy_cache));
+
+  if (NULL != p_cache)
+    p_cache->block = malloc(sizeof(lazy_state) * capacity +
+			    sizeof(double) * capacity * rowEntries +
+			    sizeof(unsigned int) * numInts);
+
+  if (NULL == p_cache || NULL == p_cache->block)
+  {
+    fprintf(stderr,"lazy_cache_create failed: %s (%s)\n",
+	    "Could not allocate cache", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  // States, then probabilities, then the unsigned arrays
+  p_cache->slot = p_cache->block;
+  doubles = (double*)(p_cache->slot + capacity);
+  ints = (unsigned int*)(doubles + capacity * rowEntries);
+
+  p_cache->bucket = ints;
+  ints += numBuckets;
+  p_cache->chain = ints;
+  ints += capacity;
+  p_cache->newer = ints;
+  ints += capacity;
+  p_cache->older = ints;
+  ints += capacity;
+
+  for (i = 0 ; i < capacity ; i++)
+  {
+    p_cache->slot[i].prob = doubles;
+    doubles += rowEntries;
+    p_cache->slot[i].actions = ints;
+    ints += p_lazy->numActions;
+    p_cache->slot[i].rowStart = ints;
+    ints += p_lazy->numActions + 1;
+    p_cache->slot[i].successor = ints;
+    ints += rowEntries;
+  }
+
+  for (i = 0 ; i < numBuckets ; i++)
+    p_cache->bucket[i] = LAZY_NONE;
+
+  p_cache->p_lazy = p_lazy;
+  p_cache->capacity = capacity;
+  p_cache->used = 0;
+  p_cache->bucketMask = numBuckets - 1;
+  p_cache->newest = p_cache->oldest = LAZY_NONE;
+  p_cache->hits = p_cache->misses = 0;
+
+  return p_cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void lazy_cache_free( lazy_cache* p_cache )
+{
+  if (NULL == p_cache)
+    return;
+
+  free(p_cache->block);
+  free(p_cache);
+}
+
+/*  Procedure
+ *    lazy_generate
+ *
+ *  Purpose
+ *    Call a lazy MDP's generator to fill in the transitions of a state
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    *p_state describes state. Any callback that returns more actions or
+ *    successors than p_lazy allows causes program exit.
+ */
+static void lazy_generate( const lazy_mdp* p_lazy, unsigned int state,
+			   lazy_state* p_state )
+{
+  unsigned int i, count;
+
+  p_state->state = state;
+  p_state->reward = p_lazy->reward(p_lazy->arg, state);
+  p_state->terminal = (0 != p_lazy->terminal(p_lazy->arg, state));
+  p_state->numAvailableActions = 0;
+  p_state->rowStart[0] = 0;
+
+  if (p_state->terminal)
+    return;
+
+  p_state->numAvailableActions = p_lazy->actions(p_lazy->arg, state,
+						 p_state->actions);
+
+  if (p_state->numAvailableActions > p_lazy->numActions)
+  {
+    fprintf(stderr, "lazy_cache_get failed: %s %u\n",
+	    "Too many actions in state", state);
+    exit(EXIT_FAILURE);
+  }
+
+  for (i = 0 ; i < p_state->numAvailableActions ; i++)
+  {
+    if (p_state->actions[i] >= p_lazy->numActions)
+    {
+      fprintf(stderr, "lazy_cache_get failed: %s %u\n",
+	      "Action out of range in state", state);
+      exit(EXIT_FAILURE);
+    }
+
+    count = p_lazy->successors(p_lazy->arg, state, p_state->actions[i],
+			       p_state->successor + p_state->rowStart[i],
+			       p_state->prob + p_state->rowStart[i]);
+
+    if (count > p_lazy->maxSuccessors)
+    {
+      fprintf(stderr, "lazy_cache_get failed: %s %u\n",
+	      "Too many successors in state", state);
+      exit(EXIT_FAILURE);
+    }
+
+    p_state->rowStart[i + 1] = p_state->rowStart[i] + count;
+  }
+}
+
+/* Remove slot from the recency list */
+static void lazy_unlink( lazy_cache* p_cache, unsigned int slot )
+{
+  if (LAZY_NONE != p_cache->newer[slot])
+    p_cache->older[p_cache->newer[slot]] = p_cache->older[slot];
+  else
+    p_cache->newest = p_cache->older[slot];
+
+  if (LAZY_NONE != p_cache->older[slot])
+    p_cache->newer[p_cache->older[slot]] = p_cache->newer[slot];
+  else
+    p_cache->oldest = p_cache->newer[slot];
+}
+
+/* Make slot the most recently used */
+static void lazy_push( lazy_cache* p_cache, unsigned int slot )
+{
+  p_cache->older[slot] = p_cache->newest;
+  p_cache->newer[slot] = LAZY_NONE;
+
+  if (LAZY_NONE != p_cache->newest)
+    p_cache->newer[p_cache->newest] = slot;
+  else
+    p_cache->oldest = slot;
+
+  p_cache->newest = slot;
+}
+
+/* The bucket of a state, from a folded multiplicative hash */
+static unsigned int lazy_bucket( const lazy_cache* p_cache, unsigned int state )
+{
+  unsigned int hash = state * 2654435761u;
+
+  return (hash ^ (hash >> 16)) & p_cache->bucketMask;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const lazy_state* lazy_cache_get( lazy_cache* p_cache, unsigned int state )
+{
+  unsigned int slot, *p_link, bucket;
+
+  // Successive lookups of one state (e.g., reward, then actions) are common
+  if (LAZY_NONE != p_cache->newest &&
+      p_cache->slot[p_cache->newest].state == state)
+  {
+    p_cache->hits++;
+    return p_cache->slot + p_cache->newest;
+  }
+
+  bucket = lazy_bucket(p_cache, state);
+
+  for (slot = p_cache->bucket[bucket] ;
+       LAZY_NONE != slot && p_cache->slot[slot].state != state ;
+       slot = p_cache->chain[slot])
+    ;
+
+  if (LAZY_NONE != slot)
+  {
+    p_cache->hits++;
+    lazy_unlink(p_cache, slot);
+    lazy_push(p_cache, slot);
+    return p_cache->slot + slot;
+  }
+
+  p_cache->misses++;
+
+  if (p_cache->used < p_cache->capacity)
+    slot = p_cache->used++;
+  else
+  { // Evict the least recently used state from its chain
+    slot = p_cache->oldest;
+    lazy_unlink(p_cache, slot);
+
+    p_link = p_cache->bucket + lazy_bucket(p_cache, p_cache->slot[slot].state);
+
+    while (*p_link != slot)
+      p_link = p_cache->chain + *p_link;
+
+    *p_link = p_cache->chain[slot];
+  }
+
+  lazy_generate(p_cache->p_lazy, state, p_cache->slot + slot);
+
+  p_cache->chain[slot] = p_cache->bucket[bucket];
+  p_cache->bucket[bucket] = slot;
+  lazy_push(p_cache, slot);
+
+  return p_cache->slot + slot;
+}
+
+/* The expected utility of row i of a generated state */
+static double lazy_row_eu( const lazy_state* p_state, unsigned int i,
+			   const double* utilities )
+{
+  unsigned int j;
+  double eu = 0;
+
+  for (j = p_state->rowStart[i] ; j < p_state->rowStart[i + 1] ; j++)
+    eu += p_state->prob[j] * utilities[p_state->successor[j]];
+
+  return eu;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+double lazy_calc_eu( lazy_cache* p_cache, unsigned int state,
+		     const double* utilities, unsigned int action )
+{
+  const lazy_state *p_state = lazy_cache_get(p_cache, state);
+  unsigned int i;
+
+  calc_eu_credit(1);
+
+  for (i = 0 ; i < p_state->numAvailableActions ; i++)
+    if (p_state->actions[i] == action)
+      return lazy_row_eu(p_state, i, utilities);
+
+  return 0; // Unavailable actions have no expected utility
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void lazy_calc_meu( lazy_cache* p_cache, unsigned int state,
+		    const double* utilities, double* meu,
+		    unsigned int* action )
+{
+  const lazy_state *p_state = lazy_cache_get(p_cache, state);
+  unsigned int i;
+  double eu;
+
+  *meu = 0; // max utility of no actions is zero
+  *action = 0;
+
+  calc_eu_credit(p_state->numAvailableActions);
+
+  for (i = 0 ; i < p_state->numAvailableActions ; i++)
+  {
+    eu = lazy_row_eu(p_state, i, utilities);
+
+    if (0 == i || eu > *meu)
+    {
+      *meu = eu;
+      *action = p_state->actions[i];
+    }
+  }
+}
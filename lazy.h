@@ -0,0 +1,222 @@
+/* lazy.h
+ *
+ * Declarations for MDPs whose transitions are generated on demand by
+ * callbacks instead of being stored, with an optional least-recently-used
+ * cache of the generated states.
+ *
+ */
+
+#ifndef LAZY_H
+#define LAZY_H
+
+/* An MDP described by callbacks, which may be called from several
+   threads at once */
+typedef struct {
+  unsigned int numStates;     /* Discrete total number of possible states */
+  unsigned int numActions;    /* Discrete total number of possible actions */
+  unsigned int start;         /* Value of starting state */
+  unsigned int maxSuccessors; /* Most successors of any state and action */
+
+  /* The reward of state */
+  double (*reward)( const void* arg, unsigned int state );
+
+  /* Whether state is terminal (having no actions or successors) */
+  int (*terminal)( const void* arg, unsigned int state );
+
+  /* Writes the actions available in a nonterminal state to actions (of
+     length numActions), in ascending order, and returns their number */
+  unsigned int (*actions)( const void* arg, unsigned int state,
+			   unsigned int* actions );
+
+  /* Writes the distinct successors of an available action in a
+     nonterminal state, in ascending order, and their nonzero
+     probabilities to successor and prob (of length maxSuccessors), and
+     returns their number */
+  unsigned int (*successors)( const void* arg, unsigned int state,
+			      unsigned int action, unsigned int* successor,
+			      double* prob );
+
+  void *arg;                  /* Passed to every callback */
+  void (*release)( void* arg ); /* Frees arg in lazy_mdp_free, or NULL */
+} lazy_mdp;
+
+/* The generated transitions of one state */
+typedef struct {
+  unsigned int state;
+  unsigned int terminal;
+  double reward;
+  unsigned int numAvailableActions;
+  unsigned int *actions;      /* The available actions */
+  unsigned int *rowStart;     /* numAvailableActions+1 offsets: actions[i]
+				 leads to successor[rowStart[i]] up to (but
+				 excluding) successor[rowStart[i+1]] */
+  unsigned int *successor;
+  double *prob;               /* prob[j] := P(successor[j]|state,action) */
+} lazy_state;
+
+/* Generated states, kept in least-recently-used order */
+typedef struct {
+  const lazy_mdp *p_lazy;
+  unsigned int capacity;      /* States kept (at least one) */
+  unsigned int used;          /* Slots holding a state */
+  lazy_state *slot;           /* capacity generated states */
+  unsigned int *bucket;       /* Hash table of slot chains */
+  unsigned int bucketMask;    /* Number of buckets less one */
+  unsigned int *chain;        /* Next slot in the same bucket */
+  unsigned int *newer;        /* Next more recently used slot */
+  unsigned int *older;        /* Next less recently used slot */
+  unsigned int newest;        /* Most recently used slot */
+  unsigned int oldest;        /* Least recently used slot */
+  unsigned long hits;         /* Lookups answered from the cache */
+  unsigned long misses;       /* Lookups that called the generator */
+  void *block;                /* Single allocation behind the arrays */
+} lazy_cache;
+
+/*  Procedure
+ *    lazy_mdp_free
+ *
+ *  Purpose
+ *    Release a lazy MDP
+ *
+ *  Parameters
+ *   p_lazy
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    p_lazy->release (unless NULL) has been called on p_lazy->arg, and
+ *    p_lazy is freed; NULL is ignored
+ */
+void lazy_mdp_free( lazy_mdp* p_lazy );
+
+/*  Procedure
+ *    lazy_cache_create
+ *
+ *  Purpose
+ *    Allocate a cache of the states generated by a lazy MDP
+ *
+ *  Parameters
+ *   p_lazy
+ *   capacity
+ *
+ *  Produces,
+ *   p_cache, a lazy_cache*
+ *
+ *  Preconditions
+ *    p_lazy points to a valid lazy_mdp that outlives p_cache
+ *
+ *  Postconditions
+ *    p_cache keeps the capacity most recently used states (at least the
+ *    last one, when capacity is 0). All of its memory is allocated here.
+ *    A cache is used by one thread at a time.
+ *    Any failure causes program exit.
+ */
+lazy_cache* lazy_cache_create( const lazy_mdp* p_lazy, unsigned int capacity );
+
+/*  Procedure
+ *    lazy_cache_free
+ *
+ *  Purpose
+ *    Release a cache
+ *
+ *  Parameters
+ *   p_cache
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    All memory of p_cache is released; NULL is ignored
+ */
+void lazy_cache_free( lazy_cache* p_cache );
+
+/*  Procedure
+ *    lazy_cache_get
+ *
+ *  Purpose
+ *    Find the transitions of a state, generating them when not cached
+ *
+ *  Parameters
+ *   p_cache
+ *   state
+ *
+ *  Produces,
+ *   p_state, a const lazy_state*
+ *
+ *  Preconditions
+ *    0 <= state < p_cache->p_lazy->numStates
+ *
+ *  Postconditions
+ *    p_state holds the reward, terminal flag, actions and successors of
+ *    state, and is valid until the next call on p_cache. state becomes
+ *    the most recently used, evicting the least recently used state
+ *    when the cache is full.
+ *    Any failure (e.g., a callback exceeding numActions or
+ *    maxSuccessors) causes program exit.
+ */
+const lazy_state* lazy_cache_get( lazy_cache* p_cache, unsigned int state );
+
+/*  Procedure
+ *    lazy_calc_eu
+ *
+ *  Purpose
+ *    Calculate the expected utility of a state and action in a lazy MDP
+ *
+ *  Parameters
+ *   p_cache
+ *   state
+ *   utilities
+ *   action
+ *
+ *  Produces
+ *   eu, a double
+ *
+ *  Preconditions
+ *    0 <= state < p_cache->p_lazy->numStates
+ *    utilities points to a valid array of length numStates
+ *
+ *  Postconditions
+ *    eu = sum_{s'} P(s'|state,action) * utilities(s'), accumulated in
+ *    successor order as calc_eu does, or 0 when state is terminal or
+ *    action is unavailable.
+ *    The calling thread's count of expected utilities grows by one.
+ */
+double lazy_calc_eu( lazy_cache* p_cache, unsigned int state,
+		     const double* utilities, unsigned int action );
+
+/*  Procedure
+ *    lazy_calc_meu
+ *
+ *  Purpose
+ *    Calculate the action of maximum expected utility of a state in a
+ *    lazy MDP
+ *
+ *  Parameters
+ *   p_cache
+ *   state
+ *   utilities
+ *   meu
+ *   action
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    0 <= state < p_cache->p_lazy->numStates
+ *    utilities points to a valid array of length numStates
+ *    meu != NULL
+ *    action != NULL
+ *
+ *  Postconditions
+ *    As for calc_meu: *meu is max_{a} EU(state,a) over the available
+ *    actions and *action the first one that yields it, or both are 0
+ *    when none are available.
+ *    The calling thread's count of expected utilities grows by the
+ *    number of available actions.
+ */
+void lazy_calc_meu( lazy_cache* p_cache, unsigned int state,
+		    const double* utilities, double* meu,
+		    unsigned int* action );
+
+#endif // LAZY_H
@@ -12,8 +12,285 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "mdp.h"
 
+// Bytes read from the stream at a time
+#define SCAN_BUFFER 65536
+
+// Bytes kept available past the current position, so that any token of
+// reasonable length lies wholly within the buffer
+#define SCAN_LOOKAHEAD 256
+
+// Alignment in bytes of the blocks holding an mdp's arrays, and of each
+// array within a block (one cache line)
+#define MDP_ARENA_ALIGN 64
+
+/* A buffered tokenizer over a stream, replacing fscanf for MDP files */
+typedef struct {
+  FILE *stream;     /* Underlying stream */
+  char *buffer;     /* SCAN_BUFFER+1 bytes; buffer[length] == '\0' */
+  size_t position;  /* Offset of the next unread byte */
+  size_t length;    /* Number of valid bytes in buffer */
+  int atEnd;        /* Nonzero once the stream is exhausted (or failed) */
+} mdp_scanner;
+
+// Powers of ten that are exactly representable as doubles
+static const double exact_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static void scanner_init( mdp_scanner * p_scan, FILE * stream )
+{
+  p_scan->stream = stream;
+  p_scan->buffer = malloc(SCAN_BUFFER + 1);
+
+  if (NULL == p_scan->buffer)
+  {
+    fprintf(stderr,"scanner_init failed: %s (%s)\n",
+	    "Could not allocate buffer",
+	    strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  p_scan->position = 0;
+  p_scan->length = 0;
+  p_scan->atEnd = 0;
+  p_scan->buffer[0] = '\0';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void scanner_free( mdp_scanner * p_scan )
+{
+  free(p_scan->buffer);
+}
+
+/*  Procedure
+ *    scanner_fill
+ *
+ *  Purpose
+ *    Ensure the scanner's buffer holds enough unread bytes
+ *
+ *  Parameters
+ *   p_scan
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    At least SCAN_LOOKAHEAD unread bytes are buffered, or the stream
+ *    is exhausted and p_scan->atEnd is set
+ */
+static void scanner_fill( mdp_scanner * p_scan )
+{
+  size_t remaining, count;
+
+  remaining = p_scan->length - p_scan->position;
+
+  if (p_scan->atEnd || remaining >= SCAN_LOOKAHEAD)
+    return;
+
+  // Move the unread bytes to the front and read after them
+  memmove(p_scan->buffer, p_scan->buffer + p_scan->position, remaining);
+  p_scan->position = 0;
+  p_scan->length = remaining;
+
+  while (!p_scan->atEnd && p_scan->length < SCAN_BUFFER)
+  {
+    count = fread(p_scan->buffer + p_scan->length, 1, 
+		  SCAN_BUFFER - p_scan->length, p_scan->stream);
+    p_scan->length += count;
+
+    if (0 == count)
+      p_scan->atEnd = 1;
+  }
+
+  p_scan->buffer[p_scan->length] = '\0';
+}
+
+/*  Procedure
+ *    scanner_skip_space
+ *
+ *  Purpose
+ *    Advance past whitespace
+ *
+ *  Parameters
+ *   p_scan
+ *
+ *  Produces,
+ *   more, an int
+ *
+ *  Postconditions
+ *    more is nonzero when a non-whitespace byte is next, with at least
+ *    SCAN_LOOKAHEAD bytes buffered (or the rest of the stream)
+ */
+static int scanner_skip_space( mdp_scanner * p_scan )
+{
+  char c;
+
+  while (1)
+  {
+    scanner_fill(p_scan);
+
+    if (p_scan->position == p_scan->length)
+      return 0;
+
+    c = p_scan->buffer[p_scan->position];
+
+    if (c != ' ' && c != '\n' && c != '\t' && c != '\r' && 
+	c != '\v' && c != '\f')
+      return 1;
+
+    p_scan->position++;
+  }
+}
+
+/*  Procedure
+ *    scan_unsigned
+ *
+ *  Purpose
+ *    Read an unsigned integer, as fscanf's %u
+ *
+ *  Parameters
+ *   p_scan
+ *   p_value
+ *
+ *  Produces,
+ *   count, an int
+ *
+ *  Postconditions
+ *    count is 1 and *p_value is assigned when an integer is read, 0 when
+ *    the next token is not an integer (which is left unread), or EOF when
+ *    no tokens remain
+ */
+static int scan_unsigned( mdp_scanner * p_scan, unsigned int * p_value )
+{
+  const char *p;
+  unsigned int value = 0;
+  int negative = 0;
+
+  if (!scanner_skip_space(p_scan))
+    return EOF;
+
+  p = p_scan->buffer + p_scan->position;
+
+  if ('+' == *p || '-' == *p)
+    negative = ('-' == *p++);
+
+  if (*p < '0' || *p > '9')
+    return 0;
+
+  while (*p >= '0' && *p <= '9')
+    value = value * 10 + (unsigned int)(*p++ - '0');
+
+  *p_value = negative ? -value : value;
+  p_scan->position = p - p_scan->buffer;
+
+  return 1;
+}
+
+/*  Procedure
+ *    scan_double
+ *
+ *  Purpose
+ *    Read a double, as fscanf's %lf
+ *
+ *  Parameters
+ *   p_scan
+ *   p_value
+ *
+ *  Produces,
+ *   count, an int
+ *
+ *  Postconditions
+ *    count is 1 and *p_value is assigned when a number is read, 0 when
+ *    the next token is not a number (which is left unread), or EOF when
+ *    no tokens remain. Decimals of at most 15 significant digits and
+ *    small exponents are converted exactly by one multiplication or
+ *    division; any other token is converted by strtod.
+ */
+static int scan_double( mdp_scanner * p_scan, double * p_value )
+{
+  const char *start, *p, *exponent;
+  char *end;
+  unsigned long long mantissa = 0;
+  int digits = 0, any = 0, negative = 0, scale = 0, power = 0, sign;
+
+  if (!scanner_skip_space(p_scan))
+    return EOF;
+
+  start = p = p_scan->buffer + p_scan->position;
+
+  if ('+' == *p || '-' == *p)
+    negative = ('-' == *p++);
+
+  // Integer part, then fraction; leading zeros are not significant
+  for ( ; *p >= '0' && *p <= '9' ; p++, any = 1)
+    if (mantissa > 0 || *p != '0')
+    {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (++digits > 15)
+	break;
+    }
+
+  if ('.' == *p && digits <= 15)
+    for (p++ ; *p >= '0' && *p <= '9' ; p++, any = 1)
+    {
+      scale--;
+      if (mantissa > 0 || *p != '0')
+      {
+	mantissa = mantissa * 10 + (*p - '0');
+	if (++digits > 15)
+	  break;
+      }
+    }
+
+  if (any && digits <= 15 && ('e' == *p || 'E' == *p))
+  {
+    exponent = p + 1;
+    sign = 1;
+
+    if ('+' == *exponent || '-' == *exponent)
+      sign = ('-' == *exponent++) ? -1 : 1;
+
+    if (*exponent >= '0' && *exponent <= '9')
+    {
+      for (p = exponent ; *p >= '0' && *p <= '9' && power < 1000 ; p++)
+	power = power * 10 + (*p - '0');
+      scale += sign * power;
+    }
+  }
+
+  // Fast path: exact when both the mantissa and the power of ten are
+  // exactly representable (Clinger's algorithm)
+  if (any && digits <= 15 && scale >= -22 && scale <= 22 &&
+      (*p < '0' || *p > '9'))
+  {
+    *p_value = (scale < 0) ? mantissa / exact_pow10[-scale] 
+                           : mantissa * exact_pow10[scale];
+    if (negative)
+      *p_value = -*p_value;
+    p_scan->position = p - p_scan->buffer;
+    return 1;
+  }
+
+  // Slow path for long mantissas, large exponents, inf and nan
+  *p_value = strtod(start, &end);
+
+  if (end == start)
+    return 0;
+
+  p_scan->position = end - p_scan->buffer;
+  return 1;
+}
+
 
 /*  Procedure
  *    mdp_read_dimensions
@@ -22,7 +299,7 @@
  *    Read the number of states and number of actions from an MDP file
  *
  *  Parameters
- *   stream
+ *   p_scan
  *   p_numStates
  *   p_numActions
  *
@@ -30,30 +307,30 @@
  *   [Nothing.]
  *
  *  Preconditions
- *    stream is a valid, open stream that may be read from
- *    The next line of data in stream is may be read as two unsigned integers
+ *    p_scan is a scanner over a valid, open stream
+ *    The next line of data in p_scan is may be read as two unsigned integers
  *
  *  Postconditions
  *    *p_numStates contains the first unsigned integer, representing
  *    the number of MDP states. 
  *    *p_numActions contains the second unsigned integer, representing 
  *    the number of MDP actions. 
- *    stream has advanced only to just past these two values.
+ *    p_scan has advanced only to just past these two values.
  *    Any failure causes program exit.
  */
-void mdp_read_dimensions(FILE * stream, unsigned int * p_numStates, 
+void mdp_read_dimensions(mdp_scanner * p_scan, unsigned int * p_numStates, 
 			 unsigned int * p_numActions)
 {
 
-  int count; // Place holder for fscanf return values
+  int count; // Place holder for scan return values
 
   // Read number of states
-  count = fscanf(stream, "%ud", p_numStates);
+  count = scan_unsigned(p_scan, p_numStates);
 
   // Check for errors 
   if ( EOF == count )
   {
-    if ( ferror (stream) )
+    if ( ferror (p_scan->stream) )
       fprintf(stderr,
 	      "mdp_read_dimensions failed: %s\n",
 	      strerror(errno));
@@ -72,12 +349,12 @@ void mdp_read_dimensions(FILE * stream, unsigned int * p_numStates,
   }
 
   // Read number of states
-  count = fscanf(stream, "%ud", p_numActions);
+  count = scan_unsigned(p_scan, p_numActions);
   
   // Check for errors 
   if ( EOF == count )
   {
-    if ( ferror (stream) )
+    if ( ferror (p_scan->stream) )
       fprintf(stderr,
 	      "mdp_read_dimensions failed: %s\n",
 	      strerror(errno));
@@ -104,32 +381,32 @@ void mdp_read_dimensions(FILE * stream, unsigned int * p_numStates,
  *    Read the initial state from an MDP file
  *
  *  Parameters
- *   stream
+ *   p_scan
  *   p_mdp
  *
  *  Produces,
  *   [Nothing.]
  *
  *  Preconditions
- *    stream is a valid, open stream that may be read from
- *    The next line of data in stream is may be read as an unsigned integer
+ *    p_scan is a scanner over a valid, open stream
+ *    The next line of data in p_scan is may be read as an unsigned integer
  *
  *  Postconditions
  *    p_mdp->start is assigned as read from stream
  *    Any failure causes program exit.
  */
-void mdp_read_start(FILE * stream, mdp * p_mdp)
+void mdp_read_start(mdp_scanner * p_scan, mdp * p_mdp)
 {
 
-  int count; // Place holder for fscanf return values
+  int count; // Place holder for scan return values
 
   // Read start
-  count = fscanf(stream, "%ud", &p_mdp->start);
+  count = scan_unsigned(p_scan, &p_mdp->start);
 
   // Check for errors 
   if ( EOF == count )
   {
-    if ( ferror (stream) )
+    if ( ferror (p_scan->stream) )
       fprintf(stderr,
 	      "mdp_read_start failed: %s\n",
 	      strerror(errno));
@@ -148,96 +425,201 @@ void mdp_read_start(FILE * stream, mdp * p_mdp)
   }
 }
 
-////////////////////////////////////////////////////////////////////////////////
-mdp* mdp_malloc(const unsigned int numStates, const unsigned int numActions)
+/*  Procedure
+ *    scan_keyword
+ *
+ *  Purpose
+ *    Read a given word if it is the next token
+ *
+ *  Parameters
+ *   p_scan
+ *   word
+ *
+ *  Produces,
+ *   found, an int
+ *
+ *  Postconditions
+ *    found is nonzero and the word has been read when the next token is
+ *    exactly word; otherwise found is zero and nothing has been read
+ */
+static int scan_keyword( mdp_scanner * p_scan, const char * word )
 {
+  size_t length = strlen(word);
+  char next;
 
-  //----------------------------------------
-  // Root structure
+  if (!scanner_skip_space(p_scan) ||
+      0 != strncmp(p_scan->buffer + p_scan->position, word, length))
+    return 0;
 
-  mdp* p_mdp = malloc(sizeof(mdp));
+  next = p_scan->buffer[p_scan->position + length];
 
-  if (NULL == p_mdp)
-  {
-    fprintf(stderr,"mdp_malloc failed: %s (%s)\n",
-	    "Could not allocate mdp",
-	    strerror(errno));
-    exit(EXIT_FAILURE);
-  }
+  if (next != '\0' && next != ' ' && next != '\n' && next != '\t' && 
+      next != '\r' && next != '\v' && next != '\f')
+    return 0;
 
-  //----------------------------------------
-  // Transition probability
+  p_scan->position += length;
+  return 1;
+}
+
+/*  Procedure
+ *    arena_section
+ *
+ *  Purpose
+ *    Reserve room for one array in a block being laid out
+ *
+ *  Parameters
+ *   p_length
+ *   bytes
+ *
+ *  Produces,
+ *   offset, a size_t
+ *
+ *  Postconditions
+ *    offset is *p_length rounded up to a multiple of MDP_ARENA_ALIGN, and
+ *    *p_length is advanced past bytes bytes from offset
+ */
+static size_t arena_section( size_t * p_length, size_t bytes )
+{
+  size_t offset;
 
-  p_mdp->transitionProb = mdp_malloc_transitions(numStates, numActions);
+  offset = (*p_length + MDP_ARENA_ALIGN - 1) & ~(size_t)(MDP_ARENA_ALIGN - 1);
+  *p_length = offset + bytes;
 
+  return offset;
+}
 
-  //----------------------------------------
-  // Number of available actions
+/*  Procedure
+ *    arena_malloc
+ *
+ *  Purpose
+ *    Allocate one aligned block for several arrays
+ *
+ *  Parameters
+ *   length
+ *   caller
+ *   what
+ *
+ *  Produces,
+ *   block, a char*
+ *
+ *  Postconditions
+ *    block holds length (at least one) bytes starting on a
+ *    MDP_ARENA_ALIGN boundary and is released with free.
+ *    Any failure prints a message naming caller and what, then exits.
+ */
+static char * arena_malloc( size_t length, const char * caller,
+			    const char * what )
+{
+  void * block;
+  int status;
 
-  p_mdp->numAvailableActions = malloc(sizeof(unsigned int) * numStates);
+  status = posix_memalign(&block, MDP_ARENA_ALIGN, length ? length : 1);
 
-  if  ( NULL == p_mdp->numAvailableActions )
+  if (0 != status)
   {
-    fprintf(stderr,"mdp_malloc failed: %s (%s)\n",
-	    "Could not allocate numAvailableActions",
-	    strerror(errno));
+    fprintf(stderr,"%s failed: %s (%s)\n", caller, what, strerror(status));
     exit(EXIT_FAILURE);
   }
 
+  return block;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+mdp* mdp_malloc(const unsigned int numStates, const unsigned int numActions)
+{
+  size_t length, actions, rewards, transitionStart, available, terminal;
+  char * block;
+  mdp* p_mdp;
+
+  //----------------------------------------
+  // Lay out the root structure and every per-state array in one block
+  length = sizeof(mdp);
+  actions = arena_section(&length, sizeof(unsigned int*) * numStates);
+  rewards = arena_section(&length, sizeof(double) * numStates);
+  transitionStart = arena_section(&length, sizeof(unsigned int) *
+				  ((size_t)numStates * numActions + 1));
+  available = arena_section(&length, sizeof(unsigned int) * numStates);
+  terminal = arena_section(&length, sizeof(unsigned int) * numStates);
+
+  block = arena_malloc(length, "mdp_malloc", "Could not allocate mdp");
+
+  p_mdp = (mdp*)block;
+  p_mdp->actions = (unsigned int**)(block + actions);
+  p_mdp->rewards = (double*)(block + rewards);
+  p_mdp->transitionStart = (unsigned int*)(block + transitionStart);
+  p_mdp->numAvailableActions = (unsigned int*)(block + available);
+  p_mdp->terminal = (unsigned int*)(block + terminal);
+
+  //----------------------------------------
+  // Transition probability rows
+  // SUCCESSOR ARRAYS CANNOT BE ALLOCATED UNTIL numTransitions is known
+  p_mdp->numTransitions = 0;
+  p_mdp->successor = NULL;
+  p_mdp->transitionProb = NULL;
+
   //----------------------------------------
   // Available actions
   // SECONDARY ARRAYS CANNOT BE ALLOCATED UNTIL numAvailableActions is known
-  p_mdp->actions = malloc(sizeof(unsigned int*) * numStates);
-  
-  if  ( NULL == p_mdp->actions )
-  {
-    fprintf(stderr,"mdp_malloc failed: %s (%s)\n",
-	    "Could not allocate actions",
-	    strerror(errno));
-    exit(EXIT_FAILURE);
-  }
+  memset( p_mdp->actions, 0, sizeof(unsigned int*) * numStates );
+
+  //----------------------------------------
+  // Terminal states
+  // Initialize to zero
+  memset( p_mdp->terminal, 0, sizeof(unsigned int) * numStates );
 
   //----------------------------------------
-  // Rewards
+  // Solvers read transitionProb until told otherwise
+  p_mdp->precision = MDP_PRECISION_DOUBLE;
+  p_mdp->transitionFloat = NULL;
+  p_mdp->transitionIndex = NULL;
+  p_mdp->palette = NULL;
 
-  p_mdp->rewards = malloc(sizeof(double) * numStates);
+  //----------------------------------------
+  // Not mapped from a file
+  p_mdp->mapping = NULL;
+  p_mdp->mappingLength = 0;
 
-  if  ( NULL == p_mdp->rewards )
-  {
-    fprintf(stderr,"mdp_malloc failed: %s (%s)\n",
-	    "Could not allocate rewards",
-	    strerror(errno));
-    exit(EXIT_FAILURE);
-  }
+  
+  return p_mdp;
+}
 
+////////////////////////////////////////////////////////////////////////////////
+double mdp_transition(const mdp* p_mdp, unsigned int successor,
+		      unsigned int state, unsigned int action)
+{
+  unsigned int low, high, mid;
 
-  //----------------------------------------
-  // Terminal states
-  p_mdp->terminal = malloc(sizeof(unsigned int) * numStates);
+  low = p_mdp->transitionStart[state * p_mdp->numActions + action];
+  high = p_mdp->transitionStart[state * p_mdp->numActions + action + 1];
 
-  if  ( NULL == p_mdp->terminal )
+  // Binary search the (ascending) successors of this row
+  while (low < high)
   {
-    fprintf(stderr,"mdp_malloc failed: %s (%s)\n",
-	    "Could not allocate terminal",
-	    strerror(errno));
-    exit(EXIT_FAILURE);
+    mid = low + (high - low) / 2;
+
+    if (p_mdp->successor[mid] < successor)
+      low = mid + 1;
+    else
+      high = mid;
   }
 
-  // Initialize to zero
-  memset( p_mdp->terminal, 0, sizeof(unsigned int) * numStates );
+  if (low < p_mdp->transitionStart[state * p_mdp->numActions + action + 1] &&
+      p_mdp->successor[low] == successor)
+    return p_mdp->transitionProb[low];
 
-  
-  return p_mdp;
+  return 0.0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-double *** mdp_malloc_transitions(unsigned int numStates, 
-				  unsigned int numActions)
+double * mdp_malloc_transitions(unsigned int numStates, 
+				unsigned int numActions)
 {
 
-  double *** transitionProb;
+  double * transitionProb;
 
-  transitionProb = malloc(sizeof(double**) * numStates); // P(s'|...
+  // P(s'|s,a) for all s, a, s' in one block (zeroed, as promised)
+  transitionProb = calloc( (size_t)numStates * numActions * numStates,
+			   sizeof(double) );
 
   if (NULL == transitionProb) 
   {
@@ -247,38 +629,94 @@ double *** mdp_malloc_transitions(unsigned int numStates,
     exit(EXIT_FAILURE);
   }
 
-  unsigned int i,j,k;
-  for ( i = 0 ; i<numStates ; i++ )
+  return transitionProb;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mdp_predecessors( const mdp* p_mdp, unsigned int ** p_predecessorStart,
+		       unsigned int ** p_predecessor )
+{
+  unsigned int *start, *predecessor, *last;
+  unsigned int s, t, i, row_end, numStates, numActions, entries;
+
+  numStates = p_mdp->numStates;
+  numActions = p_mdp->numActions;
+
+  start = calloc( numStates + 1, sizeof(unsigned int) );
+  last = malloc( sizeof(unsigned int) * (numStates ? numStates : 1) );
+
+  if (NULL == start || NULL == last)
   {
-    transitionProb[i] = malloc(sizeof(double*) * numStates); // P(s'|s,...
-    
-    if ( NULL == transitionProb[i] ) 
+    fprintf(stderr,"mdp_predecessors failed: %s (%s)\n",
+	    "Could not allocate predecessorStart",
+	    strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  // last[t] is the most recent predecessor recorded for t; since s
+  // increases, comparing against it removes duplicates across actions
+  for (t=0 ; t < numStates ; t++)
+    last[t] = numStates;
+
+  // Count the distinct predecessors of each state
+  for (s=0 ; s < numStates ; s++)
+  {
+    row_end = p_mdp->transitionStart[(s + 1) * numActions];
+
+    for (i = p_mdp->transitionStart[s * numActions] ; i < row_end ; i++)
     {
-      fprintf(stderr,"mdp_malloc_transitions failed: %s (%s)\n",
-	      "Could not allocate transitionProb[s']",
-	      strerror(errno));
-      exit(EXIT_FAILURE);
+      t = p_mdp->successor[i];
+
+      if (last[t] != s)
+      {
+	last[t] = s;
+	start[t + 1]++;
+      }
     }
+  }
+
+  for (t=0 ; t < numStates ; t++)
+    start[t + 1] += start[t];
+
+  entries = start[numStates];
+  predecessor = malloc( sizeof(unsigned int) * (entries ? entries : 1) );
+
+  if (NULL == predecessor)
+  {
+    fprintf(stderr,"mdp_predecessors failed: %s (%s)\n",
+	    "Could not allocate predecessor",
+	    strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  // Fill, using start[t] as a cursor that is restored afterward
+  for (t=0 ; t < numStates ; t++)
+    last[t] = numStates;
+
+  for (s=0 ; s < numStates ; s++)
+  {
+    row_end = p_mdp->transitionStart[(s + 1) * numActions];
 
-    for ( j = 0 ; j<numStates ; j++ )
+    for (i = p_mdp->transitionStart[s * numActions] ; i < row_end ; i++)
     {
-      // P(s'|s,a)
-      transitionProb[i][j] = malloc(sizeof(double) * numActions); 
-      
-      if  ( NULL == transitionProb[i][j] )
+      t = p_mdp->successor[i];
+
+      if (last[t] != s)
       {
-	fprintf(stderr,"mdp_malloc_transitions failed: %s (%s)\n",
-		"Could not allocate transitionProb[s'][s]",
-		strerror(errno));
-	exit(EXIT_FAILURE);
+	last[t] = s;
+	predecessor[start[t]++] = s;
       }
-
-      for ( k = 0 ; k<numActions ; k++)
-	transitionProb[i][j][k] = 0.0; // Initialize to zero as promised
     }
   }
-  
-  return transitionProb;
+
+  for (t=numStates ; t > 0 ; t--)
+    start[t] = start[t - 1];
+  start[0] = 0;
+
+  free(last);
+
+  *p_predecessorStart = start;
+  *p_predecessor = predecessor;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -287,62 +725,37 @@ double ** mdp_malloc_state_action(unsigned int numStates,
 {
 
   double ** count;
+  size_t length, rows;
+  char * block;
+  unsigned int i;
 
-  count = malloc(sizeof(double*) * numStates); // N[s,...
+  // Row pointers followed by every N[s,a], in one block
+  length = sizeof(double*) * numStates;  // N[s,...
+  rows = arena_section(&length, sizeof(double) * numStates * numActions);
 
-  if (NULL == count) 
-  {
-    fprintf(stderr,"mdp_malloc failed: %s (%s)\n",
-	    "Could not allocate count",
-	    strerror(errno));
-    exit(EXIT_FAILURE);
-  }
+  block = arena_malloc(length, "mdp_malloc_state_action",
+		       "Could not allocate count");
+
+  count = (double**)block;
 
-  unsigned int i,j;
   for ( i = 0 ; i<numStates ; i++ )
-  {
-    count[i] = malloc(sizeof(double) * numActions); // N[s,a]
-    
-    if ( NULL == count[i] ) 
-    {
-      fprintf(stderr,"mdp_malloc_state_action failed: %s (%s)\n",
-	      "Could not allocate count[s]",
-	      strerror(errno));
-      exit(EXIT_FAILURE);
-    }
+    count[i] = (double*)(block + rows) + (size_t)i * numActions; // N[s,a]
 
-    for ( j = 0 ; j<numActions ; j++ )
-    {
-      count[i][j] = 0.0; // Initialize to zero as promised
-    }
-  }
+  // Initialize to zero as promised
+  memset( block + rows, 0, sizeof(double) * numStates * numActions );
   
   return count;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void mdp_free_transitions( unsigned int numStates, double *** transitions )
+void mdp_free_transitions( unsigned int numStates, double * transitions )
 {
-  unsigned int i,j;
-
-  for ( i = 0 ; i< numStates ; i++ )
-  {
-    for ( j = 0 ; j < numStates ; j++ )
-      free(transitions[i][j]);
-    free(transitions[i]);
-  }
-  
   free(transitions);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void mdp_free_state_action( unsigned int numStates, double ** count )
 {
-  unsigned int i;
-  
-  for ( i = 0 ; i < numStates ; i++)
-    free(count[i]);
-
   free(count);
 }
 
@@ -368,29 +781,355 @@ void mdp_free_state_action( unsigned int numStates, double ** count )
  *  Postconditions
  *    For 0 <= i < p_mdp->numStates, p_mdp->actions[i] is a valid
  *    pointer to an unsigned int array of length
- *    p_mdp->numAvailableActions[i],
+ *    p_mdp->numAvailableActions[i]. The arrays are consecutive in a
+ *    single allocation beginning at p_mdp->actions[0].
  *    Any failure causes program exit.
  */
 void  mdp_malloc_actions(mdp * p_mdp)
 {
   unsigned int i;
+  size_t numEntries;
+  unsigned int * entries;
+
+  numEntries = 0;
+  for ( i=0 ; i < p_mdp->numStates ; i++)
+    numEntries += p_mdp->numAvailableActions[i];
+
+  // Every state's list lies in one block, which starts at actions[0]
+  entries = (unsigned int*)arena_malloc( sizeof(unsigned int) * numEntries,
+					 "mdp_malloc_actions",
+					 "Could not allocate actions[i]" );
 
   for ( i=0 ; i < p_mdp->numStates ; i++)
   {
+    p_mdp->actions[i] = entries;
+    entries += p_mdp->numAvailableActions[i];
+  }
+  
+}
+
+/*  Procedure
+ *    mdp_malloc_successors
+ *
+ *  Purpose
+ *    Allocate arrays for the nonzero transitions
+ *
+ *  Parameters
+ *    p_mdp
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *    p_mdp->numTransitions is the number of nonzero transitions
+ *
+ *  Postconditions
+ *    p_mdp->transitionProb is a valid pointer to a double array of
+ *    length p_mdp->numTransitions
+ *    p_mdp->successor is a valid pointer to an unsigned int array of
+ *    length p_mdp->numTransitions, within the same allocation
+ *    Any failure causes program exit.
+ */
+void  mdp_malloc_successors(mdp * p_mdp)
+{
+  // Always allocate at least one entry so an empty model has valid pointers
+  size_t length = p_mdp->numTransitions ? p_mdp->numTransitions : 1;
+  char * block;
+
+  // A reference count, then probabilities (keeping their alignment), then
+  // successors, in one block so a row's data is contiguous and freed
+  // together
+  block = arena_malloc( MDP_ARENA_ALIGN + 
+			(sizeof(double) + sizeof(unsigned int)) * length,
+			"mdp_malloc_successors", 
+			"Could not allocate transitionProb" );
+
+  *(unsigned int*)block = 1;
+
+  p_mdp->transitionProb = (double*)(block + MDP_ARENA_ALIGN);
+  p_mdp->successor = (unsigned int*)(p_mdp->transitionProb + length);
+}
+
+/*  Procedure
+ *    mdp_owns_successors
+ *
+ *  Purpose
+ *    Determine whether an mdp's nonzero transitions are reference counted
+ *
+ *  Parameters
+ *    p_mdp
+ *
+ *  Produces,
+ *    owned, an int
+ *
+ *  Postconditions
+ *    owned is nonzero when p_mdp->transitionProb came from
+ *    mdp_malloc_successors, and zero when it is NULL or lies within
+ *    p_mdp's mapping (see mdp_map), which has no reference count
+ */
+static int mdp_owns_successors(const mdp * p_mdp)
+{
+  uintptr_t prob = (uintptr_t)p_mdp->transitionProb;
+  uintptr_t base = (uintptr_t)p_mdp->mapping;
+
+  if ( NULL == p_mdp->transitionProb )
+    return 0;
+
+  return NULL == p_mdp->mapping || prob < base ||
+    prob >= base + p_mdp->mappingLength;
+}
+
+/*  Procedure
+ *    mdp_release_successors
+ *
+ *  Purpose
+ *    Drop an mdp's reference to its nonzero transitions
+ *
+ *  Parameters
+ *    p_mdp
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    The block holding p_mdp->transitionProb and p_mdp->successor, when
+ *    it came from mdp_malloc_successors, is freed once no mdp refers to
+ *    it; arrays within a mapping are left to mdp_free's munmap. Both
+ *    pointers are NULL.
+ */
+static void mdp_release_successors(mdp * p_mdp)
+{
+  char * block;
+
+  if ( mdp_owns_successors(p_mdp) )
+  {
+    block = (char*)p_mdp->transitionProb - MDP_ARENA_ALIGN;
+
+    // Copies may be released from different threads
+    if ( 0 == __atomic_sub_fetch((unsigned int*)block, 1, __ATOMIC_ACQ_REL) )
+      free(block);
+  }
+
+  p_mdp->transitionProb = NULL;
+  p_mdp->successor = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mdp_set_transitions( mdp* p_mdp, const double * transitions )
+{
+  unsigned int row, numRows, successor, entry;
+  const double * rowProb;
+
+  numRows = p_mdp->numStates * p_mdp->numActions;
+
+  // Count nonzero entries in each row to size the successor arrays. A
+  // mapped model's row offsets live in its private (copy-on-write)
+  // mapping, so are rewritten there without touching the file
+  entry = 0;
+  for (row=0 ; row < numRows ; row++)
+  {
+    p_mdp->transitionStart[row] = entry;
+    rowProb = transitions + (size_t)row * p_mdp->numStates;
+
+    for (successor=0 ; successor < p_mdp->numStates ; successor++)
+      if (0 != rowProb[successor])
+	entry++;
+  }
+  p_mdp->transitionStart[numRows] = entry;
+
+  // Mapped arrays are left to the mapping; the new ones are private and
+  // freed by mdp_free
+  mdp_release_successors(p_mdp);
+  p_mdp->numTransitions = entry;
+  mdp_malloc_successors(p_mdp);
+
+  // Copy the nonzero entries
+  entry = 0;
+  for (row=0 ; row < numRows ; row++)
+  {
+    rowProb = transitions + (size_t)row * p_mdp->numStates;
+
+    for (successor=0 ; successor < p_mdp->numStates ; successor++)
+      if (0 != rowProb[successor])
+      {
+	p_mdp->successor[entry] = successor;
+	p_mdp->transitionProb[entry] = rowProb[successor];
+	entry++;
+      }
+  }
+
+  // Rebuild any compact copy from the new probabilities; a palette that
+  // no longer fits leaves the exact probabilities rather than a stale copy
+  if ( MDP_PRECISION_DOUBLE != p_mdp->precision &&
+       !mdp_set_precision(p_mdp, p_mdp->precision, NULL) )
+    mdp_set_precision(p_mdp, MDP_PRECISION_DOUBLE, NULL);
+}
 
-    p_mdp->actions[i] = malloc( sizeof(unsigned int) * 
-				p_mdp->numAvailableActions[i] );
+/*  Procedure
+ *    mdp_release_precision
+ *
+ *  Purpose
+ *    Discard an mdp's compact copy of its transition probabilities
+ *
+ *  Parameters
+ *    p_mdp
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    p_mdp->precision is MDP_PRECISION_DOUBLE and the compact arrays are
+ *    freed and NULL
+ */
+static void mdp_release_precision(mdp * p_mdp)
+{
+  // The palette, when there is one, leads the shared block
+  free( p_mdp->palette ? (void*)p_mdp->palette : (void*)p_mdp->transitionFloat );
+
+  p_mdp->precision = MDP_PRECISION_DOUBLE;
+  p_mdp->transitionFloat = NULL;
+  p_mdp->transitionIndex = NULL;
+  p_mdp->palette = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int mdp_set_precision(mdp* p_mdp, mdp_precision precision, double * p_error)
+{
+  double palette[MDP_PALETTE_SIZE], prob, stored, rowError, maxError;
+  unsigned int numPalette, i, low, high, mid, row, numRows, row_end;
+  unsigned char *index;
+  char *block;
+
+  numRows = p_mdp->numStates * p_mdp->numActions;
+
+  if ( MDP_PRECISION_PALETTE == precision )
+  { // Collect the distinct probabilities in ascending order
+    numPalette = 0;
 
-    if ( NULL == p_mdp->actions[i] )
+    for ( i = 0 ; i < p_mdp->numTransitions ; i++ )
     {
-      fprintf(stderr,"mdp_malloc_actions failed: %s (%s)\n",
-	    "Could not allocate actions[i]",
-	      strerror(errno));
-      exit(EXIT_FAILURE);
+      prob = p_mdp->transitionProb[i];
+
+      low = 0;
+      high = numPalette;
+
+      while (low < high)
+      {
+	mid = low + (high - low) / 2;
+
+	if (palette[mid] < prob)
+	  low = mid + 1;
+	else
+	  high = mid;
+      }
+
+      if ( low < numPalette && palette[low] == prob )
+	continue;
+
+      if ( MDP_PALETTE_SIZE == numPalette )
+	return 0; // Too many distinct values to index with a byte
+
+      memmove(palette + low + 1, palette + low,
+	      sizeof(double) * (numPalette - low));
+      palette[low] = prob;
+      numPalette++;
     }
 
+    mdp_release_precision(p_mdp);
+
+    block = arena_malloc( sizeof(double) * MDP_PALETTE_SIZE + 
+			  p_mdp->numTransitions, "mdp_set_precision",
+			  "Could not allocate transitionIndex" );
+
+    p_mdp->palette = (double*)block;
+    p_mdp->transitionIndex = 
+      (unsigned char*)(block + sizeof(double) * MDP_PALETTE_SIZE);
+    memcpy(p_mdp->palette, palette, sizeof(double) * numPalette);
+
+    index = p_mdp->transitionIndex;
+
+    for ( i = 0 ; i < p_mdp->numTransitions ; i++ )
+    {
+      // Runs of equal probabilities are common, so try the last index
+      if ( i > 0 && p_mdp->transitionProb[i] == palette[index[i-1]] )
+      {
+	index[i] = index[i-1];
+	continue;
+      }
+
+      low = 0;
+      high = numPalette - 1;
+
+      while (low < high)
+      {
+	mid = low + (high - low) / 2;
+
+	if (palette[mid] < p_mdp->transitionProb[i])
+	  low = mid + 1;
+	else
+	  high = mid;
+      }
+
+      index[i] = (unsigned char)low;
+    }
   }
-  
+  else if ( MDP_PRECISION_FLOAT == precision )
+  {
+    mdp_release_precision(p_mdp);
+
+    p_mdp->transitionFloat = (float*)
+      arena_malloc( sizeof(float) * p_mdp->numTransitions,
+		    "mdp_set_precision", "Could not allocate transitionFloat" );
+
+    for ( i = 0 ; i < p_mdp->numTransitions ; i++ )
+      p_mdp->transitionFloat[i] = (float)p_mdp->transitionProb[i];
+  }
+  else
+    mdp_release_precision(p_mdp);
+
+  p_mdp->precision = precision;
+
+  if ( NULL != p_error )
+  { // Largest L1 error of any row's distribution
+    maxError = 0;
+    i = 0;
+
+    for ( row = 0 ; row < numRows ; row++ )
+    {
+      rowError = 0;
+      row_end = p_mdp->transitionStart[row + 1];
+
+      for ( ; i < row_end ; i++ )
+      {
+	stored = (MDP_PRECISION_FLOAT == precision) ? 
+	  p_mdp->transitionFloat[i] : p_mdp->transitionProb[i];
+	rowError += fabs(stored - p_mdp->transitionProb[i]);
+      }
+
+      if (rowError > maxError)
+	maxError = rowError;
+    }
+
+    *p_error = maxError;
+  }
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int mdp_precision_parse(const char * name, mdp_precision * p_precision)
+{
+  if (0 == strcmp(name, "double"))
+    *p_precision = MDP_PRECISION_DOUBLE;
+  else if (0 == strcmp(name, "float"))
+    *p_precision = MDP_PRECISION_FLOAT;
+  else if (0 == strcmp(name, "palette"))
+    *p_precision = MDP_PRECISION_PALETTE;
+  else
+    return 0;
+
+  return 1;
 }
 
 /*  Procedure
@@ -400,37 +1139,62 @@ void  mdp_malloc_actions(mdp * p_mdp)
  *    Read the transition matrix from a file and assign values to mdp struct
  *
  *  Parameters
- *   stream
+ *   p_scan
  *   p_mdp
  *
  *  Produces,
  *   [Nothing.]
  *
  *  Preconditions
- *    stream is a valid, open stream that may be read from
- *    The next lines of data in stream is may be read as doubles
+ *    p_scan is a scanner over a valid, open stream
+ *    The next lines of data in p_scan is may be read as doubles
  *
  *  Postconditions
  *    All values in p_mdp->transitionProb are assigned as read from stream
  *    Any failure causes program exit.
  */
-void mdp_read_transitions( FILE * stream, mdp* p_mdp)
+void mdp_read_transitions( mdp_scanner * p_scan, mdp* p_mdp)
 {
   unsigned int i,j,k;
+  unsigned int row, numRows;
+  unsigned int entry, numEntries, maxEntries;
+  double prob;
   
   int count;
 
+  // The file lists P(t|s,a) with t varying slowest, so the nonzero
+  // entries are gathered as (row,t,p) triples and bucketed into rows
+  // afterward; the dense cube is never materialized.
+  unsigned int *entryRow, *entrySuccessor;
+  double *entryProb;
+  
+  numRows = p_mdp->numStates * p_mdp->numActions;
+  numEntries = 0;
+  maxEntries = numRows > 0 ? numRows : 1;
+
+  entryRow = malloc( sizeof(unsigned int) * maxEntries );
+  entrySuccessor = malloc( sizeof(unsigned int) * maxEntries );
+  entryProb = malloc( sizeof(double) * maxEntries );
+
+  if ( NULL == entryRow || NULL == entrySuccessor || NULL == entryProb )
+  {
+    fprintf(stderr,"mdp_read_transitions failed: %s (%s)\n",
+	    "Could not allocate transition entries",
+	    strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
   for (i=0 ; i < p_mdp->numStates ; i++)
     for (j=0 ; j < p_mdp->numStates ; j++)
       for (k=0 ; k< p_mdp->numActions ; k++)
       {
 	// Read/assign entry
-	count = fscanf(stream, "%lf", &(p_mdp->transitionProb[i][j][k]) );
+	count = scan_double(p_scan, &prob );
 
 	// Check for errors
 	if ( EOF == count )
 	{
-	  if ( ferror (stream) )
+	  if ( ferror (p_scan->stream) )
 	    fprintf(stderr,
 		    "mdp_read_transitions failed: %s\n",
 		    strerror(errno));
@@ -449,16 +1213,230 @@ void mdp_read_transitions( FILE * stream, mdp* p_mdp)
 	}
 
 	// Minimal error checking
-	if (p_mdp->transitionProb[i][j][k] < 0)
+	if (prob < 0)
 	  fprintf(stderr,
 		  "mdp_read_transition warning: %s\n",
 		  "Negative transition probability");
-	if (p_mdp->transitionProb[i][j][k] > 1)
+	if (prob > 1)
 	  fprintf(stderr,
 		  "mdp_read_transition warning: %s\n",
 		  "Transition probability exceeds 1");
+
+	if (0 == prob)
+	  continue; // Only nonzero transitions are stored
+
+	// Grow the entry arrays as needed
+	if (numEntries == maxEntries)
+	{
+	  maxEntries *= 2;
+	  entryRow = realloc( entryRow, sizeof(unsigned int) * maxEntries );
+	  entrySuccessor = realloc( entrySuccessor,
+				    sizeof(unsigned int) * maxEntries );
+	  entryProb = realloc( entryProb, sizeof(double) * maxEntries );
+
+	  if ( NULL == entryRow || NULL == entrySuccessor || NULL == entryProb )
+	  {
+	    fprintf(stderr,"mdp_read_transitions failed: %s (%s)\n",
+		    "Could not allocate transition entries",
+		    strerror(errno));
+	    exit(EXIT_FAILURE);
+	  }
+	}
+
+	entryRow[numEntries] = j * p_mdp->numActions + k;
+	entrySuccessor[numEntries] = i;
+	entryProb[numEntries] = prob;
+	numEntries++;
+      }
+
+  // Count the entries in each row, then convert counts to row offsets
+  memset( p_mdp->transitionStart, 0, sizeof(unsigned int) * (numRows + 1) );
+
+  for (entry=0 ; entry < numEntries ; entry++)
+    p_mdp->transitionStart[entryRow[entry] + 1]++;
+
+  for (row=0 ; row < numRows ; row++)
+    p_mdp->transitionStart[row + 1] += p_mdp->transitionStart[row];
+
+  p_mdp->numTransitions = numEntries;
+  mdp_malloc_successors(p_mdp);
+
+  // Place entries in their rows; successors stay ascending because
+  // entries were read in order of t
+  for (entry=0 ; entry < numEntries ; entry++)
+  {
+    row = entryRow[entry];
+    p_mdp->successor[p_mdp->transitionStart[row]] = entrySuccessor[entry];
+    p_mdp->transitionProb[p_mdp->transitionStart[row]] = entryProb[entry];
+    p_mdp->transitionStart[row]++;
+  }
+
+  // Placement advanced each offset to the start of the next row; shift back
+  for (row=numRows ; row > 0 ; row--)
+    p_mdp->transitionStart[row] = p_mdp->transitionStart[row - 1];
+  p_mdp->transitionStart[0] = 0;
+
+  free(entryRow);
+  free(entrySuccessor);
+  free(entryProb);
+}
+
+/*  Procedure
+ *    sparse_scan_check
+ *
+ *  Purpose
+ *    Stop reading sparse transitions when a token did not scan
+ *
+ *  Parameters
+ *   p_scan
+ *   count, the result of scan_unsigned or scan_double
+ *   expected, a description of the token
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    Returns only when count is 1; otherwise prints why (a read error,
+ *    the end of the file or expected) and causes program exit.
+ */
+static void sparse_scan_check( mdp_scanner * p_scan, int count,
+			       const char * expected )
+{
+  if ( EOF == count )
+  {
+    if ( ferror (p_scan->stream) )
+      fprintf(stderr,
+	      "mdp_read_sparse_transitions failed: %s\n",
+	      strerror(errno));
+    else
+      fprintf(stderr, 
+	      "mdp_read_sparse_transitions failed: %s\n",
+	      "Premature end of file");
+    exit(EXIT_FAILURE);
+  }
+  else if (count != 1)
+  {
+    fprintf(stderr,
+	    "mdp_read_sparse_transitions failed: %s\n", expected);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*  Procedure
+ *    mdp_read_sparse_transitions
+ *
+ *  Purpose
+ *    Read transition rows in the sparse format and assign them to the
+ *    mdp struct
+ *
+ *  Parameters
+ *   p_scan
+ *   p_mdp
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_scan is a scanner over a valid, open stream
+ *    The next data in p_scan is the number of nonzero transitions,
+ *    followed by a row for each state s and, within it, each action a:
+ *    the number of successors k, then k pairs of a successor state t
+ *    and the probability P(t|s,a)
+ *
+ *  Postconditions
+ *    The transition rows of p_mdp are assigned as read from stream, with
+ *    the successors of each row sorted. The entries are stored directly;
+ *    no dense table is built.
+ *    Any failure causes program exit.
+ */
+void mdp_read_sparse_transitions( mdp_scanner * p_scan, mdp* p_mdp)
+{
+  unsigned int row, numRows, entry, length, i, j, successor;
+  double prob;
+
+  numRows = p_mdp->numStates * p_mdp->numActions;
+
+  // Read the number of entries, which sizes the successor arrays
+  sparse_scan_check(p_scan, scan_unsigned(p_scan, &(p_mdp->numTransitions)),
+		    "Unable to match unsigned int for numTransitions");
+
+  mdp_malloc_successors(p_mdp);
+
+  entry = 0;
+
+  for (row=0 ; row < numRows ; row++)
+  {
+    p_mdp->transitionStart[row] = entry;
+
+    // Read and check the row length before any of its pairs
+    sparse_scan_check(p_scan, scan_unsigned(p_scan, &length),
+		      "Unable to match unsigned int for row length");
+
+    if (length > p_mdp->numTransitions - entry)
+    {
+      fprintf(stderr,
+	      "mdp_read_sparse_transitions failed: %s\n",
+	      "Rows exceed numTransitions");
+      exit(EXIT_FAILURE);
+    }
+
+    for (i=0 ; i < length ; i++)
+    {
+      sparse_scan_check(p_scan, scan_unsigned(p_scan, &successor),
+			"Unable to match unsigned int for successor");
+      sparse_scan_check(p_scan, scan_double(p_scan, &prob),
+			"Unable to match double for transition probability");
+
+      if (successor >= p_mdp->numStates)
+      {
+	fprintf(stderr,
+		"mdp_read_sparse_transitions failed: %s\n",
+		"Successor state index exceeds bound");
+	exit(EXIT_FAILURE);
+      }
+
+      // Minimal error checking
+      if (prob < 0)
+	fprintf(stderr,
+		"mdp_read_sparse_transitions warning: %s\n",
+		"Negative transition probability");
+      if (prob > 1)
+	fprintf(stderr,
+		"mdp_read_sparse_transitions warning: %s\n",
+		"Transition probability exceeds 1");
+
+      // Insert, keeping the row's successors ascending
+      for (j = entry ; j > p_mdp->transitionStart[row] && 
+	     p_mdp->successor[j-1] > successor ; j--)
+      {
+	p_mdp->successor[j] = p_mdp->successor[j-1];
+	p_mdp->transitionProb[j] = p_mdp->transitionProb[j-1];
+      }
+
+      if (j > p_mdp->transitionStart[row] && 
+	  p_mdp->successor[j-1] == successor)
+      {
+	fprintf(stderr,
+		"mdp_read_sparse_transitions failed: %s\n",
+		"Successor repeated within a row");
+	exit(EXIT_FAILURE);
       }
 
+      p_mdp->successor[j] = successor;
+      p_mdp->transitionProb[j] = prob;
+      entry++;
+    }
+  }
+
+  p_mdp->transitionStart[numRows] = entry;
+
+  if (entry != p_mdp->numTransitions)
+  {
+    fprintf(stderr,
+	    "mdp_read_sparse_transitions failed: %s\n",
+	    "Rows do not match numTransitions");
+    exit(EXIT_FAILURE);
+  }
 }
 
 /*  Procedure
@@ -469,22 +1447,22 @@ void mdp_read_transitions( FILE * stream, mdp* p_mdp)
  *    values to mdp struct
  *
  *  Parameters
- *   stream
+ *   p_scan
  *   p_mdp
  *
  *  Produces,
  *   [Nothing.]
  *
  *  Preconditions
- *    stream is a valid, open stream that may be read from
- *    The next line of data in stream is may be read as unsigned ints
+ *    p_scan is a scanner over a valid, open stream
+ *    The next line of data in p_scan is may be read as unsigned ints
  *
  *  Postconditions
  *    All values in p_mdp->numAvailableActions are assigned as read from stream
  *    Any failure causes program exit.
  */
 
-void mdp_read_available_actions(FILE * stream, mdp* p_mdp)
+void mdp_read_available_actions(mdp_scanner * p_scan, mdp* p_mdp)
 {
   unsigned int i;
 
@@ -493,12 +1471,12 @@ void mdp_read_available_actions(FILE * stream, mdp* p_mdp)
   for (i=0 ; i < p_mdp->numStates ; i++)
   {
     // Read/assign entry
-    count = fscanf(stream, "%ud", &(p_mdp->numAvailableActions[i]) );
+    count = scan_unsigned(p_scan, &(p_mdp->numAvailableActions[i]) );
 
     // Check for errors
     if ( EOF == count )
     {
-      if ( ferror (stream) )
+      if ( ferror (p_scan->stream) )
 	fprintf(stderr,
 		"mdp_read_available_actions failed: %s\n",
 		strerror(errno));
@@ -527,10 +1505,47 @@ void mdp_read_available_actions(FILE * stream, mdp* p_mdp)
   }
 }
 
+static mdp * mdp_copy( const mdp * p_mdp, int share );
+
 ////////////////////////////////////////////////////////////////////////////////
 mdp * mdp_duplicate( mdp * p_mdp )
 {
-  unsigned int s,t; // Loop variables: states s and t
+  return mdp_copy( p_mdp, 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+mdp * mdp_duplicate_shared( const mdp * p_mdp )
+{
+  // A mapped model's transitions belong to its mapping, so are copied
+  return mdp_copy( p_mdp, mdp_owns_successors(p_mdp) );
+}
+
+/*  Procedure
+ *    mdp_copy
+ *
+ *  Purpose
+ *    Construct a clone of an MDP, perhaps sharing its transitions
+ *
+ *  Parameters
+ *    p_mdp
+ *    share
+ *
+ *  Produces,
+ *    p_mdp_out, an mdp*
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct; when share is nonzero, its
+ *    transitions came from mdp_malloc_successors
+ *
+ *  Postconditions
+ *    p_mdp_out is a copy of p_mdp as described for mdp_duplicate, except
+ *    that when share is nonzero its successor and transitionProb arrays
+ *    are those of p_mdp, with their reference count incremented
+ *    Any failure causes program exit.
+ */
+static mdp * mdp_copy( const mdp * p_mdp, int share )
+{
+  unsigned int s; // Loop variable: states s
 
   // Allocate a new struct
   mdp * p_mdp_out = mdp_malloc( p_mdp->numStates, p_mdp->numActions);
@@ -546,11 +1561,32 @@ mdp * mdp_duplicate( mdp * p_mdp )
 	  sizeof(unsigned int) * p_mdp->numStates );
 
   // Copy transitions to output struct
-  for ( s=0 ; s < p_mdp->numStates ; s++)
-    for ( t=0 ; t < p_mdp->numStates ; t++)
-      memcpy( p_mdp_out->transitionProb[s][t],
-	      p_mdp->transitionProb[s][t],
-	      sizeof(unsigned int) *  p_mdp->numActions);
+  memcpy( p_mdp_out->transitionStart,
+	  p_mdp->transitionStart,
+	  sizeof(unsigned int) * (p_mdp->numStates * p_mdp->numActions + 1) );
+
+  p_mdp_out->numTransitions = p_mdp->numTransitions;
+
+  if (share)
+  {
+    __atomic_add_fetch((unsigned int*)((char*)p_mdp->transitionProb - 
+				       MDP_ARENA_ALIGN), 
+		       1, __ATOMIC_RELAXED);
+
+    p_mdp_out->successor = p_mdp->successor;
+    p_mdp_out->transitionProb = p_mdp->transitionProb;
+  }
+  else
+  {
+    mdp_malloc_successors( p_mdp_out );
+
+    memcpy( p_mdp_out->successor,
+	    p_mdp->successor,
+	    sizeof(unsigned int) * p_mdp->numTransitions );
+    memcpy( p_mdp_out->transitionProb,
+	    p_mdp->transitionProb,
+	    sizeof(double) * p_mdp->numTransitions );
+  }
 
   // Allocate actions
   mdp_malloc_actions( p_mdp_out );
@@ -571,6 +1607,9 @@ mdp * mdp_duplicate( mdp * p_mdp )
 	  p_mdp->terminal,
 	  sizeof(unsigned int) * p_mdp->numStates );
 
+  // Store transitions as the original does
+  mdp_set_precision( p_mdp_out, p_mdp->precision, NULL );
+
   return p_mdp_out;
 }
 
@@ -583,21 +1622,21 @@ mdp * mdp_duplicate( mdp * p_mdp )
  *    assign values to mdp struct
  *
  *  Parameters
- *   stream
+ *   p_scan
  *   p_mdp
  *
  *  Produces,
  *   [Nothing.]
  *
  *  Preconditions
- *    stream is a valid, open stream that may be read from
- *    The next lines of data in stream is may be read as unsigned integers
+ *    p_scan is a scanner over a valid, open stream
+ *    The next lines of data in p_scan is may be read as unsigned integers
  *
  *  Postconditions
  *    All values in p_mdp->actions are assigned as read from stream
  *    Any failure causes program exit.
  */
-void mdp_read_actions( FILE * stream, mdp* p_mdp)
+void mdp_read_actions( mdp_scanner * p_scan, mdp* p_mdp)
 {
   unsigned int i,j;
   
@@ -607,12 +1646,12 @@ void mdp_read_actions( FILE * stream, mdp* p_mdp)
     for (j=0 ; j < p_mdp->numAvailableActions[i] ; j++)
     {
       // Read/assign entry
-      count = fscanf(stream, "%ud", &(p_mdp->actions[i][j]) );
+      count = scan_unsigned(p_scan, &(p_mdp->actions[i][j]) );
 
       // Check for errors
       if ( EOF == count )
       {
-	if ( ferror (stream) )
+	if ( ferror (p_scan->stream) )
 	  fprintf(stderr,
 		  "mdp_read_actions failed: %s\n",
 		  strerror(errno));
@@ -650,21 +1689,21 @@ void mdp_read_actions( FILE * stream, mdp* p_mdp)
  *    Read the rewards from a file and assign values to mdp struct
  *
  *  Parameters
- *   stream
+ *   p_scan
  *   p_mdp
  *
  *  Produces,
  *   [Nothing.]
  *
  *  Preconditions
- *    stream is a valid, open stream that may be read from
- *    The next line of data in stream is may be read as doubles
+ *    p_scan is a scanner over a valid, open stream
+ *    The next line of data in p_scan is may be read as doubles
  *
  *  Postconditions
  *    All values in p_mdp->rewards are assigned as read from stream
  *    Any failure causes program exit.
  */
-void mdp_read_rewards(FILE * stream, mdp * p_mdp)
+void mdp_read_rewards(mdp_scanner * p_scan, mdp * p_mdp)
 {
   unsigned int i;
   int count;
@@ -672,12 +1711,12 @@ void mdp_read_rewards(FILE * stream, mdp * p_mdp)
   for (i=0 ; i < p_mdp->numStates ; i++)
   {
     // Read/assign entry
-    count = fscanf(stream, "%lf", &(p_mdp->rewards[i]) );
+    count = scan_double(p_scan, &(p_mdp->rewards[i]) );
 
     // Check for errors
     if ( EOF == count )
     {
-      if ( ferror (stream) )
+      if ( ferror (p_scan->stream) )
 	fprintf(stderr,
 		"mdp_read_rewards failed: %s\n",
 		strerror(errno));
@@ -704,22 +1743,22 @@ void mdp_read_rewards(FILE * stream, mdp * p_mdp)
  *    Read the terminal states from a file and assign values to mdp struct
  *
  *  Parameters
- *   stream
+ *   p_scan
  *   p_mdp
  *
  *  Produces,
  *   [Nothing.]
  *
  *  Preconditions
- *    stream is a valid, open stream that may be read from
- *    The next line of data in stream may be read as unsigned ints
+ *    p_scan is a scanner over a valid, open stream
+ *    The next line of data in p_scan may be read as unsigned ints
  *
  *  Postconditions
  *    Values in p_mdp->terminal are assigned as read from stream
  *    Any failure causes program exit.
  */
 
-void mdp_read_terminal(FILE * stream, mdp* p_mdp)
+void mdp_read_terminal(mdp_scanner * p_scan, mdp* p_mdp)
 {
   unsigned int i;
 
@@ -729,23 +1768,26 @@ void mdp_read_terminal(FILE * stream, mdp* p_mdp)
   for (i=0 ; i < p_mdp->numStates ; i++)
   {
     // Read/assign entry
-    count = fscanf(stream, "%ud", &state );
+    count = scan_unsigned(p_scan, &state );
 
     // Check for errors
-    if ( EOF == count &&  ferror (stream) )
+    if ( EOF == count &&  ferror (p_scan->stream) )
+    {
       fprintf(stderr,
 	      "mdp_read_terminal failed: %s\n",
 	      strerror(errno));
-    else if (count != 1 && !feof(stream))
+      return;
+    }
+    else if ( EOF == count )
+      // Reached end of file, so we're done!
+      return;
+    else if (count != 1)
     {
       fprintf(stderr,
 	      "mdp_read_terminal failed: %s\n",
 	      "Unable to match unsigned int for terminal");
       exit(EXIT_FAILURE);
     }
-    else if ( feof(stream) )
-      // Reached end of file, so we're done!
-      return;
 
     // Validate state value
     if (state >= p_mdp->numStates)
@@ -781,8 +1823,29 @@ mdp* mdp_read(const char * fileName)
     return NULL;
   }
 
+  // Binary files are mapped rather than parsed
+  char magic[sizeof(MDP_BINARY_MAGIC) - 1];
+
+  if ( sizeof(magic) == fread(magic, 1, sizeof(magic), stream) &&
+       0 == memcmp(magic, MDP_BINARY_MAGIC, sizeof(magic)) )
+  {
+    fclose(stream);
+    return mdp_map(fileName);
+  }
+
+  rewind(stream);
+
+  // Tokens are read through a buffered scanner rather than fscanf
+  mdp_scanner scanner;
+  mdp_scanner * p_scan = &scanner;
+
+  scanner_init(p_scan, stream);
+
+  // Sparse files are tagged before the dimensions
+  int sparse = scan_keyword(p_scan, "sparse");
+
   // Get initial data about MDP
-  mdp_read_dimensions(stream, &numStates, &numActions);
+  mdp_read_dimensions(p_scan, &numStates, &numActions);
 
   // Allocate space for  MDP
   p_mdp = mdp_malloc(numStates, numActions);
@@ -792,25 +1855,30 @@ mdp* mdp_read(const char * fileName)
   p_mdp->numActions = numActions;
 
   // Read initial/starting state
-  mdp_read_start(stream, p_mdp);
+  mdp_read_start(p_scan, p_mdp);
 
   // Read transition probability matrix
-  mdp_read_transitions(stream,  p_mdp);
+  if (sparse)
+    mdp_read_sparse_transitions(p_scan, p_mdp);
+  else
+    mdp_read_transitions(p_scan, p_mdp);
 
   // Read number of available actions array
-  mdp_read_available_actions(stream, p_mdp);
+  mdp_read_available_actions(p_scan, p_mdp);
 
   // Allocate secondary actions array
   mdp_malloc_actions(p_mdp);
 
   // Read actions
-  mdp_read_actions(stream, p_mdp);
+  mdp_read_actions(p_scan, p_mdp);
   
   // Read rewards
-  mdp_read_rewards(stream, p_mdp);
+  mdp_read_rewards(p_scan, p_mdp);
 
   // Read terminal states
-  mdp_read_terminal(stream, p_mdp);
+  mdp_read_terminal(p_scan, p_mdp);
+
+  scanner_free(p_scan);
 
   ret = fclose(stream);
 
@@ -858,45 +1926,469 @@ void mdp_read_policy(FILE* stream, const mdp* p_mdp, unsigned int * policy)
   }  
 }
 
-void mdp_free(mdp* p_mdp)
+////////////////////////////////////////////////////////////////////////////////
+void mdp_read_utilities(FILE* stream, const mdp* p_mdp, double * utilities)
 {
+  unsigned int s;
+  int count;
 
-  unsigned int i;
+  for (s=0 ; s < p_mdp->numStates ; s++)
+  {
+    // Read/assign entry; any further numbers on the line are ignored
+    count = fscanf(stream, "%lf", &(utilities[s]) );
 
+    // Check for errors
+    if ( EOF == count )
+    {
+      if ( ferror (stream) )
+	fprintf(stderr,
+		"mdp_read_utilities failed: %s\n",
+		strerror(errno));
+      else
+	fprintf(stderr,
+		"mdp_read_utilities failed: %s\n",
+		"Premature end of file");
+      exit(EXIT_FAILURE);
+    }
+    else if (count != 1)
+    {
+      fprintf(stderr,
+	      "mdp_read_utilities failed: %s\n",
+	      "Unable to match double for utility");
+      exit(EXIT_FAILURE);
+    }
 
-  //----------------------------------------
-  // Transition probability
+    fscanf(stream, "%*[^\n]");
+  }
+}
 
-  mdp_free_transitions(p_mdp->numStates, p_mdp->transitionProb);
+static void mdp_write_states(const mdp* p_mdp, FILE * stream);
 
-  //----------------------------------------
-  // Number of available actions
-  free(p_mdp->numAvailableActions);
-  
+////////////////////////////////////////////////////////////////////////////////
+void mdp_write(const mdp* p_mdp, FILE * stream)
+{
+  unsigned int s, t, a;
+  double prob;
 
-  //----------------------------------------
-  // Available actions
+  fprintf(stream, "%u\n%u\n%u\n", 
+	  p_mdp->numStates, p_mdp->numActions, p_mdp->start);
 
-  for ( i=0 ; i < p_mdp->numStates ; i++)
-    free(p_mdp->actions[i]);
+  // Transitions, with t varying slowest as mdp_read_transitions expects
+  for (t=0 ; t < p_mdp->numStates ; t++)
+    for (s=0 ; s < p_mdp->numStates ; s++)
+    {
+      for (a=0 ; a < p_mdp->numActions ; a++)
+      {
+	prob = mdp_transition(p_mdp, t, s, a);
+
+	if (0 == prob)
+	  fputs("0 ", stream);
+	else
+	  fprintf(stream, "%.17g ", prob);
+      }
+      fputc('\n', stream);
+    }
 
-  free(p_mdp->actions);
+  mdp_write_states(p_mdp, stream);
+}
 
-  //----------------------------------------
-  // Rewards
-  free(p_mdp->rewards);
+////////////////////////////////////////////////////////////////////////////////
+void mdp_write_sparse(const mdp* p_mdp, FILE * stream)
+{
+  unsigned int row, numRows, i;
 
+  fprintf(stream, "sparse\n%u %u\n%u\n%u\n", 
+	  p_mdp->numStates, p_mdp->numActions, p_mdp->start,
+	  p_mdp->numTransitions);
 
-  //----------------------------------------
-  // Terminal states
-  free(p_mdp->terminal);
-  
-  //----------------------------------------
-  // Root structure
-  free(p_mdp);
-  
+  // One row per (s,a): successor count, then successor/probability pairs
+  numRows = p_mdp->numStates * p_mdp->numActions;
+
+  for (row=0 ; row < numRows ; row++)
+  {
+    fprintf(stream, "%u", 
+	    p_mdp->transitionStart[row+1] - p_mdp->transitionStart[row]);
+
+    for (i=p_mdp->transitionStart[row] ; i < p_mdp->transitionStart[row+1] ;
+	 i++)
+      fprintf(stream, " %u %.17g", p_mdp->successor[i], 
+	      p_mdp->transitionProb[i]);
+
+    fputc('\n', stream);
+  }
+
+  mdp_write_states(p_mdp, stream);
+}
+
+/*  Procedure
+ *    mdp_write_states
+ *
+ *  Purpose
+ *    Write the per-state fields of an MDP, which follow the transitions
+ *    in both text formats
+ *
+ *  Parameters
+ *   p_mdp
+ *   stream
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    Available action counts, actions, rewards and terminal states are
+ *    written to stream
+ */
+static void mdp_write_states(const mdp* p_mdp, FILE * stream)
+{
+  unsigned int s, a;
+
+  for (s=0 ; s < p_mdp->numStates ; s++)
+    fprintf(stream, "%u ", p_mdp->numAvailableActions[s]);
+  fputc('\n', stream);
+
+  for (s=0 ; s < p_mdp->numStates ; s++)
+  {
+    for (a=0 ; a < p_mdp->numAvailableActions[s] ; a++)
+      fprintf(stream, "%u ", p_mdp->actions[s][a]);
+    fputc('\n', stream);
+  }
+
+  for (s=0 ; s < p_mdp->numStates ; s++)
+    fprintf(stream, "%.17g ", p_mdp->rewards[s]);
+  fputc('\n', stream);
+
+  for (s=0 ; s < p_mdp->numStates ; s++)
+    if (p_mdp->terminal[s])
+      fprintf(stream, "%u ", s);
+  fputc('\n', stream);
+}
+
+/*  Procedure
+ *    mdp_binary_layout
+ *
+ *  Purpose
+ *    Compute the section offsets of a binary MDP file
+ *
+ *  Parameters
+ *   p_header
+ *
+ *  Produces,
+ *   length, the total file length in bytes
+ *
+ *  Preconditions
+ *    The dimension fields of *p_header are assigned
+ *
+ *  Postconditions
+ *    p_header->offset[] holds 8-byte aligned, consecutive section offsets
+ *    following the header
+ */
+static unsigned long long mdp_binary_layout( mdp_binary_header * p_header )
+{
+  unsigned long long size[MDP_NUM_SECTIONS];
+  unsigned long long position;
+  int section;
+
+  size[MDP_SECTION_TRANSITION_PROB] = 
+    sizeof(double) * (unsigned long long)p_header->numTransitions;
+  size[MDP_SECTION_REWARDS] = 
+    sizeof(double) * (unsigned long long)p_header->numStates;
+  size[MDP_SECTION_TRANSITION_START] = sizeof(unsigned int) * 
+    ((unsigned long long)p_header->numStates * p_header->numActions + 1);
+  size[MDP_SECTION_SUCCESSOR] = 
+    sizeof(unsigned int) * (unsigned long long)p_header->numTransitions;
+  size[MDP_SECTION_NUM_AVAILABLE_ACTIONS] = 
+    sizeof(unsigned int) * (unsigned long long)p_header->numStates;
+  size[MDP_SECTION_ACTIONS] = 
+    sizeof(unsigned int) * (unsigned long long)p_header->numActionEntries;
+  size[MDP_SECTION_TERMINAL] = 
+    sizeof(unsigned int) * (unsigned long long)p_header->numStates;
+
+  position = sizeof(mdp_binary_header);
+
+  for (section = 0 ; section < MDP_NUM_SECTIONS ; section++)
+  {
+    position = (position + 7) & ~7ULL;
+    p_header->offset[section] = position;
+    position += size[section];
+  }
+
+  return position;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int mdp_write_binary(const mdp* p_mdp, const char * fileName)
+{
+  mdp_binary_header header;
+  unsigned long long position;
+  unsigned int s;
+  int section;
+  static const char padding[8] = { 0 };
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MDP_BINARY_MAGIC, sizeof(header.magic));
+  header.byteOrder = MDP_BINARY_BYTE_ORDER;
+  header.version = MDP_BINARY_VERSION;
+  header.numStates = p_mdp->numStates;
+  header.numActions = p_mdp->numActions;
+  header.start = p_mdp->start;
+  header.numTransitions = p_mdp->numTransitions;
+
+  for (s=0 ; s < p_mdp->numStates ; s++)
+    header.numActionEntries += p_mdp->numAvailableActions[s];
+
+  mdp_binary_layout(&header);
+
+  FILE* stream = fopen(fileName, "wb");
+
+  if ( NULL == stream )
+  {
+    fprintf(stderr, 
+	    "mdp_write_binary(\"%s\") failed: %s\n",
+	    fileName,
+	    strerror(errno));
+    return -1;
+  }
+
+  fwrite(&header, sizeof(header), 1, stream);
+  position = sizeof(header);
+
+  for (section = 0 ; section < MDP_NUM_SECTIONS ; section++)
+  {
+    // Pad to the section offset
+    fwrite(padding, 1, header.offset[section] - position, stream);
+
+    switch (section)
+    {
+    case MDP_SECTION_TRANSITION_PROB:
+      fwrite(p_mdp->transitionProb, sizeof(double), 
+	     p_mdp->numTransitions, stream);
+      break;
+    case MDP_SECTION_REWARDS:
+      fwrite(p_mdp->rewards, sizeof(double), p_mdp->numStates, stream);
+      break;
+    case MDP_SECTION_TRANSITION_START:
+      fwrite(p_mdp->transitionStart, sizeof(unsigned int), 
+	     p_mdp->numStates * p_mdp->numActions + 1, stream);
+      break;
+    case MDP_SECTION_SUCCESSOR:
+      fwrite(p_mdp->successor, sizeof(unsigned int), 
+	     p_mdp->numTransitions, stream);
+      break;
+    case MDP_SECTION_NUM_AVAILABLE_ACTIONS:
+      fwrite(p_mdp->numAvailableActions, sizeof(unsigned int), 
+	     p_mdp->numStates, stream);
+      break;
+    case MDP_SECTION_ACTIONS:
+      for (s=0 ; s < p_mdp->numStates ; s++)
+	fwrite(p_mdp->actions[s], sizeof(unsigned int), 
+	       p_mdp->numAvailableActions[s], stream);
+      break;
+    case MDP_SECTION_TERMINAL:
+      fwrite(p_mdp->terminal, sizeof(unsigned int), 
+	     p_mdp->numStates, stream);
+      break;
+    }
+
+    position = ftell(stream);
+  }
+
+  if ( ferror(stream) )
+  {
+    fprintf(stderr, 
+	    "mdp_write_binary(\"%s\") failed: %s\n",
+	    fileName,
+	    strerror(errno));
+    fclose(stream);
+    return -1;
+  }
+
+  if ( 0 != fclose(stream) )
+  {
+    fprintf(stderr,
+	    "mdp_write_binary(\"%s\") Error closing file: %s\n",
+	    fileName,
+	    strerror(errno));
+    return -1;
+  }
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+mdp* mdp_map(const char * fileName)
+{
+  mdp_binary_header header;
+  mdp* p_mdp;
+  struct stat info;
+  unsigned long long length;
+  size_t rootLength, actionsOffset;
+  unsigned int s, entry, numRows;
+  unsigned int *flatActions;
+  char *base;
+  const char *problem = NULL;
+  int fd;
+
+  fd = open(fileName, O_RDONLY);
+
+  if ( fd < 0 || 0 != fstat(fd, &info) )
+  {
+    fprintf(stderr, 
+	    "mdp_map(\"%s\") failed: %s\n",
+	    fileName,
+	    strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+
+  // Validate the header before trusting any offsets
+  if ( info.st_size < (off_t)sizeof(header) ||
+       sizeof(header) != read(fd, &header, sizeof(header)) )
+    problem = "File too short for header";
+  else if ( 0 != memcmp(header.magic, MDP_BINARY_MAGIC, sizeof(header.magic)) )
+    problem = "Not a binary MDP file";
+  else if ( MDP_BINARY_BYTE_ORDER != header.byteOrder )
+    problem = "File was written with a different byte order";
+  else if ( MDP_BINARY_VERSION != header.version )
+    problem = "Unsupported binary MDP version";
+  else
+  {
+    mdp_binary_header expected = header;
+    length = mdp_binary_layout(&expected);
+
+    if ( 0 != memcmp(expected.offset, header.offset, sizeof(header.offset)) )
+      problem = "Section offsets do not match dimensions";
+    else if ( (unsigned long long)info.st_size < length )
+      problem = "File too short for its dimensions";
+  }
+
+  if ( NULL != problem )
+  {
+    fprintf(stderr, "mdp_map(\"%s\") failed: %s\n", fileName, problem);
+    close(fd);
+    return NULL;
+  }
+
+  // Map privately so callers may modify (e.g.) rewards in memory
+  base = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if ( MAP_FAILED == base )
+  {
+    fprintf(stderr, 
+	    "mdp_map(\"%s\") failed: %s\n",
+	    fileName,
+	    strerror(errno));
+    return NULL;
+  }
+
+  // The root structure and the outer actions array share one block
+  rootLength = sizeof(mdp);
+  actionsOffset = arena_section(&rootLength, sizeof(unsigned int*) * 
+				header.numStates);
+
+  p_mdp = (mdp*)arena_malloc(rootLength, "mdp_map", "Could not allocate mdp");
+
+  p_mdp->numStates = header.numStates;
+  p_mdp->numActions = header.numActions;
+  p_mdp->start = header.start;
+  p_mdp->numTransitions = header.numTransitions;
+  p_mdp->mapping = base;
+  p_mdp->mappingLength = info.st_size;
+  p_mdp->precision = MDP_PRECISION_DOUBLE;
+  p_mdp->transitionFloat = NULL;
+  p_mdp->transitionIndex = NULL;
+  p_mdp->palette = NULL;
+
+  p_mdp->transitionProb = 
+    (double*)(base + header.offset[MDP_SECTION_TRANSITION_PROB]);
+  p_mdp->rewards = (double*)(base + header.offset[MDP_SECTION_REWARDS]);
+  p_mdp->transitionStart = 
+    (unsigned int*)(base + header.offset[MDP_SECTION_TRANSITION_START]);
+  p_mdp->successor = 
+    (unsigned int*)(base + header.offset[MDP_SECTION_SUCCESSOR]);
+  p_mdp->numAvailableActions = 
+    (unsigned int*)(base + header.offset[MDP_SECTION_NUM_AVAILABLE_ACTIONS]);
+  p_mdp->terminal = 
+    (unsigned int*)(base + header.offset[MDP_SECTION_TERMINAL]);
+  flatActions = (unsigned int*)(base + header.offset[MDP_SECTION_ACTIONS]);
+
+  // Check everything the text readers would have rejected, in one pass
+  // per section, since every solver indexes with these values unchecked
+  numRows = header.numStates * header.numActions;
+
+  if ( header.numStates > 0 && header.start >= header.numStates )
+    problem = "Start state index exceeds bound";
+  else if ( 0 != p_mdp->transitionStart[0] ||
+	    header.numTransitions != p_mdp->transitionStart[numRows] )
+    problem = "Transition rows do not match numTransitions";
+
+  // Row offsets must never decrease, so every row stays within the
+  // successor arrays
+  for (entry=0 ; entry < numRows && NULL == problem ; entry++)
+    if ( p_mdp->transitionStart[entry] > p_mdp->transitionStart[entry+1] )
+      problem = "Transition row offsets decrease";
+
+  for (entry=0 ; entry < header.numTransitions && NULL == problem ; entry++)
+    if ( p_mdp->successor[entry] >= header.numStates )
+      problem = "Successor state index exceeds bound";
+
+  // Point each state's action list into the flat section
+  p_mdp->actions = (unsigned int**)((char*)p_mdp + actionsOffset);
+
+  entry = 0;
+  for (s=0 ; s < header.numStates && NULL == problem ; s++)
+  {
+    p_mdp->actions[s] = flatActions + entry;
+
+    if ( p_mdp->numAvailableActions[s] > header.numActions )
+      problem = "Available actions exceed numActions";
+    else if ( p_mdp->numAvailableActions[s] > 
+	      header.numActionEntries - entry )
+      problem = "Available actions exceed numActionEntries";
+    else
+      entry += p_mdp->numAvailableActions[s];
+  }
+
+  for (entry=0 ; entry < header.numActionEntries && NULL == problem ; entry++)
+    if ( flatActions[entry] >= header.numActions )
+      problem = "Action index exceeds bound";
+
+  if ( NULL != problem )
+  {
+    fprintf(stderr, "mdp_map(\"%s\") failed: %s\n", fileName, problem);
+    mdp_free(p_mdp);
+    return NULL;
+  }
+
+  return p_mdp;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void mdp_free(mdp* p_mdp)
+{
+
+  mdp_release_precision(p_mdp);
 
+  //----------------------------------------
+  // Transition probability (also holds successor), perhaps shared; a
+  // mapped model's own are released with the mapping
+  mdp_release_successors(p_mdp);
+
+  if ( NULL != p_mdp->mapping )
+  { // Only the root block (with the outer actions array) is allocated
+    munmap(p_mdp->mapping, p_mdp->mappingLength);
+    free(p_mdp);
+    return;
+  }
 
+  //----------------------------------------
+  // Available actions, whose lists are consecutive from actions[0]
+  if ( p_mdp->numStates > 0 )
+    free(p_mdp->actions[0]);
 
+  //----------------------------------------
+  // Root structure, with every per-state array
+  free(p_mdp);
+  
+}
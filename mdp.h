@@ -11,13 +11,43 @@
 #ifndef MDP_H
 #define MDP_H
 
+#include <stddef.h>
+#include <stdio.h>
+
+/* How the solvers read transition probabilities (see mdp_set_precision) */
+typedef enum {
+  MDP_PRECISION_DOUBLE,  /* transitionProb itself */
+  MDP_PRECISION_FLOAT,   /* transitionFloat, rounded to single precision */
+  MDP_PRECISION_PALETTE  /* palette[transitionIndex[i]] */
+} mdp_precision;
+
+/* Largest palette of distinct probabilities, so indices fit a byte */
+#define MDP_PALETTE_SIZE 256
+
+/* Shortfall below one at which a transition row is taken to leave the
+   model (ending a simulated trajectory) rather than to have rounded */
+#define MDP_ROW_SLACK 1e-9
+
 typedef struct {
   unsigned int numStates;  /* Discrete total number of possible states */
   unsigned int numActions; /* Discrete total number of possible actions */
   unsigned int start;      /* Value of starting state */
-  double ***transitionProb;/* A numStates x numStates x numActions array of
+  unsigned int numTransitions; /* Number of nonzero transition probabilities
+				  stored for the model world */
+  unsigned int *transitionStart; /* A numStates*numActions+1 length array of
+				    row offsets: the successors of state s
+				    under action a occupy entries
+				    transitionStart[s*numActions+a] up to (but
+				    excluding) transitionStart[s*numActions+a+1]
+				    of successor and transitionProb */
+  unsigned int *successor; /* A numTransitions length array of successor
+			      states t, ascending within each (s,a) row */
+  double *transitionProb;  /* A numTransitions length array of nonzero
 			      transition probabilities for the model world:
-			      transitionProb[t][s][a] := P(t|s,a) */
+			      transitionProb[i] := P(successor[i]|s,a).
+			      The successor array shares this allocation,
+			      which copies from mdp_duplicate_shared may
+			      also share. */
   unsigned int *numAvailableActions; /* A numStates length array, each
 				       entry indicating the number of
 				       actions available in the given state */
@@ -27,8 +57,64 @@ typedef struct {
 			      for a given state */
   unsigned int *terminal;  /* A numStates length array, each entry indicating
 			      whether a given state is terminal */
+  mdp_precision precision; /* Which copy of the probabilities the
+			      expected utility kernels read */
+  float *transitionFloat;  /* With MDP_PRECISION_FLOAT, a numTransitions
+			      length copy of transitionProb; else NULL */
+  unsigned char *transitionIndex; /* With MDP_PRECISION_PALETTE, a
+				     numTransitions length array of
+				     indices into palette; else NULL */
+  double *palette;         /* With MDP_PRECISION_PALETTE, the distinct
+			      values of transitionProb (at most
+			      MDP_PALETTE_SIZE); else NULL. transitionFloat,
+			      transitionIndex and palette share one
+			      allocation. */
+  void *mapping;           /* A memory-mapped binary MDP file holding the
+			      arrays above (all but the outer actions
+			      array), or NULL when they are allocated */
+  size_t mappingLength;    /* Length of mapping in bytes */
 } mdp;
 
+/* Binary MDP files (see mdp_write_binary) begin with this header,
+ * written in native byte order. Each section is an array aligned to 8
+ * bytes at the given offset from the start of the file:
+ *   transitionProb       numTransitions doubles
+ *   rewards              numStates doubles
+ *   transitionStart      numStates*numActions+1 unsigned ints
+ *   successor            numTransitions unsigned ints
+ *   numAvailableActions  numStates unsigned ints
+ *   actions              numActionEntries unsigned ints, the available
+ *                        actions of each state in turn
+ *   terminal             numStates unsigned ints
+ */
+#define MDP_BINARY_MAGIC "MDPBIN\r\n"
+#define MDP_BINARY_BYTE_ORDER 0x01020304u
+#define MDP_BINARY_VERSION 1u
+
+typedef enum {
+  MDP_SECTION_TRANSITION_PROB,
+  MDP_SECTION_REWARDS,
+  MDP_SECTION_TRANSITION_START,
+  MDP_SECTION_SUCCESSOR,
+  MDP_SECTION_NUM_AVAILABLE_ACTIONS,
+  MDP_SECTION_ACTIONS,
+  MDP_SECTION_TERMINAL,
+  MDP_NUM_SECTIONS
+} mdp_binary_section;
+
+typedef struct {
+  char magic[8];               /* MDP_BINARY_MAGIC, without terminator */
+  unsigned int byteOrder;      /* MDP_BINARY_BYTE_ORDER as written */
+  unsigned int version;        /* MDP_BINARY_VERSION */
+  unsigned int numStates;
+  unsigned int numActions;
+  unsigned int start;
+  unsigned int numTransitions;
+  unsigned int numActionEntries; /* Sum of numAvailableActions */
+  unsigned int reserved;         /* Zero */
+  unsigned long long offset[MDP_NUM_SECTIONS]; /* Byte offset of sections */
+} mdp_binary_header;
+
 
 /*  Procedure
  *    mdp_read
@@ -44,7 +130,9 @@ typedef struct {
  *
  *  Preconditions
  *    fileName is a null-terminated string (character array) that refers to a 
- *    readable file containing a valid MDP description
+ *    readable file containing a valid MDP description, either as dense
+ *    text, as sparse text (see mdp_write_sparse), or in the binary format
+ *    (which is mapped with mdp_map)
  *
  *  Postconditions
  *    Memory is allocated for all fields in pmdp. p_mdp is populated
@@ -53,6 +141,161 @@ typedef struct {
 mdp* mdp_read(const char * fileName);
 
 
+/*  Procedure
+ *    mdp_write
+ *
+ *  Purpose
+ *    Write an MDP to a file stream in the dense text format read by mdp_read
+ *
+ *  Parameters
+ *   p_mdp, an mdp*
+ *   stream
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *    stream is a valid, open stream that may be written to
+ *
+ *  Postconditions
+ *    The full numStates x numStates x numActions transition table and
+ *    the remaining fields of p_mdp are written to stream, with
+ *    probabilities and rewards printed so they read back exactly.
+ */
+void mdp_write(const mdp* p_mdp, FILE * stream);
+
+/*  Procedure
+ *    mdp_write_sparse
+ *
+ *  Purpose
+ *    Write an MDP to a file stream in the sparse text format
+ *
+ *  Parameters
+ *   p_mdp, an mdp*
+ *   stream
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *    stream is a valid, open stream that may be written to
+ *
+ *  Postconditions
+ *    stream holds the tag "sparse", the dimensions, start and number of
+ *    nonzero transitions, then one line per state s and action a (s
+ *    varying slowest) listing the number of successors followed by each
+ *    successor t and P(t|s,a). The remaining fields follow as in the
+ *    dense format. mdp_read recognizes the tag and reads the rows
+ *    without building the dense table.
+ */
+void mdp_write_sparse(const mdp* p_mdp, FILE * stream);
+
+/*  Procedure
+ *    mdp_map
+ *
+ *  Purpose
+ *    Map a binary MDP file into memory
+ *
+ *  Parameters
+ *   fileName, a string
+ *
+ *  Produces,
+ *   p_mdp, an mdp*
+ *
+ *  Preconditions
+ *    fileName refers to a readable file written by mdp_write_binary on a
+ *    machine of the same byte order
+ *
+ *  Postconditions
+ *    p_mdp's arrays point directly into a private mapping of the file;
+ *    only the outer actions array is allocated. Pages are loaded on
+ *    demand, and writes to the arrays are not carried to the file.
+ *    mdp_free releases the mapping. As the text readers do, the file is
+ *    rejected unless the start, every successor and every action are in
+ *    range, no state has more than numActions actions, and transition
+ *    rows never overlap; this reads each index section once. On failure,
+ *    a message is printed and p_mdp is NULL.
+ */
+mdp* mdp_map(const char * fileName);
+
+/*  Procedure
+ *    mdp_write_binary
+ *
+ *  Purpose
+ *    Write an MDP to a binary file
+ *
+ *  Parameters
+ *   p_mdp, an mdp*
+ *   fileName, a string
+ *
+ *  Produces,
+ *   ret, an int
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *
+ *  Postconditions
+ *    fileName contains p_mdp in the binary format, which mdp_map and
+ *    mdp_read accept. ret is zero on success; otherwise a message is
+ *    printed and ret is nonzero.
+ */
+int mdp_write_binary(const mdp* p_mdp, const char * fileName);
+
+/*  Procedure
+ *    mdp_set_precision
+ *
+ *  Purpose
+ *    Choose how solvers store and read an MDP's transition probabilities
+ *
+ *  Parameters
+ *   p_mdp, an mdp*
+ *   precision
+ *   p_error, a double*
+ *
+ *  Produces,
+ *   ok, an int
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *
+ *  Postconditions
+ *    When ok is nonzero, p_mdp->precision is precision and the compact
+ *    copy it names is built from transitionProb (which is kept, for
+ *    writing and for code that reads it directly). The expected utility
+ *    kernels then stream 4 (float) or 1 (palette) byte per probability
+ *    instead of 8, still multiplying and summing in double.
+ *    MDP_PRECISION_PALETTE fails (ok is zero, p_mdp unchanged) when
+ *    transitionProb holds more than MDP_PALETTE_SIZE distinct values;
+ *    the palette itself is exact.
+ *    Unless p_error is NULL, *p_error is the largest sum over a row (s,a)
+ *    of the absolute differences between the stored and the double
+ *    probabilities. Utilities then differ from those of the double
+ *    model by at most gamma * *p_error * max|U| / (1 - gamma).
+ *    Any allocation failure causes program exit.
+ */
+int mdp_set_precision(mdp* p_mdp, mdp_precision precision, double * p_error);
+
+/*  Procedure
+ *    mdp_precision_parse
+ *
+ *  Purpose
+ *    Translate the name of a transition precision
+ *
+ *  Parameters
+ *   name
+ *   p_precision
+ *
+ *  Produces,
+ *   ok, an int
+ *
+ *  Postconditions
+ *    When name is one of "double", "float" or "palette", *p_precision is
+ *    the corresponding precision and ok is nonzero; otherwise ok is zero.
+ */
+int mdp_precision_parse(const char * name, mdp_precision * p_precision);
+
 /*  Procedure
  *    mdp_free
  *
@@ -69,22 +312,165 @@ mdp* mdp_read(const char * fileName);
  *    p_mdp points to a valid mdp struct with all fields having valid references
  *
  *  Postconditions
- *    Memory is freed for all fields in p_mdp
+ *    Memory is freed for all fields in p_mdp, using at most three calls
+ *    to free (see mdp_malloc)
  */
 void mdp_free(mdp* p_mdp);
 
 /*  Procedure
- *    mdp_malloc_transition
+ *    mdp_malloc
  *
  *  Purpose
- *    Allocate arrays for transition probabilities or counts
+ *    Allocate an MDP for construction in memory
+ *
+ *  Parameters
+ *   numStates
+ *   numActions
+ *
+ *  Produces,
+ *   p_mdp, an mdp*
+ *
+ *  Preconditions
+ *    numStates > 0
+ *    numActions > 0
+ *
+ *  Postconditions
+ *    p_mdp->transitionStart, numAvailableActions, actions (the outer
+ *    array), rewards and terminal are allocated with numStates (or
+ *    numStates*numActions+1) entries; terminal is zeroed.
+ *    They lie in a single cache-aligned block with the struct itself,
+ *    and the successor and action arrays add one block each, so an mdp
+ *    of any size takes three allocations.
+ *    The dimension fields, start and the remaining arrays are left for
+ *    the caller, who allocates the successor and per-state action arrays
+ *    with mdp_malloc_successors and mdp_malloc_actions once their
+ *    lengths are known.
+ *    Any failure causes program exit.
+ */
+mdp* mdp_malloc(const unsigned int numStates, const unsigned int numActions);
+
+/*  Procedure
+ *    mdp_malloc_actions
+ *
+ *  Purpose
+ *    Allocate arrays for the available number of actions
+ *
+ *  Parameters
+ *    p_mdp
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to an mdp from mdp_malloc whose numStates and
+ *    numAvailableActions entries are assigned
+ *
+ *  Postconditions
+ *    p_mdp->actions[s] is a valid array of length
+ *    p_mdp->numAvailableActions[s] for each state s; the arrays are
+ *    consecutive in one block beginning at p_mdp->actions[0]
+ *    Any failure causes program exit.
+ */
+void mdp_malloc_actions(mdp * p_mdp);
+
+/*  Procedure
+ *    mdp_malloc_successors
+ *
+ *  Purpose
+ *    Allocate arrays for the nonzero transitions
+ *
+ *  Parameters
+ *    p_mdp
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to an mdp from mdp_malloc whose numTransitions is assigned
+ *
+ *  Postconditions
+ *    p_mdp->transitionProb and p_mdp->successor are valid arrays of
+ *    length p_mdp->numTransitions, in one reference-counted block
+ *    Any failure causes program exit.
+ */
+void mdp_malloc_successors(mdp * p_mdp);
+
+/*  Procedure
+ *    mdp_transition
+ *
+ *  Purpose
+ *    Look up a single transition probability in an MDP
+ *
+ *  Parameters
+ *    p_mdp
+ *    successor
+ *    state
+ *    action
+ *
+ *  Produces,
+ *    prob, a double
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *    0 <= successor < p_mdp->numStates
+ *    0 <= state < p_mdp->numStates
+ *    0 <= action < p_mdp->numActions
+ *
+ *  Postconditions
+ *    prob = P(successor|state,action), which is zero when no such
+ *    transition is stored. Requires time logarithmic in the number of
+ *    successors of (state,action); solvers should walk the rows directly.
+ */
+double mdp_transition(const mdp* p_mdp, unsigned int successor,
+		      unsigned int state, unsigned int action);
+
+/*  Procedure
+ *    mdp_transition_index
+ *
+ *  Purpose
+ *    Locate an entry of a dense transition array
  *
  *  Parameters
  *    numStates
  *    numActions
+ *    successor
+ *    state
+ *    action
  *
  *  Produces,
- *    double transition[numStates][numStates][numActions]
+ *    index, a size_t
+ *
+ *  Preconditions
+ *    0 <= successor < numStates
+ *    0 <= state < numStates
+ *    0 <= action < numActions
+ *
+ *  Postconditions
+ *    transition[index] is the entry for P(successor|state,action) in an
+ *    array produced by mdp_malloc_transitions. Entries are action-major:
+ *    all successors of (state,action) are adjacent.
+ */
+static inline size_t mdp_transition_index(unsigned int numStates,
+					  unsigned int numActions,
+					  unsigned int successor,
+					  unsigned int state,
+					  unsigned int action)
+{
+  return ((size_t)state * numActions + action) * numStates + successor;
+}
+
+/*  Procedure
+ *    mdp_malloc_transitions
+ *
+ *  Purpose
+ *    Allocate a dense array for transition probabilities or counts
+ *
+ *  Parameters
+ *    numStates
+ *    numActions
+ *
+ *  Produces,
+ *    double transition[numStates * numActions * numStates]
  *
  *  Preconditions
  *    numStates > 0
@@ -93,37 +479,97 @@ void mdp_free(mdp* p_mdp);
  *    (e.g., numStates^2 * numActions * sizeof(double)
  *
  *  Postconditions
- *    transition is a pointer to a valid three-dimensional array of size 
- *      numState x numStates x numActions
+ *    transition is a pointer to a single contiguous block laid out as
+ *      [state][action][successor]; use mdp_transition_index to address it
  *    All entries in the array are initialized to zero.
  *    Any failure causes program exit.
  */
-double *** mdp_malloc_transitions(unsigned int numStates, 
-				  unsigned int numActions);
+double * mdp_malloc_transitions(unsigned int numStates, 
+				unsigned int numActions);
 
 /*  Procedure
  *    mdp_free_transitions
  *
  *  Purpose
- *    Free arrays for transition probabilities or counts
+ *    Free an array for transition probabilities or counts
  *
  *  Parameters
  *    numStates
- *    transition[][][]
+ *    transition[]
  *
  *  Produces,
  *    [Nothing.]
  *
  *  Preconditions
- *    numStates > 0
- *    transition is a pointer to a valid three-dimensional array of size 
- *      numStates x numStates x numActions
+ *    transition was produced by mdp_malloc_transitions
+ *
+ *  Postconditions
+ *    The block pointed to by transition is freed
+ */
+
+void mdp_free_transitions( unsigned int numStates, double * transitions );
+
+/*  Procedure
+ *    mdp_set_transitions
+ *
+ *  Purpose
+ *    Replace the transition model of an MDP with a dense array
+ *
+ *  Parameters
+ *    p_mdp
+ *    transition[]
+ *
+ *  Produces,
+ *    [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *    transition is a dense array as produced by mdp_malloc_transitions
+ *      for p_mdp->numStates and p_mdp->numActions
  *
  *  Postconditions
- *    All arrays pointed to by transition are freed
+ *    The transition rows of p_mdp hold exactly the nonzero entries of
+ *    transition. transition is not modified and remains owned by the caller.
+ *    The new successor and transitionProb arrays are allocated; for a
+ *    mapped p_mdp (see mdp_map) the old ones stay in the mapping, which
+ *    is private, so the file is never modified, and mdp_free releases
+ *    both. Copies sharing the old arrays are unaffected.
+ *    A compact copy (see mdp_set_precision) is rebuilt from the new
+ *    probabilities. When they hold more than MDP_PALETTE_SIZE distinct
+ *    values, a palette model reverts to MDP_PRECISION_DOUBLE; callers
+ *    that need to know check p_mdp->precision afterwards.
+ *    Any failure causes program exit.
  */
+void mdp_set_transitions( mdp* p_mdp, const double * transitions );
 
-void mdp_free_transitions( unsigned int numStates, double *** transitions );
+/*  Procedure
+ *    mdp_predecessors
+ *
+ *  Purpose
+ *    List the predecessors of every state in an MDP
+ *
+ *  Parameters
+ *    p_mdp
+ *    p_predecessorStart
+ *    p_predecessor
+ *
+ *  Produces,
+ *    [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *    p_predecessorStart and p_predecessor are not NULL
+ *
+ *  Postconditions
+ *    *p_predecessorStart is a numStates+1 length array of offsets into
+ *    *p_predecessor: the states s with P(t|s,a) > 0 for some action a
+ *    occupy entries (*p_predecessorStart)[t] up to (but excluding)
+ *    (*p_predecessorStart)[t+1], each listed once and in ascending order.
+ *    The caller frees both arrays.
+ *    Any failure causes program exit.
+ */
+void mdp_predecessors( const mdp* p_mdp, unsigned int ** p_predecessorStart,
+		       unsigned int ** p_predecessor );
 
 /*  Procedure
  *    mdp_malloc_state_action
@@ -146,7 +592,8 @@ void mdp_free_transitions( unsigned int numStates, double *** transitions );
  *
  *  Postconditions
  *    count is a pointer to a valid two-dimensional array of size 
- *      numStates x numActions
+ *      numStates x numActions, whose rows and row pointers share one
+ *      allocation
  *    All entries in the array are initialized to zero.
  *    Any failure causes program exit.
  */
@@ -200,6 +647,35 @@ void mdp_free_state_action( unsigned int numStates, double ** count );
  */
 mdp* mdp_duplicate( mdp *  p_mdp);
 
+/*  Procedure
+ *    mdp_duplicate_shared
+ *
+ *  Purpose
+ *    Construct a clone of an MDP that shares its transitions
+ *
+ *  Parameters
+ *    p_mdp
+ *
+ *  Produces,
+ *    p_mdp_out
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *
+ *  Postconditions
+ *    p_mdp_out is a copy of p_mdp as from mdp_duplicate, except that its
+ *    successor and transitionProb arrays are those of p_mdp, so a copy
+ *    costs memory in proportion to numStates*numActions rather than to
+ *    numTransitions. Rewards, terminal flags, actions and row offsets
+ *    are private and may be modified freely; the shared arrays must not
+ *    be written in place, but mdp_set_transitions gives a copy arrays
+ *    of its own. The arrays are freed with the last mdp using them, so
+ *    the copies and p_mdp may be freed in any order (from any thread).
+ *    A mapped p_mdp (see mdp_map) has its transitions copied instead.
+ *    Any failure causes program exit.
+ */
+mdp* mdp_duplicate_shared( const mdp *  p_mdp);
+
 /*  Procedure
  *    mdp_read_policy
  *
@@ -226,5 +702,33 @@ mdp* mdp_duplicate( mdp *  p_mdp);
  *  Postconditions
  */
 
+void mdp_read_policy(FILE* stream, const mdp* p_mdp, unsigned int * policy);
+
+/*  Procedure
+ *    mdp_read_utilities
+ *
+ *  Purpose
+ *    Read utilities for an MDP from a file stream
+ *
+ *  Parameters
+ *    stream
+ *    p_mdp
+ *    utilities
+ *
+ *  Produces,
+ *    [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struct
+ *    utilities is a p_mdp->numStates length array of doubles
+ *    stream holds at least p_mdp->numStates lines, each starting with a
+ *      number, as value_iteration prints them
+ *
+ *  Postconditions
+ *    utilities[s] is the first number on line s of stream; the rest of
+ *    each line (later columns of a batch) is skipped
+ *    Any failure causes program exit.
+ */
+void mdp_read_utilities(FILE* stream, const mdp* p_mdp, double * utilities);
 
 #endif /* MDP_H */
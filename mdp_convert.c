@@ -0,0 +1,96 @@
+/* mdp_convert.c
+ *
+ * Convert an MDP file between the dense text, sparse text, and binary
+ * formats.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "mdp.h"
+
+/*
+ * Main: mdp_convert [-f binary|text|sparse] infile outfile
+ *
+ * Reads the MDP in infile (in any format mdp_read accepts) and writes it
+ * to outfile in the requested format, binary by default.
+ */
+int main(int argc, char* argv[])
+{
+  const char * format = "binary";
+  int opt, bad_option = 0;
+
+  while ((opt = getopt(argc, argv, "f:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'f':
+      format = optarg;
+      bad_option |= (0 != strcmp(format, "binary") &&
+		     0 != strcmp(format, "text") &&
+		     0 != strcmp(format, "sparse"));
+      break;
+    default:
+      bad_option = 1;
+    }
+  }
+
+  // Shift past the options so positional arguments start at argv[1]
+  argv[optind - 1] = argv[0];
+  argv += optind - 1;
+  argc -= optind - 1;
+
+  if (bad_option || argc != 3)
+  {
+    fprintf(stderr,"Usage: %s [-f binary|text|sparse] infile outfile\n",
+	    argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  mdp *p_mdp;
+  FILE *stream;
+  int status = 0;
+
+  // Read the MDP file
+  p_mdp = mdp_read(argv[1]);
+
+  if (NULL == p_mdp)
+    // mdp_read prints a message upon failure
+    exit(EXIT_FAILURE);
+
+  if (0 == strcmp(format, "binary"))
+    // mdp_write_binary prints a message upon failure
+    status = mdp_write_binary(p_mdp, argv[2]);
+  else
+  {
+    stream = fopen(argv[2], "w");
+
+    if (NULL == stream)
+    {
+      fprintf(stderr,"fopen(\"%s\") failed: %s\n",
+	      argv[2], strerror(errno));
+      status = -1;
+    }
+    else
+    {
+      if (0 == strcmp(format, "sparse"))
+	mdp_write_sparse(p_mdp, stream);
+      else
+	mdp_write(p_mdp, stream);
+
+      if (0 != fclose(stream))
+      {
+	fprintf(stderr,"fclose(\"%s\") failed: %s\n", argv[2], strerror(errno));
+	status = -1;
+      }
+    }
+  }
+
+  // Clean up
+  mdp_free(p_mdp);
+
+  exit(0 == status ? EXIT_SUCCESS : EXIT_FAILURE);
+}
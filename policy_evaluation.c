@@ -5,8 +5,156 @@
 #include <math.h>
 
 #include "utilities.h"
+#include "thread_pool.h"
+#include "policy_evaluation.h"
+#include "sweep.h"
 #include "mdp.h"
 
+/* Fixed policy and discount for policy_backup */
+typedef struct {
+  const unsigned int* policy;
+  double gamma;
+} policy_backup_arg;
+
+/*  Procedure
+ *    policy_backup
+ *
+ *  Purpose
+ *    Apply the simplified Bellman update to a single state
+ *
+ *  Parameters
+ *   p_mdp
+ *   state
+ *   utilities
+ *   p_arg, a const policy_backup_arg*
+ *
+ *  Produces,
+ *   utility, a double
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    utilities points to a valid array of length p_mdp->numStates
+ *
+ *  Postconditions
+ *    utility = R(state) for terminal states, and
+ *    R(state) + gamma * EU(state, policy[state]) otherwise
+ */
+static double policy_backup( const mdp* p_mdp, unsigned int state,
+			     const double* utilities, const void* p_arg )
+{
+  const policy_backup_arg *p_backup = p_arg;
+
+  if (p_mdp->terminal[state])
+    return p_mdp->rewards[state];
+
+  return p_mdp->rewards[state] + p_backup->gamma * 
+    calc_eu(p_mdp, state, utilities, p_backup->policy[state]);
+}
+
+/* Shared state for one parallel Jacobi sweep of policy evaluation */
+typedef struct {
+  const mdp* p_mdp;
+  policy_backup_arg backup;
+  const double *utilities;    /* Utilities from the previous sweep */
+  double *updated_utilities;  /* Utilities produced by this sweep */
+  double *max_change;         /* Per-thread maximum utility change */
+  unsigned long *eu_count;    /* Per-thread expected utilities computed */
+} evaluation_sweep_arg;
+
+/*  Procedure
+ *    evaluation_sweep
+ *
+ *  Purpose
+ *    Apply the simplified Bellman update to one thread's share of the
+ *    states
+ *
+ *  Parameters
+ *   p_arg, an evaluation_sweep_arg*
+ *   thread
+ *   numThreads
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    updated_utilities[s] holds the update of utilities[s] for every
+ *    state s in this thread's share, max_change[thread] the largest
+ *    change among them and eu_count[thread] the expected utilities
+ *    computed
+ */
+static void evaluation_sweep( void* p_arg, unsigned int thread,
+			      unsigned int numThreads )
+{
+  evaluation_sweep_arg *p_sweep = p_arg;
+  double max_utilities_change, utilities_change;
+  unsigned int state, first, last;
+  unsigned long eu_start = calc_eu_count();
+
+  thread_pool_range(p_sweep->p_mdp->numStates, thread, numThreads, 
+		    &first, &last);
+
+  max_utilities_change = 0;
+
+  for ( state = first ; state < last ; state++ )
+  {
+    p_sweep->updated_utilities[state] = 
+      policy_backup(p_sweep->p_mdp, state, p_sweep->utilities, 
+		    &p_sweep->backup);
+
+    utilities_change = fabs(p_sweep->updated_utilities[state] - 
+			    p_sweep->utilities[state]);
+
+    if (utilities_change > max_utilities_change)
+      max_utilities_change = utilities_change;
+  }
+
+  p_sweep->max_change[thread] = max_utilities_change;
+  p_sweep->eu_count[thread] = calc_eu_count() - eu_start;
+}
+
+/*  Procedure
+ *    evaluation_sweep_run
+ *
+ *  Purpose
+ *    Run one Jacobi sweep of policy evaluation over a pool
+ *
+ *  Parameters
+ *   p_sweep
+ *   p_pool
+ *
+ *  Produces,
+ *   max_change, a double
+ *
+ *  Postconditions
+ *    p_sweep->updated_utilities holds the sweep, which does not depend
+ *    on the number of threads, and max_change is its largest change.
+ *    The caller's expected utility count includes the workers' work.
+ */
+static double evaluation_sweep_run( evaluation_sweep_arg* p_sweep,
+				    thread_pool* p_pool )
+{
+  unsigned int thread, num_threads = thread_pool_size(p_pool);
+  double max_change[num_threads], max_utilities_change;
+  unsigned long eu_count[num_threads];
+
+  p_sweep->max_change = max_change;
+  p_sweep->eu_count = eu_count;
+
+  thread_pool_run(p_pool, evaluation_sweep, p_sweep);
+
+  max_utilities_change = max_change[0];
+
+  for ( thread = 1 ; thread < num_threads ; thread++ )
+  {
+    if (max_change[thread] > max_utilities_change)
+      max_utilities_change = max_change[thread];
+
+    calc_eu_credit(eu_count[thread]);
+  }
+
+  return max_utilities_change;
+}
+
 /*  Procedure
  *    policy_evaluation
  *
@@ -19,9 +167,12 @@
  *   epsilon
  *   gamma
  *   utilities
+ *   mode
+ *   workspace
+ *   p_pool
  *
  *  Produces,
- *   [Nothing.]
+ *   backups, an unsigned long
  *
  *  Preconditions
  *    policy points to a valid array of length p_mdp->numStates
@@ -31,64 +182,341 @@
  *    epsilon > 0
  *    0 < gamma < 1
  *    utilities points to a valid array of length p_mdp->numStates
+ *    workspace is NULL or points to an array of p_mdp->numStates doubles,
+ *    used as scratch instead of allocating
  *
  *  Postconditions
  *    utilities[s] has been updated according to the simplified Bellman update
- *    so that no update is larger than epsilon
+ *    so that no update is larger than epsilon, applying updates in the
+ *    order given by mode
+ *    Jacobi sweeps, and topological components that cannot reach each
+ *    other (of the whole MDP's transition graph, not just the policy's),
+ *    are split over the threads of p_pool (the caller alone when NULL)
+ *    without changing the result; other modes run in the caller
+ *    backups is the number of single-state updates performed
  *
  *  Authors
  *    Jerod Weinman (documentation & skeleton)
  *    Daniel NP & Tyler D (implementation)
  */
-void policy_evaluation( const unsigned int* policy, const mdp* p_mdp,
-      double epsilon, double gamma,
-      double* utilities)
+unsigned long policy_evaluation( const unsigned int* policy, const mdp* p_mdp,
+				 double epsilon, double gamma,
+				 double* utilities, sweep_mode mode,
+				 double* workspace, sweep_graph* p_graph,
+				 thread_pool* p_pool)
 {
   double *updated_utilities;
-  double max_utilities_change, utilities_change, eu;
+  double max_utilities_change;
 
-  int state, num_states, utilities_size;
+  int num_states, utilities_size;
+  unsigned long backups;
+  policy_backup_arg backup_arg;
+  evaluation_sweep_arg sweep;
 
   num_states = p_mdp->numStates;
   utilities_size = sizeof(double) * num_states;
 
-  updated_utilities = malloc(utilities_size);
-  bzero(updated_utilities, utilities_size);
+  if (SWEEP_JACOBI != mode)
+  {
+    backup_arg.policy = policy;
+    backup_arg.gamma = gamma;
+
+    // Evaluation runs the asynchronous order in place, in the caller
+    if (SWEEP_TOPOLOGICAL == mode)
+      return sweep_topological(p_mdp, policy_backup, &backup_arg,
+			       epsilon, utilities, p_graph, p_pool, NULL, NULL);
+    else if (SWEEP_GAUSS_SEIDEL == mode || SWEEP_ASYNC == mode)
+      return sweep_gauss_seidel(p_mdp, policy_backup, &backup_arg, 
+				epsilon, utilities, NULL, NULL);
+    else
+      return sweep_prioritized(p_mdp, policy_backup, &backup_arg, 
+			       epsilon, utilities, p_graph, NULL, NULL);
+  }
+
+  backups = 0;
+
+  if (NULL != workspace)
+    updated_utilities = workspace;
+  else
+  {
+    updated_utilities = malloc(utilities_size);
+
+    if (NULL == updated_utilities)
+    {
+      fprintf(stderr, 
+	      "policy_evaluation failed: %s (%s)\n",
+	      "Unable to allocate utilities", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  sweep.p_mdp = p_mdp;
+  sweep.backup.policy = policy;
+  sweep.backup.gamma = gamma;
+  sweep.utilities = utilities;
+  sweep.updated_utilities = updated_utilities;
 
   do
   {
-    max_utilities_change = 0;
-    
-    for ( state = 0 ; state < num_states ; state++ )
+    // Each state's update reads only the previous sweep, so splitting
+    // the states over threads gives the same utilities
+    max_utilities_change = evaluation_sweep_run(&sweep, p_pool);
+
+    backups += num_states;
+
+    // Update our utilities
+    memcpy(utilities, updated_utilities, utilities_size);
+
+  } while (!(max_utilities_change <= epsilon));
+
+  // Clean up
+  if (updated_utilities != workspace)
+    free(updated_utilities);
+
+  return backups;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned long policy_evaluation_sweeps( const unsigned int* policy,
+					const mdp* p_mdp, double gamma,
+					double* utilities, unsigned int sweeps,
+					sweep_mode mode, double* workspace,
+					thread_pool* p_pool)
+{
+  double *updated_utilities;
+  unsigned int sweep, state, num_states;
+  policy_backup_arg backup_arg;
+  evaluation_sweep_arg jacobi;
+
+  num_states = p_mdp->numStates;
+
+  backup_arg.policy = policy;
+  backup_arg.gamma = gamma;
+
+  if (SWEEP_JACOBI == mode && NULL != workspace)
+    updated_utilities = workspace;
+  else if (SWEEP_JACOBI == mode)
+  {
+    updated_utilities = malloc(sizeof(double) * num_states);
+
+    if (NULL == updated_utilities)
     {
-      if (p_mdp->terminal[state]) // if this is a terminal state
+      fprintf(stderr, 
+	      "policy_evaluation_sweeps failed: %s (%s)\n",
+	      "Unable to allocate utilities", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+  }
+  else
+    updated_utilities = utilities;
+
+  jacobi.p_mdp = p_mdp;
+  jacobi.backup = backup_arg;
+  jacobi.utilities = utilities;
+  jacobi.updated_utilities = updated_utilities;
+
+  for (sweep = 0 ; sweep < sweeps ; sweep++)
+  {
+    if (updated_utilities != utilities)
+      evaluation_sweep_run(&jacobi, p_pool);
+    else
+      for ( state = 0 ; state < num_states ; state++ )
+	updated_utilities[state] = policy_backup(p_mdp, state, utilities, 
+						 &backup_arg);
+
+    if (updated_utilities != utilities)
+      memcpy(utilities, updated_utilities, sizeof(double) * num_states);
+  }
+
+  // Clean up
+  if (updated_utilities != utilities && updated_utilities != workspace)
+    free(updated_utilities);
+
+  return (unsigned long)sweeps * num_states;
+}
+
+/*  Procedure
+ *    policy_residual_product
+ *
+ *  Purpose
+ *    Multiply a vector by the policy evaluation system matrix
+ *
+ *  Parameters
+ *   policy
+ *   p_mdp
+ *   gamma
+ *   x
+ *   y
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    x and y point to distinct valid arrays of length p_mdp->numStates
+ *
+ *  Postconditions
+ *    y = (I - gamma P) x, where row s of P holds the transitions of
+ *    policy[s] and is zero for terminal states
+ */
+static void policy_residual_product( const unsigned int* policy,
+				     const mdp* p_mdp, double gamma,
+				     const double* x, double* y)
+{
+  unsigned int state;
+
+  for ( state = 0 ; state < p_mdp->numStates ; state++ )
+    if (p_mdp->terminal[state])
+      y[state] = x[state];
+    else
+      y[state] = x[state] - 
+	gamma * calc_eu(p_mdp, state, x, policy[state]);
+}
+
+/* Inner product of two vectors of length n */
+static double dot( const double* x, const double* y, unsigned int n)
+{
+  double sum = 0;
+  unsigned int i;
+
+  for (i = 0 ; i < n ; i++)
+    sum += x[i] * y[i];
+
+  return sum;
+}
+
+/* Largest magnitude in a vector of length n */
+static double max_norm( const double* x, unsigned int n)
+{
+  double norm = 0;
+  unsigned int i;
+
+  for (i = 0 ; i < n ; i++)
+    if (fabs(x[i]) > norm)
+      norm = fabs(x[i]);
+
+  return norm;
+}
+
+// Limit on BiCGSTAB steps, as a multiple of the number of states
+#define EXACT_MAX_STEPS 4
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned long policy_evaluation_exact( const unsigned int* policy,
+				       const mdp* p_mdp, double epsilon,
+				       double gamma, double* utilities,
+				       double* workspace)
+{
+  double *r, *r0, *p, *v, *s, *t;
+  double rho, rho_prev, alpha, omega, beta, tolerance;
+  unsigned int state, num_states, step, max_steps;
+  unsigned long products;
+  int converged;
+
+  num_states = p_mdp->numStates;
+  tolerance = epsilon * (1 - gamma);
+  max_steps = EXACT_MAX_STEPS * num_states + 100;
+
+  r = (NULL != workspace) ? workspace : 
+    malloc(sizeof(double) * 6 * num_states);
+
+  if (NULL == r)
+  {
+    fprintf(stderr, 
+	    "policy_evaluation_exact failed: %s (%s)\n",
+	    "Unable to allocate work vectors", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  r0 = r + num_states;
+  p = r0 + num_states;
+  v = p + num_states;
+  s = v + num_states;
+  t = s + num_states;
+
+  products = 0;
+  converged = 0;
+  step = 0;
+
+  // Each pass (re)starts from the true residual r = R - A U, which
+  // guards against the drift of the recursively updated residual
+  while (!converged && step < max_steps)
+  {
+    policy_residual_product(policy, p_mdp, gamma, utilities, r);
+    products++;
+
+    for (state = 0 ; state < num_states ; state++)
+    {
+      r[state] = p_mdp->rewards[state] - r[state];
+      r0[state] = r[state];
+      p[state] = v[state] = 0;
+    }
+
+    if (max_norm(r, num_states) <= tolerance)
+    {
+      converged = 1;
+      break;
+    }
+
+    rho_prev = alpha = omega = 1;
+
+    for ( ; step < max_steps ; step++)
+    {
+      rho = dot(r0, r, num_states);
+
+      if (0 == rho || 0 == omega) // breakdown; restart
+	break;
+
+      beta = (rho / rho_prev) * (alpha / omega);
+
+      for (state = 0 ; state < num_states ; state++)
+	p[state] = r[state] + beta * (p[state] - omega * v[state]);
+
+      policy_residual_product(policy, p_mdp, gamma, p, v);
+      products++;
+
+      alpha = rho / dot(r0, v, num_states);
+
+      for (state = 0 ; state < num_states ; state++)
+	s[state] = r[state] - alpha * v[state];
+
+      if (max_norm(s, num_states) <= tolerance)
       {
-        // then the utility is just the reward
-        updated_utilities[state] = p_mdp->rewards[state];
+	for (state = 0 ; state < num_states ; state++)
+	  utilities[state] += alpha * p[state];
+	step++;
+	break;
       }
-      else
-      {
-        // otherwise, it's the reward plus the discounted expected utility
-        // of the policy's action
-        eu = calc_eu(p_mdp, state, utilities, policy[state]);
 
-        updated_utilities[state] = p_mdp->rewards[state] + gamma * eu;
+      policy_residual_product(policy, p_mdp, gamma, s, t);
+      products++;
+
+      omega = dot(t, s, num_states) / dot(t, t, num_states);
+
+      for (state = 0 ; state < num_states ; state++)
+      {
+	utilities[state] += alpha * p[state] + omega * s[state];
+	r[state] = s[state] - omega * t[state];
       }
 
-      // Check if we've found a new max change in utilities
-      utilities_change = fabs(updated_utilities[state] - utilities[state]);
+      rho_prev = rho;
 
-      if (utilities_change > max_utilities_change)
+      if (max_norm(r, num_states) <= tolerance)
       {
-        max_utilities_change = utilities_change;
+	step++;
+	break;
       }
     }
+  }
 
-    // Update our utilities
-    memcpy(utilities, updated_utilities, utilities_size);
+  // Clean up
+  if (r != workspace)
+    free(r);
 
-  } while (!(max_utilities_change <= epsilon));
+  products *= num_states;
 
-  // Clean up
-  free(updated_utilities);
+  if (!converged)
+    products += policy_evaluation(policy, p_mdp, tolerance, gamma, 
+				  utilities, SWEEP_JACOBI, workspace, NULL, NULL);
+
+  return products;
 }
@@ -2,6 +2,8 @@
 #define POLICY_EVALUATION_H
 
 #include "mdp.h"
+#include "sweep.h"
+#include "thread_pool.h"
 
 /*  Procedure
  *    policy_evaluation
@@ -15,9 +17,13 @@
  *   epsilon
  *   gamma
  *   utilities
+ *   mode
+ *   workspace
+ *   p_graph
+ *   p_pool
  *
  *  Produces,
- *   [Nothing.]
+ *   backups, an unsigned long
  *
  *  Preconditions
  *    policy points to a valid array of length p_mdp->numStates
@@ -27,17 +33,119 @@
  *    epsilon > 0
  *    0 < gamma < 1
  *    utilities points to a valid array of length p_mdp->numStates
+ *    workspace is NULL or points to an array of p_mdp->numStates doubles,
+ *    used as scratch instead of allocating
+ *    p_graph is as for sweep_prioritized
  *
  *  Postconditions
  *    utilities[s] has been updated according to the simplified Bellman update
- *    so that no update is larger than epsilon
+ *    so that no update is larger than epsilon, applying updates in the
+ *    order given by mode
+ *    Jacobi sweeps, and topological components that cannot reach each
+ *    other (of the whole MDP's transition graph, not just the policy's),
+ *    are split over the threads of p_pool (the caller alone when NULL)
+ *    without changing the result; other modes run in the caller
+ *    The prioritized and topological orders keep the structure they
+ *    find in p_graph (when not NULL), so evaluating many policies of
+ *    one model finds it once
+ *    backups is the number of single-state updates performed
  *
  *  Authors
  *    Jerod Weinman (documentation & skeleton)
  *    Daniel NP & Tyler D (implementation)
  */
-void policy_evaluation( const unsigned int* policy, const mdp* p_mdp,
-			double epsilon, double gamma,
-			double* utilities);
+unsigned long policy_evaluation( const unsigned int* policy, const mdp* p_mdp,
+				 double epsilon, double gamma,
+				 double* utilities, sweep_mode mode,
+				 double* workspace, sweep_graph* p_graph,
+				 thread_pool* p_pool);
+
+/*  Procedure
+ *    policy_evaluation_sweeps
+ *
+ *  Purpose
+ *    Apply a fixed number of simplified Bellman sweeps under a policy
+ *
+ *  Parameters
+ *   policy
+ *   p_mdp
+ *   gamma
+ *   utilities
+ *   sweeps
+ *   mode
+ *   workspace
+ *   p_pool
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    policy points to a valid array of length p_mdp->numStates
+ *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
+ *       and policy[s] is an entry in p_mdp->actions[s]
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    0 < gamma < 1
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    workspace is NULL or points to an array of p_mdp->numStates doubles,
+ *    used as scratch instead of allocating
+ *
+ *  Postconditions
+ *    Every state has been updated sweeps times, regardless of how much
+ *    the utilities change. Jacobi mode updates from the previous sweep's
+ *    utilities, split over the threads of p_pool (the caller alone when
+ *    NULL) without changing the result; the other modes update in place
+ *    in state order, in the caller, since a prioritized order has no
+ *    notion of a sweep.
+ *    backups is the number of single-state updates performed
+ */
+unsigned long policy_evaluation_sweeps( const unsigned int* policy,
+					const mdp* p_mdp, double gamma,
+					double* utilities, unsigned int sweeps,
+					sweep_mode mode, double* workspace,
+					thread_pool* p_pool);
+/*  Procedure
+ *    policy_evaluation_exact
+ *
+ *  Purpose
+ *    Solve for the state utilities under a fixed policy
+ *
+ *  Parameters
+ *   policy
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   workspace
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    policy points to a valid array of length p_mdp->numStates
+ *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
+ *       and policy[s] is an entry in p_mdp->actions[s]
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    workspace is NULL or points to an array of 6*p_mdp->numStates
+ *    doubles, used as scratch instead of allocating
+ *
+ *  Postconditions
+ *    utilities solves (I - gamma P) U = R, where row s of P holds the
+ *    transitions of policy[s] (and is zero for terminal states), to
+ *    within epsilon of the exact solution: the simplified Bellman update
+ *    changes no utility by more than epsilon*(1-gamma). The system is
+ *    solved with BiCGSTAB, starting from the given utilities, so the
+ *    work grows with the conditioning of the system rather than with
+ *    1/(1-gamma). Should that fail to converge, the utilities are
+ *    finished by policy_evaluation.
+ *    backups is the number of states times the number of products with
+ *    P, each of which costs one Jacobi sweep.
+ */
+unsigned long policy_evaluation_exact( const unsigned int* policy,
+				       const mdp* p_mdp, double epsilon,
+				       double gamma, double* utilities,
+				       double* workspace);
 
 #endif
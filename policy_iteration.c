@@ -2,139 +2,100 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
-#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
 
-#include "utilities.h"
-#include "policy_evaluation.h"
+#include "sweep.h"
+#include "solver.h"
 #include "mdp.h"
 
-
-/*  Procedure
- *    policy_iteration
- *
- *  Purpose
- *    Optimize policy by alternating evaluation and improvement steps
- *
- *  Parameters
- *   p_mdp
- *   epsilon
- *   gamma
- *   policy
- *
- *  Produces,
- *   [Nothing.]
- *
- *  Preconditions
- *    p_mdp is a pointer to a valid, complete mdp
- *    policy points to a valid array of length p_mdp->numStates
- *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
- *       and policy[s] is an entry in p_mdp->actions[s]
- *    epsilon > 0
- *    0 < gamma < 1
- *
- *  Postconditions
- *    policy[s] contains the optimal policy for the given mdp
- *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
- *       and policy[s] is an entry in p_mdp->actions[s]
- *
- *  Authors
- *    Jerod Weinman (documentation & skeleton)
- *    Daniel NP & Tyler D (implementation)
- */			
-void policy_iteration( const mdp* p_mdp, double epsilon, double gamma,
-		      unsigned int *policy)
-{
-  double *utilities;
-
-  double current_eu, meu;
-
-  unsigned int state, num_states, utilities_size, unchanged,
-               maximizing_action;
-
-  num_states = p_mdp->numStates;
-  utilities_size = sizeof(double) * num_states;
-
-  utilities = malloc(utilities_size);
-  bzero(utilities, utilities_size);
-
-  do {
-
-    unchanged = 1;
-
-    // evaluate our current policy, storing the updated utilities
-    // in utilities
-    policy_evaluation(policy, p_mdp, epsilon, gamma, utilities);
-
-    for ( state = 0; state < num_states ; state++ )
-    {
-
-      current_eu = calc_eu(p_mdp, state, utilities, policy[state]);
-
-      calc_meu(p_mdp, state, utilities, &meu, &maximizing_action);
-
-      if (meu > current_eu)
-      {
-        policy[state] = maximizing_action;
-        unchanged = 0;
-      }
-    }
-
-  } while (!unchanged);
-
-  // Clean up
-  free(utilities);
-}
-
-/*  Procedure
- *    randomize_policy
- *
- *  Purpose
- *    Initialize policy to random actions
- *
- *  Parameters
- *   p_mdp
- *   policy
- *
- *  Produces,
- *   [Nothing.]
- *
- *  Preconditions
- *    p_mdp is a pointer to a valid, complete mdp
- *    policy points to a valid array of length p_mdp->numStates
+/*
+ * Main: policy_iteration [-j threads] [-m mode] [-k sweeps | -x]
+ *                         [-p policyfile] [--from-start]
+ *                         [--precision=storage] [--stats]
+ *                         gamma epsilon mdpfile
  *
- *  Postconditions
- *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
- *       and policy[s] is an entry in p_mdp->actions[s]
- *    when p_mdp->numAvailableActions[s] > 0.
+ * Runs policy_iteration algorithm using gamma and policy_evaluation with max
+ * changes of epsilon on MDP in mdpfile. mode is the order of evaluation
+ * updates: jacobi (default), gauss-seidel, prioritized, async (which
+ * evaluation runs as gauss-seidel) or topological. With -k, each
+ * policy is only evaluated for the given number of sweeps (modified
+ * policy iteration). With -x, each policy is evaluated by solving its
+ * linear system instead. With --stats, the Bellman residual, time, work
+ * and policy changes of each improvement step are printed to stderr.
+ * With -p, iteration starts from the policy in policyfile (e.g., the
+ * output of an earlier run) instead of a random one. --precision selects
+ * how transition probabilities are stored: double (default), float or
+ * palette. With --from-start, only the states reachable from the model's
+ * start are solved, by labeled real-time dynamic programming (see lrtdp)
+ * instead of policy iteration; states the resulting policy cannot reach
+ * keep their starting (random or -p) entries. With -j, improvement steps
+ * and Jacobi evaluation sweeps are split over the given number of
+ * threads; the output does not depend on the number of threads.
  */
-void randomize_policy( const mdp* p_mdp, unsigned int* policy)
+int main(int argc, char* argv[])
 {
-  srandom(42);
-  unsigned int state;
-  unsigned int action;
-
-  for ( state=0 ; state < p_mdp->numStates ; state++)
+  unsigned int num_threads = 1;
+  sweep_mode mode = SWEEP_JACOBI;
+  unsigned int sweeps = 0;
+  static const struct option long_options[] = {
+    { "stats", no_argument, NULL, 'S' },
+    { "precision", required_argument, NULL, 'P' },
+    { "from-start", no_argument, NULL, 'F' },
+    { NULL, 0, NULL, 0 }
+  };
+  int stats = 0;
+  mdp_precision precision = MDP_PRECISION_DOUBLE;
+  int opt, exact = 0, from_start = 0, bad_option = 0;
+  const char * policy_file = NULL;
+
+  while ((opt = getopt_long(argc, argv, "j:m:k:xp:", long_options, NULL)) 
+	 != -1)
   {
-    if (p_mdp->numAvailableActions[state] > 0)
+    switch (opt)
     {
-      action = (unsigned int)(random() % (p_mdp->numAvailableActions[state]));
-      policy[state] = p_mdp->actions[state][action];
+    case 'j':
+      num_threads = (unsigned int) strtoul(optarg, NULL, 10);
+      bad_option |= (0 == num_threads);
+      break;
+    case 'm':
+      bad_option |= !sweep_mode_parse(optarg, &mode);
+      break;
+    case 'k':
+      sweeps = (unsigned int) strtoul(optarg, NULL, 10);
+      bad_option |= (0 == sweeps);
+      break;
+    case 'x':
+      exact = 1;
+      break;
+    case 'p':
+      policy_file = optarg;
+      break;
+    case 'P':
+      bad_option |= !mdp_precision_parse(optarg, &precision);
+      break;
+    case 'F':
+      from_start = 1;
+      break;
+    case 'S':
+      stats = 1;
+      break;
+    default:
+      bad_option = 1;
     }
   }
 
-}
+  // Shift past the options so positional arguments start at argv[1]
+  argv[optind - 1] = argv[0];
+  argv += optind - 1;
+  argc -= optind - 1;
 
-/*
- * Main: policy_iteration gamma epsilon mdpfile
- *
- * Runs policy_iteration algorithm using gamma and policy_evaluation with max
- * changes of epsilon on MDP in mdpfile.
- */
-int main(int argc, char* argv[])
-{
-  if (argc != 4)
+  if (bad_option || (exact && sweeps) || (from_start && (exact || sweeps)) ||
+      argc != 4)
   {
-    fprintf(stderr,"Usage: %s gamma epsilon mdpfile\n",argv[0]);
+    fprintf(stderr,"Usage: %s [-j threads] [-m mode] [-k sweeps | -x] "
+	    "[-p policyfile] [--precision=storage] [--from-start] [--stats] "
+	    "gamma epsilon mdpfile\n", argv[0]);
     exit(EXIT_FAILURE);
   }
 
@@ -142,6 +103,7 @@ int main(int argc, char* argv[])
   double gamma, epsilon;
   char* endptr; // String End Location for number parsing
   mdp *p_mdp;
+  solver_context *p_ctx;
 
   // Read gamma, the discount factor, as a double
   gamma = strtod(argv[1], &endptr);
@@ -171,6 +133,19 @@ int main(int argc, char* argv[])
     exit(EXIT_FAILURE);
   }
 
+  // Store transitions as requested, reporting the rounding when asked
+  double storage_error;
+
+  if (!mdp_set_precision(p_mdp, precision, &storage_error))
+  {
+    fprintf(stderr, "%s: Too many distinct probabilities for a palette\n",
+	    argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  if (stats && MDP_PRECISION_DOUBLE != precision)
+    fprintf(stderr, "largest transition row error %g\n", storage_error);
+
   // Allocate policy array
   unsigned int * policy;
 
@@ -188,8 +163,54 @@ int main(int argc, char* argv[])
   // Initialize random policy
   randomize_policy(p_mdp, policy);
 
+  if (NULL != policy_file)
+  { // Start from a saved policy, keeping the random choice where the
+    // saved one is not available (e.g., the state's actions changed)
+    FILE * stream = fopen(policy_file, "r");
+    unsigned int * saved = malloc( sizeof(unsigned int) * p_mdp->numStates );
+    unsigned int s, a;
+
+    if (NULL == stream || NULL == saved)
+    {
+      fprintf(stderr, "%s: Unable to read %s (%s)\n", argv[0], policy_file,
+	      strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    mdp_read_policy(stream, p_mdp, saved);
+    fclose(stream);
+
+    for (s = 0 ; s < p_mdp->numStates ; s++)
+      for (a = 0 ; a < p_mdp->numAvailableActions[s] ; a++)
+	if (p_mdp->actions[s][a] == saved[s])
+	  policy[s] = saved[s];
+
+    free(saved);
+  }
+
   // Run policy iteration!
-  policy_iteration ( p_mdp, epsilon, gamma, policy);
+  p_ctx = solver_context_create(num_threads);
+
+  if (from_start)
+  {
+    double * utilities = malloc( sizeof(double) * p_mdp->numStates );
+
+    if (NULL == utilities)
+    {
+      fprintf(stderr,
+	      "%s: Unable to allocate utilities (%s)",
+	      argv[0],
+	      strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    lrtdp ( p_mdp, epsilon, gamma, utilities, policy,
+	    stats ? solver_print_stats : NULL, stderr );
+    free (utilities);
+  }
+  else
+    policy_iteration ( p_ctx, p_mdp, epsilon, gamma, policy, mode, sweeps,
+		       exact, stats ? solver_print_stats : NULL, stderr );
 
   // Print policies
   unsigned int state;
@@ -200,6 +221,7 @@ int main(int argc, char* argv[])
       printf("0\n",policy[state]);
 
   // Clean up
+  solver_context_free(p_ctx);
   free (policy);
   mdp_free(p_mdp);
 
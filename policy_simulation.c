@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "mdp.h"
+#include "thread_pool.h"
+#include "rollout.h"
+
+// Discount below which a default horizon stops collecting rewards
+#define SIMULATION_TAIL 1e-6
+
+/*
+ * Main: policy_simulation [-j threads] [-n episodes] [-t horizon]
+ *                          [-s seed] [--stats] gamma policyfile mdpfile
+ *
+ * Estimates the utility of the policy in policyfile (e.g., the output of
+ * policy_iteration) at the start state of the MDP in mdpfile by
+ * simulating episodes (100000 by default) and averaging their returns
+ * discounted by gamma. Each episode lasts until it reaches a terminal
+ * state or has collected horizon rewards; by default, horizon is where
+ * gamma's powers fall below 1e-6, and it must be given when gamma is 1.
+ * Prints the mean return, the half width and bounds of its 95%
+ * confidence interval, the standard deviation of the returns, the mean
+ * episode length and the fraction of episodes that ended before the
+ * horizon. With -j, episodes are split over the given number of
+ * threads; the output depends on the seed (-s) but not on the number of
+ * threads. With --stats, the time taken and episodes per second are
+ * printed to stderr.
+ */
+int main(int argc, char* argv[])
+{
+  unsigned int num_threads = 1, horizon = 0;
+  unsigned long episodes = 100000, seed = 1;
+  static const struct option long_options[] = {
+    { "stats", no_argument, NULL, 'S' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt, stats = 0, bad_option = 0;
+
+  while ((opt = getopt_long(argc, argv, "j:n:t:s:", long_options, NULL))
+	 != -1)
+  {
+    switch (opt)
+    {
+    case 'j':
+      num_threads = (unsigned int) strtoul(optarg, NULL, 10);
+      bad_option |= (0 == num_threads);
+      break;
+    case 'n':
+      episodes = strtoul(optarg, NULL, 10);
+      bad_option |= (0 == episodes);
+      break;
+    case 't':
+      horizon = (unsigned int) strtoul(optarg, NULL, 10);
+      bad_option |= (0 == horizon);
+      break;
+    case 's':
+      seed = strtoul(optarg, NULL, 10);
+      break;
+    case 'S':
+      stats = 1;
+      break;
+    default:
+      bad_option = 1;
+    }
+  }
+
+  // Shift past the options so positional arguments start at argv[1]
+  argv[optind - 1] = argv[0];
+  argv += optind - 1;
+  argc -= optind - 1;
+
+  if (bad_option || argc != 4)
+  {
+    fprintf(stderr,"Usage: %s [-j threads] [-n episodes] [-t horizon] "
+	    "[-s seed] [--stats] gamma policyfile mdpfile\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  double gamma, discount;
+  char* endptr; // String End Location for number parsing
+  mdp *p_mdp;
+
+  // Read gamma, the discount factor, as a double
+  gamma = strtod(argv[1], &endptr);
+
+  if ( (endptr - argv[1])/sizeof(char) < strlen(argv[1]) ||
+       gamma <= 0 || gamma > 1 || (1 == gamma && 0 == horizon) )
+  {
+    fprintf(stderr, "%s: Illegal value in argument gamma=%s\n",
+            argv[0],argv[1]);
+      exit(EXIT_FAILURE);
+  }
+
+  if (0 == horizon)
+    for (horizon = 1, discount = gamma ; discount >= SIMULATION_TAIL ;
+	 horizon++)
+      discount *= gamma;
+
+  // Read the MDP file (exits with message if error)
+  p_mdp = mdp_read(argv[3]);
+
+  if (NULL == p_mdp)
+  { // mdp_read prints a message
+    exit(EXIT_FAILURE);
+  }
+
+  // Read the policy to simulate
+  unsigned int * policy = malloc( sizeof(unsigned int) * p_mdp->numStates );
+  FILE * stream = fopen(argv[2], "r");
+
+  if (NULL == stream || NULL == policy)
+  {
+    fprintf(stderr, "%s: Unable to read %s (%s)\n", argv[0], argv[2],
+	    strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  mdp_read_policy(stream, p_mdp, policy);
+  fclose(stream);
+
+  // Simulate!
+  struct timespec begin, end;
+  rollout_table *p_table;
+  rollout_stats result;
+  thread_pool *p_pool;
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  p_pool = (num_threads > 1) ? thread_pool_create(num_threads) : NULL;
+  p_table = rollout_table_create(p_mdp, policy);
+
+  rollout_simulate(p_pool, p_table, p_mdp->start, gamma, episodes, horizon,
+		   seed, &result);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("mean %.10g\n", result.mean);
+  printf("halfwidth95 %.10g\n", result.halfWidth);
+  printf("interval95 %.10g %.10g\n", result.mean - result.halfWidth,
+	 result.mean + result.halfWidth);
+  printf("stddev %.10g\n", sqrt(result.variance));
+  printf("episodes %lu\n", result.episodes);
+  printf("steps %.10g\n", result.meanSteps);
+  printf("ended %.10g\n", (double)result.ended / result.episodes);
+
+  if (stats)
+  {
+    double seconds = (end.tv_sec - begin.tv_sec) +
+      (end.tv_nsec - begin.tv_nsec) * 1e-9;
+
+    fprintf(stderr, "time=%.6fs episodes/s=%.0f steps/s=%.0f\n", seconds,
+	    seconds > 0 ? result.episodes / seconds : 0,
+	    seconds > 0 ? result.episodes * result.meanSteps / seconds : 0);
+  }
+
+  // Clean up
+  rollout_table_free(p_table);
+  thread_pool_free(p_pool);
+  free (policy);
+  mdp_free(p_mdp);
+
+}
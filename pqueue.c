@@ -0,0 +1,165 @@
+/* pqueue.c
+ *
+ * Implementation of an indexed binary max-heap.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "pqueue.h"
+
+////////////////////////////////////////////////////////////////////////////////
+static void pqueue_swap( pqueue* p_queue, unsigned int i, unsigned int j )
+{
+  unsigned int item = p_queue->heap[i];
+
+  p_queue->heap[i] = p_queue->heap[j];
+  p_queue->heap[j] = item;
+  p_queue->position[p_queue->heap[i]] = i;
+  p_queue->position[p_queue->heap[j]] = j;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void pqueue_up( pqueue* p_queue, unsigned int i )
+{
+  unsigned int parent;
+
+  while (i > 0)
+  {
+    parent = (i - 1) / 2;
+
+    if (p_queue->priority[p_queue->heap[parent]] >= 
+	p_queue->priority[p_queue->heap[i]])
+      break;
+
+    pqueue_swap(p_queue, i, parent);
+    i = parent;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void pqueue_down( pqueue* p_queue, unsigned int i )
+{
+  unsigned int child, largest;
+
+  while (1)
+  {
+    largest = i;
+    child = 2 * i + 1;
+
+    if (child < p_queue->size && 
+	p_queue->priority[p_queue->heap[child]] > 
+	p_queue->priority[p_queue->heap[largest]])
+      largest = child;
+
+    child++;
+
+    if (child < p_queue->size && 
+	p_queue->priority[p_queue->heap[child]] > 
+	p_queue->priority[p_queue->heap[largest]])
+      largest = child;
+
+    if (largest == i)
+      break;
+
+    pqueue_swap(p_queue, i, largest);
+    i = largest;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+pqueue* pqueue_create( unsigned int capacity )
+{
+  unsigned int i;
+  pqueue* p_queue = malloc( sizeof(pqueue) );
+
+  if (NULL == p_queue)
+  {
+    fprintf(stderr, "pqueue_create failed: %s\n", "Could not allocate queue");
+    exit(EXIT_FAILURE);
+  }
+
+  p_queue->capacity = capacity;
+  p_queue->size = 0;
+  p_queue->heap = malloc( sizeof(unsigned int) * (capacity ? capacity : 1) );
+  p_queue->position = malloc( sizeof(unsigned int) * (capacity ? capacity:1) );
+  p_queue->priority = malloc( sizeof(double) * (capacity ? capacity : 1) );
+
+  if (NULL == p_queue->heap || NULL == p_queue->position || 
+      NULL == p_queue->priority)
+  {
+    fprintf(stderr, "pqueue_create failed: %s\n", "Could not allocate heap");
+    exit(EXIT_FAILURE);
+  }
+
+  for (i = 0 ; i < capacity ; i++)
+    p_queue->position[i] = capacity;
+
+  return p_queue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void pqueue_free( pqueue* p_queue )
+{
+  free(p_queue->heap);
+  free(p_queue->position);
+  free(p_queue->priority);
+  free(p_queue);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void pqueue_set( pqueue* p_queue, unsigned int item, double priority )
+{
+  unsigned int i = p_queue->position[item];
+  double old;
+
+  if (i == p_queue->capacity)
+  { // Insert at the bottom
+    i = p_queue->size++;
+    p_queue->heap[i] = item;
+    p_queue->position[item] = i;
+    p_queue->priority[item] = priority;
+    pqueue_up(p_queue, i);
+    return;
+  }
+
+  old = p_queue->priority[item];
+  p_queue->priority[item] = priority;
+
+  if (priority > old)
+    pqueue_up(p_queue, i);
+  else
+    pqueue_down(p_queue, i);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void pqueue_remove( pqueue* p_queue, unsigned int item )
+{
+  unsigned int i = p_queue->position[item];
+  unsigned int last;
+
+  if (i == p_queue->capacity)
+    return; // Not present
+
+  last = --p_queue->size;
+
+  if (i != last)
+  {
+    pqueue_swap(p_queue, i, last);
+    p_queue->position[item] = p_queue->capacity;
+    pqueue_down(p_queue, i);
+    pqueue_up(p_queue, i);
+  }
+  else
+    p_queue->position[item] = p_queue->capacity;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int pqueue_pop( pqueue* p_queue )
+{
+  unsigned int item = p_queue->heap[0];
+
+  pqueue_remove(p_queue, item);
+
+  return item;
+}
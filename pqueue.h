@@ -0,0 +1,115 @@
+/* pqueue.h
+ *
+ * Declarations for an indexed max-priority queue over the integers
+ * 0..capacity-1 (e.g., MDP states), supporting priority updates.
+ *
+ */
+
+#ifndef PQUEUE_H
+#define PQUEUE_H
+
+typedef struct {
+  unsigned int capacity; /* Items are 0 <= item < capacity */
+  unsigned int size;     /* Number of items in the queue */
+  unsigned int *heap;    /* A capacity length binary max-heap of items */
+  unsigned int *position;/* A capacity length array: heap index of each
+			    item, or capacity when absent */
+  double *priority;      /* A capacity length array of item priorities */
+} pqueue;
+
+/*  Procedure
+ *    pqueue_create
+ *
+ *  Purpose
+ *    Allocate an empty priority queue
+ *
+ *  Parameters
+ *   capacity
+ *
+ *  Produces
+ *   p_queue, a pqueue*
+ *
+ *  Postconditions
+ *    p_queue is empty and accepts items 0 <= item < capacity
+ *    Any failure causes program exit.
+ */
+pqueue* pqueue_create( unsigned int capacity );
+
+/*  Procedure
+ *    pqueue_free
+ *
+ *  Purpose
+ *    Free memory for a priority queue
+ *
+ *  Parameters
+ *   p_queue
+ *
+ *  Produces
+ *   [Nothing.]
+ */
+void pqueue_free( pqueue* p_queue );
+
+/*  Procedure
+ *    pqueue_set
+ *
+ *  Purpose
+ *    Insert an item or change its priority
+ *
+ *  Parameters
+ *   p_queue
+ *   item
+ *   priority
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    0 <= item < p_queue->capacity
+ *
+ *  Postconditions
+ *    item is in p_queue with the given priority
+ */
+void pqueue_set( pqueue* p_queue, unsigned int item, double priority );
+
+/*  Procedure
+ *    pqueue_remove
+ *
+ *  Purpose
+ *    Remove an item if it is present
+ *
+ *  Parameters
+ *   p_queue
+ *   item
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    0 <= item < p_queue->capacity
+ *
+ *  Postconditions
+ *    item is not in p_queue
+ */
+void pqueue_remove( pqueue* p_queue, unsigned int item );
+
+/*  Procedure
+ *    pqueue_pop
+ *
+ *  Purpose
+ *    Remove the item of highest priority
+ *
+ *  Parameters
+ *   p_queue
+ *
+ *  Produces
+ *   item, an unsigned int
+ *
+ *  Preconditions
+ *    p_queue->size > 0
+ *
+ *  Postconditions
+ *    item had the highest priority in p_queue and has been removed
+ */
+unsigned int pqueue_pop( pqueue* p_queue );
+
+#endif // PQUEUE_H
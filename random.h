@@ -0,0 +1,71 @@
+/* random.h
+ *
+ * The splitmix64 generator shared by the model generators, the policy
+ * simulator and the sampling solvers.
+ *
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+/* Increment of a splitmix64 state: 2^64 divided by the golden ratio */
+#define RANDOM_INCREMENT 0x9E3779B97F4A7C15ULL
+
+/*  Procedure
+ *    random_mix
+ *
+ *  Purpose
+ *    Scramble 64 bits with the splitmix64 finalizer
+ *
+ *  Parameters
+ *   z
+ *
+ *  Produces
+ *   value, an unsigned long long
+ *
+ *  Postconditions
+ *    value is a bijective function of z in which every bit of z affects
+ *    every bit of value, so mixing consecutive counters gives
+ *    independent-looking values
+ */
+static inline unsigned long long random_mix( unsigned long long z )
+{
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+  return z ^ (z >> 31);
+}
+
+/*  Procedure
+ *    random_next
+ *
+ *  Purpose
+ *    Advance a splitmix64 generator
+ *
+ *  Parameters
+ *   p_state
+ *
+ *  Produces
+ *   value, an unsigned long long
+ *
+ *  Postconditions
+ *    value is uniform over 64-bit integers and *p_state is advanced
+ */
+static inline unsigned long long random_next( unsigned long long *p_state )
+{
+  return random_mix(*p_state += RANDOM_INCREMENT);
+}
+
+/* Uniform double on [0,1) from the top 53 of 64 random bits */
+static inline double random_double( unsigned long long bits )
+{
+  return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Uniform double on [0,1) from a splitmix64 generator */
+static inline double random_uniform( unsigned long long *p_state )
+{
+  return random_double(random_next(p_state));
+}
+
+#endif // RANDOM_H
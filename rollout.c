@@ -0,0 +1,422 @@
+/* rollout.c
+ *
+ * Implementation of policy simulation with alias-table sampling and
+ * counter-based random numbers.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "mdp.h"
+#include "thread_pool.h"
+#include "random.h"
+#include "rollout.h"
+
+// Episodes summarized together, fixing the order statistics are merged
+#define ROLLOUT_BATCH 1024
+
+// Critical value of the two-sided 95% normal confidence interval
+#define ROLLOUT_Z95 1.959963984540054
+
+/* Summary of the returns of one batch of episodes */
+typedef struct {
+  unsigned long count;
+  double mean;
+  double m2;                  /* Sum of squared deviations from the mean */
+  unsigned long long steps;
+  unsigned long ended;
+} rollout_batch;
+
+/* Work shared by the threads of one rollout_simulate call */
+typedef struct {
+  const rollout_table *p_table;
+  unsigned int state;
+  double gamma;
+  unsigned long episodes;
+  unsigned int horizon;
+  unsigned long seed;
+  rollout_batch *batch;
+  unsigned long numBatches;
+  unsigned long next;         /* Next unclaimed batch (atomic) */
+} rollout_arg;
+
+/*  Procedure
+ *    rollout_alias
+ *
+ *  Purpose
+ *    Build the alias table of one distribution (Vose's method)
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    For outcomes first..first+count-1 with the given weights (summing
+ *    to total), choosing an outcome i uniformly and then keeping it with
+ *    probability keep[i], otherwise taking alias[i], draws each outcome
+ *    in proportion to its weight. scaled, small and large (of length
+ *    count) are overwritten.
+ */
+static void rollout_alias( const double* weight, unsigned int count,
+			   double total, unsigned int first, double* keep,
+			   unsigned int* alias, double* scaled,
+			   unsigned int* small, unsigned int* large )
+{
+  unsigned int i, num_small = 0, num_large = 0, less, more;
+
+  for (i = 0 ; i < count ; i++)
+  {
+    scaled[i] = weight[i] * count / total;
+
+    if (scaled[i] < 1)
+      small[num_small++] = i;
+    else
+      large[num_large++] = i;
+  }
+
+  // Pair each light outcome with a heavy one that tops it up
+  while (num_small > 0 && num_large > 0)
+  {
+    less = small[--num_small];
+    more = large[--num_large];
+
+    keep[less] = scaled[less];
+    alias[less] = first + more;
+
+    scaled[more] -= 1 - scaled[less];
+
+    if (scaled[more] < 1)
+      small[num_small++] = more;
+    else
+      large[num_large++] = more;
+  }
+
+  // Whatever remains is full up to rounding
+  while (num_large > 0)
+  {
+    more = large[--num_large];
+    keep[more] = 1;
+    alias[more] = first + more;
+  }
+
+  while (num_small > 0)
+  {
+    less = small[--num_small];
+    keep[less] = 1;
+    alias[less] = first + less;
+  }
+}
+
+/* The row of state's policy action, checking that it is available */
+static unsigned int rollout_row( const mdp* p_mdp, const unsigned int* policy,
+				 unsigned int state )
+{
+  unsigned int i;
+
+  for (i = 0 ; i < p_mdp->numAvailableActions[state] ; i++)
+    if (p_mdp->actions[state][i] == policy[state])
+      return state * p_mdp->numActions + policy[state];
+
+  fprintf(stderr, "rollout_table_create failed: %s %u\n",
+	  "Policy action unavailable in state", state);
+  exit(EXIT_FAILURE);
+}
+
+/* The sum of a transition row */
+static double rollout_row_sum( const mdp* p_mdp, unsigned int row )
+{
+  unsigned int i;
+  double sum = 0;
+
+  for (i = p_mdp->transitionStart[row] ; i < p_mdp->transitionStart[row + 1] ;
+       i++)
+    sum += p_mdp->transitionProb[i];
+
+  return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+rollout_table* rollout_table_create( const mdp* p_mdp,
+				     const unsigned int* policy )
+{
+  rollout_table *p_table;
+  unsigned int state, row, count, longest = 0, entry = 0, first, i;
+  unsigned int *small, *large;
+  double *weight, *scaled, sum;
+
+  p_table = malloc(sizeof(rollout_table));
+
+  if (NULL != p_table)
+    p_table->outcomeStart = malloc(sizeof(unsigned int) *
+				   ((size_t)p_mdp->numStates + 1));
+
+  if (NULL == p_table || NULL == p_table->outcomeStart)
+  {
+    fprintf(stderr,"rollout_table_create failed: %s (%s)\n",
+	    "Could not allocate table", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  // Count the outcomes of each state to size the arrays
+  for (state = 0 ; state < p_mdp->numStates ; state++)
+  {
+    p_table->outcomeStart[state] = entry;
+
+    if (p_mdp->terminal[state] || 0 == p_mdp->numAvailableActions[state])
+      continue;
+
+    row = rollout_row(p_mdp, policy, state);
+    count = p_mdp->transitionStart[row + 1] - p_mdp->transitionStart[row];
+
+    if (rollout_row_sum(p_mdp, row) < 1 - MDP_ROW_SLACK)
+      count++;
+
+    if (count > longest)
+      longest = count;
+
+    entry += count;
+  }
+
+  p_table->outcomeStart[p_mdp->numStates] = entry;
+
+  p_table->successor = malloc(sizeof(unsigned int) * (entry ? entry : 1));
+  p_table->alias = malloc(sizeof(unsigned int) * (entry ? entry : 1));
+  p_table->keep = malloc(sizeof(double) * (entry ? entry : 1));
+  weight = malloc(sizeof(double) * 2 * (longest ? longest : 1));
+  small = malloc(sizeof(unsigned int) * 2 * (longest ? longest : 1));
+
+  if (NULL == p_table->successor || NULL == p_table->alias ||
+      NULL == p_table->keep || NULL == weight || NULL == small)
+  {
+    fprintf(stderr,"rollout_table_create failed: %s (%s)\n",
+	    "Could not allocate table", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  scaled = weight + longest;
+  large = small + longest;
+
+  for (state = 0 ; state < p_mdp->numStates ; state++)
+  {
+    first = p_table->outcomeStart[state];
+    count = p_table->outcomeStart[state + 1] - first;
+
+    if (0 == count)
+      continue;
+
+    row = rollout_row(p_mdp, policy, state);
+    sum = 0;
+
+    for (i = 0 ; i < p_mdp->transitionStart[row + 1] -
+	   p_mdp->transitionStart[row] ; i++)
+    {
+      p_table->successor[first + i] =
+	p_mdp->successor[p_mdp->transitionStart[row] + i];
+      weight[i] = p_mdp->transitionProb[p_mdp->transitionStart[row] + i];
+      sum += weight[i];
+    }
+
+    if (i < count)
+    { // The remainder of the row ends the episode
+      p_table->successor[first + i] = ROLLOUT_END;
+      weight[i] = 1 - sum;
+      sum = 1;
+    }
+
+    rollout_alias(weight, count, sum, first, p_table->keep + first,
+		  p_table->alias + first, scaled, small, large);
+  }
+
+  free(weight);
+  free(small);
+
+  p_table->p_mdp = p_mdp;
+
+  return p_table;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void rollout_table_free( rollout_table* p_table )
+{
+  if (NULL == p_table)
+    return;
+
+  free(p_table->outcomeStart);
+  free(p_table->successor);
+  free(p_table->alias);
+  free(p_table->keep);
+  free(p_table);
+}
+
+/* A uniform draw on [0,1) that depends only on key and counter, so any
+   thread can reproduce any episode's draws without shared state */
+static double rollout_random( unsigned long long key, unsigned int counter )
+{
+  // The counter-th draw of a splitmix64 generator started at key
+  unsigned long long z = key + (counter + 1ULL) * RANDOM_INCREMENT;
+
+  return random_double(random_mix(z));
+}
+
+/*  Procedure
+ *    rollout_episode
+ *
+ *  Purpose
+ *    Simulate one episode
+ *
+ *  Produces
+ *   value, a double
+ *
+ *  Postconditions
+ *    value is the discounted return of episode, as rollout_simulate
+ *    describes; *p_steps is the number of rewards collected and *p_ended
+ *    whether the episode ended before the horizon.
+ */
+static double rollout_episode( const rollout_arg* p_arg, unsigned long episode,
+			       unsigned int* p_steps, int* p_ended )
+{
+  const rollout_table *p_table = p_arg->p_table;
+  const mdp *p_mdp = p_table->p_mdp;
+  unsigned long long key;
+  unsigned int state = p_arg->state, steps, first, count, i;
+  double value = 0, discount = 1, draw;
+
+  key = random_mix(p_arg->seed * 0xD1B54A32D192ED03ULL + episode);
+  *p_ended = 0;
+
+  for (steps = 0 ; steps < p_arg->horizon ; )
+  {
+    value += discount * p_mdp->rewards[state];
+    steps++;
+
+    first = p_table->outcomeStart[state];
+    count = p_table->outcomeStart[state + 1] - first;
+
+    if (0 == count)
+    { // Terminal or without actions
+      *p_ended = 1;
+      break;
+    }
+
+    // One draw picks both the column and whether to keep it
+    draw = rollout_random(key, steps) * count;
+    i = (unsigned int)draw;
+
+    if (i >= count) // Only by rounding
+      i = count - 1;
+
+    if (draw - i >= p_table->keep[first + i])
+      i = p_table->alias[first + i] - first;
+
+    state = p_table->successor[first + i];
+
+    if (ROLLOUT_END == state)
+    {
+      *p_ended = 1;
+      break;
+    }
+
+    discount *= p_arg->gamma;
+  }
+
+  *p_steps = steps;
+
+  return value;
+}
+
+/* Claim and simulate batches until none are left */
+static void rollout_batches( void* p_void, unsigned int thread,
+			     unsigned int numThreads )
+{
+  rollout_arg *p_arg = p_void;
+  rollout_batch *p_batch;
+  unsigned long b, episode, last;
+  unsigned int steps;
+  double value, delta;
+  int ended;
+
+  while ((b = __atomic_fetch_add(&p_arg->next, 1, __ATOMIC_RELAXED)) <
+	 p_arg->numBatches)
+  {
+    p_batch = p_arg->batch + b;
+    memset(p_batch, 0, sizeof(rollout_batch));
+
+    last = (b + 1) * ROLLOUT_BATCH;
+
+    if (last > p_arg->episodes)
+      last = p_arg->episodes;
+
+    for (episode = b * ROLLOUT_BATCH ; episode < last ; episode++)
+    { // Welford's update of the mean and squared deviations
+      value = rollout_episode(p_arg, episode, &steps, &ended);
+
+      p_batch->count++;
+      delta = value - p_batch->mean;
+      p_batch->mean += delta / p_batch->count;
+      p_batch->m2 += delta * (value - p_batch->mean);
+      p_batch->steps += steps;
+      p_batch->ended += ended;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void rollout_simulate( thread_pool* p_pool, const rollout_table* p_table,
+		       unsigned int state, double gamma,
+		       unsigned long episodes, unsigned int horizon,
+		       unsigned long seed, rollout_stats* p_stats )
+{
+  rollout_arg arg;
+  unsigned long b;
+  unsigned long long steps = 0;
+  double delta, count, mean = 0, m2 = 0;
+
+  arg.p_table = p_table;
+  arg.state = state;
+  arg.gamma = gamma;
+  arg.episodes = episodes;
+  arg.horizon = horizon;
+  arg.seed = seed;
+  arg.numBatches = (episodes + ROLLOUT_BATCH - 1) / ROLLOUT_BATCH;
+  arg.next = 0;
+  arg.batch = malloc(sizeof(rollout_batch) * arg.numBatches);
+
+  if (NULL == arg.batch)
+  {
+    fprintf(stderr,"rollout_simulate failed: %s (%s)\n",
+	    "Could not allocate batches", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  thread_pool_run(p_pool, rollout_batches, &arg);
+
+  // Merge the batches in order (Chan et al.), whichever thread ran them
+  p_stats->episodes = 0;
+  p_stats->ended = 0;
+
+  for (b = 0 ; b < arg.numBatches ; b++)
+  {
+    count = p_stats->episodes + arg.batch[b].count;
+    delta = arg.batch[b].mean - mean;
+
+    mean += delta * arg.batch[b].count / count;
+    m2 += arg.batch[b].m2 +
+      delta * delta * p_stats->episodes * arg.batch[b].count / count;
+
+    p_stats->episodes += arg.batch[b].count;
+    p_stats->ended += arg.batch[b].ended;
+    steps += arg.batch[b].steps;
+  }
+
+  p_stats->mean = mean;
+  p_stats->variance = (p_stats->episodes > 1) ?
+    m2 / (p_stats->episodes - 1) : 0;
+  p_stats->halfWidth = ROLLOUT_Z95 *
+    sqrt(p_stats->variance / p_stats->episodes);
+  p_stats->meanSteps = (double)steps / p_stats->episodes;
+
+  free(arg.batch);
+}
@@ -0,0 +1,131 @@
+/* rollout.h
+ *
+ * Declarations for estimating the utility of a policy by simulating
+ * episodes from the start state, sampling successors from alias tables.
+ *
+ */
+
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include "mdp.h"
+#include "thread_pool.h"
+
+/* The successor distribution of every state under one policy, in a form
+   that samples a successor in constant time */
+typedef struct {
+  const mdp *p_mdp;
+  unsigned int *outcomeStart; /* numStates+1 offsets: state's outcomes are
+				 entries outcomeStart[state] up to (but
+				 excluding) outcomeStart[state+1] */
+  unsigned int *successor;    /* Successor of each outcome, or ROLLOUT_END
+				 where an episode ends */
+  unsigned int *alias;        /* Outcome taken instead of each outcome */
+  double *keep;               /* Probability of keeping each outcome */
+} rollout_table;
+
+/* Marks the outcome of a row that sums below one */
+#define ROLLOUT_END ((unsigned int)-1)
+
+/* Summary of the discounted returns of simulated episodes */
+typedef struct {
+  unsigned long episodes;     /* Episodes simulated */
+  double mean;                /* Mean discounted return */
+  double variance;            /* Sample variance of the returns */
+  double halfWidth;           /* Half width of the 95% confidence interval
+				 of the mean (normal approximation) */
+  double meanSteps;           /* Mean rewards collected per episode */
+  unsigned long ended;        /* Episodes that ended before the horizon */
+} rollout_stats;
+
+/*  Procedure
+ *    rollout_table_create
+ *
+ *  Purpose
+ *    Build the alias tables of the successors of a policy
+ *
+ *  Parameters
+ *   p_mdp
+ *   policy
+ *
+ *  Produces,
+ *   p_table, a rollout_table*
+ *
+ *  Preconditions
+ *    p_mdp points to a valid, complete mdp that outlives p_table, whose
+ *      transition rows each sum to at most one
+ *    policy points to a valid array of length p_mdp->numStates
+ *
+ *  Postconditions
+ *    Each nonterminal state with actions has one outcome per successor
+ *    of policy[state], plus one ending the episode when that row sums
+ *    below one (by more than rounding). Rows summing to one within
+ *    rounding are renormalized. Terminal states and states without
+ *    actions have no outcomes.
+ *    Any failure (including a policy choosing an unavailable action)
+ *    causes program exit.
+ */
+rollout_table* rollout_table_create( const mdp* p_mdp,
+				     const unsigned int* policy );
+
+/*  Procedure
+ *    rollout_table_free
+ *
+ *  Purpose
+ *    Release the alias tables of a policy
+ *
+ *  Parameters
+ *   p_table
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    All memory of p_table is released; NULL is ignored
+ */
+void rollout_table_free( rollout_table* p_table );
+
+/*  Procedure
+ *    rollout_simulate
+ *
+ *  Purpose
+ *    Estimate the utility of a policy at a state by simulating episodes
+ *
+ *  Parameters
+ *   p_pool
+ *   p_table
+ *   state
+ *   gamma
+ *   episodes
+ *   horizon
+ *   seed
+ *   p_stats
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_pool is NULL or was produced by thread_pool_create
+ *    0 <= state < p_table->p_mdp->numStates
+ *    0 < gamma <= 1
+ *    episodes > 0
+ *    horizon > 0
+ *    p_stats != NULL
+ *
+ *  Postconditions
+ *    Every episode starts at state and collects R(s_0) + gamma*R(s_1) +
+ *    ... until it collects a terminal or action-less state's reward,
+ *    takes an outcome that ends it, or has collected horizon rewards.
+ *    Episode e draws its successors from a counter-based generator
+ *    keyed by seed and e, and episodes are summarized in fixed batches
+ *    that are merged in order, so *p_stats depends only on the
+ *    arguments, never on the number of threads in p_pool.
+ *    The mean estimates the policy's utility at state (as
+ *    policy_evaluation computes it) up to the truncation at horizon.
+ */
+void rollout_simulate( thread_pool* p_pool, const rollout_table* p_table,
+		       unsigned int state, double gamma,
+		       unsigned long episodes, unsigned int horizon,
+		       unsigned long seed, rollout_stats* p_stats );
+
+#endif // ROLLOUT_H
@@ -0,0 +1,2483 @@
+/* solver.c
+ *
+ * Implementation of the value iteration and policy iteration solvers
+ * shared by the command-line programs and the benchmarks.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include "utilities.h"
+#include "thread_pool.h"
+#include "sweep.h"
+#include "policy_evaluation.h"
+#include "solver.h"
+#include "mdp.h"
+#include "lazy.h"
+#include "random.h"
+
+// Buffers are padded to a multiple of this many doubles, one cache line
+#define CONTEXT_ALIGN 8
+
+// States per block claimed by a thread in asynchronous value iteration
+#define ASYNC_BLOCK 256
+
+/* Shared state for one parallel sweep of value_iteration */
+typedef struct {
+  const mdp* p_mdp;
+  double gamma;
+  const double *utilities;    /* Utilities from the previous sweep */
+  double *updated_utilities;  /* Utilities produced by this sweep */
+  double *max_change;         /* Per-thread maximum utility change */
+  unsigned long *eu_count;    /* Per-thread expected utilities computed */
+} value_sweep_arg;
+
+/* Progress reporting for one run of a solver */
+typedef struct {
+  solver_observer observer;   /* NULL when nobody is listening */
+  void *arg;
+  solver_stats stats;
+  double start;               /* Wall time at which the run started */
+  unsigned long eu_start;     /* Caller's calc_eu_count at the start */
+} solver_monitor;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*  Procedure
+ *    context_reserve_batch
+ *
+ *  Purpose
+ *    Ensure a context's batch scratch holds a number of doubles
+ *
+ *  Parameters
+ *   p_ctx
+ *   length
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    p_ctx->batch holds at least length doubles, starting on a cache
+ *    line boundary; its contents are undefined after it grows.
+ *    Any failure causes program exit.
+ */
+static void context_reserve_batch( solver_context* p_ctx, size_t length )
+{
+  void *block;
+  int status;
+
+  if (length <= p_ctx->batchCapacity)
+    return;
+
+  status = posix_memalign(&block, CONTEXT_ALIGN * sizeof(double),
+			  length * sizeof(double));
+
+  if (0 != status)
+  {
+    fprintf(stderr,"solver_context_reserve failed: %s (%s)\n",
+	    "Could not allocate batch utilities", strerror(status));
+    exit(EXIT_FAILURE);
+  }
+
+  free(p_ctx->batch);
+
+  p_ctx->batch = block;
+  p_ctx->batchCapacity = length;
+}
+
+/*  Procedure
+ *    monitor_start
+ *
+ *  Purpose
+ *    Begin reporting the progress of a solver run
+ *
+ *  Parameters
+ *   p_monitor
+ *   observer
+ *   arg
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    p_monitor is ready for monitor_report. Nothing is timed or counted
+ *    when observer is NULL.
+ */
+static void monitor_start( solver_monitor *p_monitor, 
+			   solver_observer observer, void* arg )
+{
+  p_monitor->observer = observer;
+  p_monitor->arg = arg;
+
+  bzero(&p_monitor->stats, sizeof(solver_stats));
+
+  if (NULL != observer)
+  {
+    p_monitor->start = now();
+    p_monitor->eu_start = calc_eu_count();
+  }
+}
+
+/*  Procedure
+ *    monitor_report
+ *
+ *  Purpose
+ *    Report the end of one solver iteration
+ *
+ *  Parameters
+ *   p_monitor
+ *   residual
+ *   backups
+ *   eu_count
+ *   changes
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    monitor_start has been called on p_monitor
+ *
+ *  Postconditions
+ *    Unless the observer is NULL, it is called with the statistics of the
+ *    iteration. eu_count is the number of expected utilities computed
+ *    during the run, or 0 to take the count from the calling thread.
+ */
+static void monitor_report( solver_monitor *p_monitor, double residual,
+			    unsigned long backups, unsigned long eu_count,
+			    unsigned int changes )
+{
+  if (NULL == p_monitor->observer)
+    return;
+
+  p_monitor->stats.iteration++;
+  p_monitor->stats.residual = residual;
+  p_monitor->stats.seconds = now() - p_monitor->start;
+  p_monitor->stats.backups = backups;
+  p_monitor->stats.eu_count = eu_count ? eu_count : 
+    calc_eu_count() - p_monitor->eu_start;
+  p_monitor->stats.changes = changes;
+
+  p_monitor->observer(&p_monitor->stats, p_monitor->arg);
+}
+
+/* Adapt the progress of an in-place sweep order to monitor_report */
+static void monitor_progress( double residual, unsigned long backups,
+			      void* p_monitor )
+{
+  monitor_report(p_monitor, residual, backups, 0, 0);
+}
+
+/*  Procedure
+ *    value_sweep
+ *
+ *  Purpose
+ *    Apply the Bellman update to one thread's share of the states
+ *
+ *  Parameters
+ *   p_arg, a value_sweep_arg*
+ *   thread
+ *   numThreads
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_arg points to a valid value_sweep_arg
+ *
+ *  Postconditions
+ *    updated_utilities[s] holds the update of utilities[s] for every
+ *    state s in this thread's share, max_change[thread] holds the
+ *    largest change among them, and eu_count[thread] the number of
+ *    expected utilities computed
+ */
+static void value_sweep( void* p_arg, unsigned int thread,
+			 unsigned int numThreads )
+{
+  value_sweep_arg *p_sweep = p_arg;
+  const mdp *p_mdp = p_sweep->p_mdp;
+  double max_utilities_change, utilities_change;
+  unsigned int state, first, last;
+
+  unsigned long eu_start = calc_eu_count();
+
+  thread_pool_range(p_mdp->numStates, thread, numThreads, &first, &last);
+
+  max_utilities_change = 0;
+
+  for ( state = first; state < last ; state++ )
+  {
+    double meu;
+    unsigned int action;
+
+    if (p_mdp->terminal[state]) // if this is a terminal state
+    { 
+      // then the utility should be just the reward
+      p_sweep->updated_utilities[state] = p_mdp->rewards[state];
+    }
+    else
+    { 
+      // otherwise, it is reward + discount_rate * meu
+      calc_meu(p_mdp, state, p_sweep->utilities, &meu, &action);
+
+      p_sweep->updated_utilities[state] = p_mdp->rewards[state] + 
+	p_sweep->gamma * meu;
+    }
+      
+    utilities_change = fabs(p_sweep->updated_utilities[state] - 
+			    p_sweep->utilities[state]);
+
+    if (utilities_change > max_utilities_change)
+    {
+      max_utilities_change = utilities_change;
+    }
+  }
+
+  p_sweep->max_change[thread] = max_utilities_change;
+  p_sweep->eu_count[thread] = calc_eu_count() - eu_start;
+}
+
+/* Shared state for one pass of asynchronous value iteration */
+typedef struct {
+  const mdp* p_mdp;
+  double gamma;
+  double *utilities;          /* Shared utilities, updated in place */
+  const unsigned int *block;  /* Blocks to update in this pass */
+  unsigned int *next;         /* Per-thread next unclaimed entry of block */
+  const unsigned int *end;    /* Per-thread end of its share of block */
+  double *block_change;       /* Largest change in each block this pass */
+  double *max_change;         /* Per-thread maximum utility change */
+  unsigned long *eu_count;    /* Per-thread expected utilities computed */
+  unsigned long backups;      /* States updated in this pass (atomic) */
+} async_pass_arg;
+
+/*  Procedure
+ *    async_pass
+ *
+ *  Purpose
+ *    Update the blocks of one asynchronous pass, stealing blocks from
+ *    other threads once this thread's share is done
+ *
+ *  Parameters
+ *   p_arg, an async_pass_arg*
+ *   thread
+ *   numThreads
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_arg points to a valid async_pass_arg whose block list is split
+ *    into numThreads shares [next[t], end[t])
+ *
+ *  Postconditions
+ *    Every listed block has been claimed by exactly one thread, which
+ *    updated its states in place and in order, and recorded the
+ *    largest change in block_change. Threads read utilities that others
+ *    may be writing; each double is stored whole, so a reader sees
+ *    either the old or the new value (a benign race).
+ *    max_change[thread] and eu_count[thread] cover the blocks this
+ *    thread claimed.
+ */
+static void async_pass( void* p_arg, unsigned int thread,
+			unsigned int numThreads )
+{
+  async_pass_arg *p_pass = p_arg;
+  const mdp *p_mdp = p_pass->p_mdp;
+  double max_change, block_change, change, updated, meu;
+  unsigned int owner, claimed, block, state, first, last, action;
+  unsigned long backups = 0, eu_start = calc_eu_count();
+
+  max_change = 0;
+
+  // Own share first, then each other thread's in turn
+  for (owner = thread ; owner < thread + numThreads ; owner++)
+    while ((claimed = __atomic_fetch_add(&p_pass->next[owner % numThreads], 1,
+					 __ATOMIC_RELAXED)) 
+	   < p_pass->end[owner % numThreads])
+    {
+      block = p_pass->block[claimed];
+      first = block * ASYNC_BLOCK;
+      last = (first + ASYNC_BLOCK < p_mdp->numStates) ? 
+	first + ASYNC_BLOCK : p_mdp->numStates;
+
+      block_change = 0;
+
+      for (state = first ; state < last ; state++)
+      {
+	if (p_mdp->terminal[state])
+	  updated = p_mdp->rewards[state];
+	else
+	{
+	  calc_meu(p_mdp, state, p_pass->utilities, &meu, &action);
+	  updated = p_mdp->rewards[state] + p_pass->gamma * meu;
+	}
+
+	change = fabs(updated - p_pass->utilities[state]);
+	__atomic_store(p_pass->utilities + state, &updated, __ATOMIC_RELAXED);
+
+	if (change > block_change)
+	  block_change = change;
+      }
+
+      p_pass->block_change[block] = block_change;
+      backups += last - first;
+
+      if (block_change > max_change)
+	max_change = block_change;
+    }
+
+  p_pass->max_change[thread] = max_change;
+  p_pass->eu_count[thread] = calc_eu_count() - eu_start;
+  __atomic_fetch_add(&p_pass->backups, backups, __ATOMIC_RELAXED);
+}
+
+/*  Procedure
+ *    value_iteration_async
+ *
+ *  Purpose
+ *    Estimate utilities with asynchronous, in-place block updates
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   threshold
+ *   gamma
+ *   utilities
+ *   p_monitor
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_ctx is a context not in use by another solver
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    utilities points to a valid array of length p_mdp->numStates
+ *
+ *  Postconditions
+ *    A full pass over every state changed no utility by more than
+ *    threshold. States are grouped into blocks of ASYNC_BLOCK, which the
+ *    threads of p_ctx claim and update in place. After the first pass,
+ *    a block is only revisited while it, or a block holding one of its
+ *    successors, changed by more than threshold in the previous pass, so
+ *    regions that converge early stop costing updates; a full pass
+ *    confirms convergence before returning. Results depend (within the
+ *    tolerance) on how the threads interleave.
+ *    p_monitor is told of each pass.
+ */
+static unsigned long value_iteration_async( solver_context* p_ctx,
+					    const mdp* p_mdp,
+					    double threshold, double gamma,
+					    double *utilities,
+					    solver_monitor *p_monitor )
+{
+  unsigned int num_blocks, num_threads, num_active, num_links, thread;
+  unsigned int b, i, row_end, successor_block, full;
+  unsigned int *link_start, *link, *seen, *active, *next, *end;
+  double *block_change, max_change;
+  unsigned long backups, eu_count;
+  async_pass_arg pass;
+
+  num_blocks = (p_mdp->numStates + ASYNC_BLOCK - 1) / ASYNC_BLOCK;
+  num_threads = thread_pool_size(p_ctx->p_pool);
+
+  link_start = malloc(sizeof(unsigned int) * (num_blocks + 1));
+  seen = malloc(sizeof(unsigned int) * (num_blocks ? num_blocks : 1));
+  active = malloc(sizeof(unsigned int) * (num_blocks ? num_blocks : 1));
+  block_change = malloc(sizeof(double) * (num_blocks ? num_blocks : 1));
+  next = malloc(sizeof(unsigned int) * num_threads);
+  end = malloc(sizeof(unsigned int) * num_threads);
+
+  if (NULL == link_start || NULL == seen || NULL == active ||
+      NULL == block_change || NULL == next || NULL == end)
+  {
+    fprintf(stderr,"value_iteration failed: %s (%s)\n",
+	    "Could not allocate blocks", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  // List the distinct blocks holding successors of each block, counting
+  // them on the first pass and recording them on the second
+  link = NULL;
+
+  for (full = 0 ; full < 2 ; full++)
+  {
+    for (b = 0 ; b < num_blocks ; b++)
+      seen[b] = num_blocks;
+
+    num_links = 0;
+
+    for (b = 0 ; b < num_blocks ; b++)
+    {
+      link_start[b] = num_links;
+      i = p_mdp->transitionStart[(size_t)b * ASYNC_BLOCK * p_mdp->numActions];
+      row_end = (b + 1 == num_blocks) ? p_mdp->numTransitions :
+	p_mdp->transitionStart[(size_t)(b + 1) * ASYNC_BLOCK * 
+			       p_mdp->numActions];
+
+      for ( ; i < row_end ; i++)
+      {
+	successor_block = p_mdp->successor[i] / ASYNC_BLOCK;
+
+	if (seen[successor_block] != b && successor_block != b)
+	{
+	  seen[successor_block] = b;
+
+	  if (NULL != link)
+	    link[num_links] = successor_block;
+	  num_links++;
+	}
+      }
+    }
+
+    link_start[num_blocks] = num_links;
+
+    if (NULL == link)
+    {
+      link = malloc(sizeof(unsigned int) * (num_links ? num_links : 1));
+
+      if (NULL == link)
+      {
+	fprintf(stderr,"value_iteration failed: %s (%s)\n",
+		"Could not allocate block links", strerror(errno));
+	exit(EXIT_FAILURE);
+      }
+    }
+  }
+
+  pass.p_mdp = p_mdp;
+  pass.gamma = gamma;
+  pass.utilities = utilities;
+  pass.block = active;
+  pass.next = next;
+  pass.end = end;
+  pass.block_change = block_change;
+  pass.max_change = p_ctx->max_change;
+  pass.eu_count = p_ctx->eu_count;
+
+  backups = 0;
+  eu_count = 0;
+  full = 1;
+
+  while (1)
+  {
+    // Choose this pass's blocks
+    num_active = 0;
+
+    for (b = 0 ; b < num_blocks ; b++)
+    {
+      if (!full && !(block_change[b] > threshold))
+      { // Skip a settled block unless a successor's block moved
+	for (i = link_start[b] ; i < link_start[b+1] ; i++)
+	  if (block_change[link[i]] > threshold)
+	    break;
+
+	if (i == link_start[b+1])
+	  continue;
+      }
+
+      active[num_active++] = b;
+    }
+
+    // Changes from passes before the last no longer matter
+    for (b = 0 ; b < num_blocks ; b++)
+      block_change[b] = 0;
+
+    for (thread = 0 ; thread < num_threads ; thread++)
+      thread_pool_range(num_active, thread, num_threads, 
+			next + thread, end + thread);
+
+    pass.backups = 0;
+    thread_pool_run(p_ctx->p_pool, async_pass, &pass);
+    backups += pass.backups;
+
+    max_change = 0;
+
+    for (thread = 0 ; thread < num_threads ; thread++)
+    {
+      if (p_ctx->max_change[thread] > max_change)
+	max_change = p_ctx->max_change[thread];
+
+      eu_count += p_ctx->eu_count[thread];
+    }
+
+    monitor_report(p_monitor, max_change, backups, eu_count, 0);
+
+    if (!(max_change > threshold))
+    {
+      if (full)
+	break;   // A full pass confirmed convergence
+
+      full = 1;  // Check every block before stopping
+    }
+    else
+      full = 0;
+  }
+
+  free(link_start);
+  free(link);
+  free(seen);
+  free(active);
+  free(block_change);
+  free(next);
+  free(end);
+
+  return backups;
+}
+
+/* Shared state for one parallel sweep of value_iteration_batch */
+typedef struct {
+  const mdp* p_mdp;
+  unsigned int count;         /* Number of unconverged problems */
+  const unsigned int *column; /* Problem solved in each column */
+  const double *gammas;       /* Discount of each problem */
+  const double *rewards;      /* Rewards of each problem, or NULL */
+  const double *utilities;    /* Utilities from the previous sweep */
+  double *updated_utilities;  /* Utilities produced by this sweep */
+  double *max_change;         /* Per-thread, per-column maximum change */
+  double *eu;                 /* Per-thread expected utilities of a state */
+  size_t eu_stride;           /* Doubles of eu each thread owns */
+  unsigned long *eu_count;    /* Per-thread expected utilities computed */
+} batch_sweep_arg;
+
+/*  Procedure
+ *    batch_sweep
+ *
+ *  Purpose
+ *    Apply the Bellman update of every problem in a batch to one
+ *    thread's share of the states
+ *
+ *  Parameters
+ *   p_arg, a batch_sweep_arg*
+ *   thread
+ *   numThreads
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_arg points to a valid batch_sweep_arg
+ *
+ *  Postconditions
+ *    For every state s in this thread's share and column k,
+ *    updated_utilities[s*count + k] holds the update of utilities[s*count
+ *    + k] for problem column[k], and max_change[thread*count + k] the
+ *    largest change among them. eu_count[thread] holds the number of
+ *    expected utilities computed.
+ */
+static void batch_sweep( void* p_arg, unsigned int thread,
+			 unsigned int numThreads )
+{
+  batch_sweep_arg *p_sweep = p_arg;
+  const mdp *p_mdp = p_sweep->p_mdp;
+  unsigned int count = p_sweep->count;
+  double *eu = p_sweep->eu + thread * p_sweep->eu_stride;
+  double *max_change = p_sweep->max_change + thread * count;
+  double meu, reward, change;
+  const double *utilities;
+  double *updated;
+  unsigned int state, first, last, i, k;
+  unsigned long eu_start = calc_eu_count();
+
+  thread_pool_range(p_mdp->numStates, thread, numThreads, &first, &last);
+
+  for ( k = 0 ; k < count ; k++ )
+    max_change[k] = 0;
+
+  for ( state = first; state < last ; state++ )
+  {
+    utilities = p_sweep->utilities + (size_t)state * count;
+    updated = p_sweep->updated_utilities + (size_t)state * count;
+
+    if (!p_mdp->terminal[state])
+      calc_eu_batch(p_mdp, state, p_sweep->utilities, count, eu);
+
+    for ( k = 0 ; k < count ; k++ )
+    {
+      reward = p_sweep->rewards ? p_sweep->rewards
+	[(size_t)p_sweep->column[k] * p_mdp->numStates + state] : 
+	p_mdp->rewards[state];
+
+      if (p_mdp->terminal[state])
+	updated[k] = reward;
+      else
+      { // reward + discount_rate * meu, as calc_meu finds it
+	meu = (0 == p_mdp->numAvailableActions[state]) ? 0 : -INFINITY;
+
+	for ( i = 0 ; i < p_mdp->numAvailableActions[state] ; i++ )
+	  if (eu[p_mdp->actions[state][i] * count + k] > meu)
+	    meu = eu[p_mdp->actions[state][i] * count + k];
+
+	updated[k] = reward + p_sweep->gammas[p_sweep->column[k]] * meu;
+      }
+
+      change = fabs(updated[k] - utilities[k]);
+
+      if (change > max_change[k])
+	max_change[k] = change;
+    }
+  }
+
+  p_sweep->eu_count[thread] = calc_eu_count() - eu_start;
+}
+
+/*  Procedure
+ *    value_backup
+ *
+ *  Purpose
+ *    Apply the Bellman update to a single state
+ *
+ *  Parameters
+ *   p_mdp
+ *   state
+ *   utilities
+ *   p_gamma, a const double*
+ *
+ *  Produces,
+ *   utility, a double
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    utilities points to a valid array of length p_mdp->numStates
+ *
+ *  Postconditions
+ *    utility = R(state) for terminal states, and
+ *    R(state) + gamma * MEU(state) otherwise
+ */
+static double value_backup( const mdp* p_mdp, unsigned int state,
+			    const double* utilities, const void* p_gamma )
+{
+  double meu;
+  unsigned int action;
+
+  if (p_mdp->terminal[state])
+    return p_mdp->rewards[state];
+
+  calc_meu(p_mdp, state, utilities, &meu, &action);
+
+  return p_mdp->rewards[state] + *(const double*)p_gamma * meu;
+}
+
+/*  Procedure
+ *    value_iteration
+ *
+ *  Purpose
+ *    Estimate utilities with iterative updates
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   mode
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    p_ctx is NULL or a context not in use by another solver
+ *
+ *  Postconditions
+ *    utilities[s] contains the estimated utility value for the given state
+ *    Updates are ordered according to mode. SWEEP_JACOBI sweeps are split
+ *    over the threads of p_ctx (the caller alone when NULL); results do
+ *    not depend on the number of threads. SWEEP_ASYNC has the threads
+ *    claim blocks of states and update them in place, stealing blocks
+ *    from each other, and stops revisiting blocks whose neighborhood
+ *    has settled; its results vary within the tolerance from run to
+ *    run. SWEEP_TOPOLOGICAL solves the strongly connected components of
+ *    the transition graph successors first, splitting components that
+ *    cannot reach each other over the threads; its results do not
+ *    depend on the number of threads. Other modes run in the caller.
+ *    Scratch space comes from p_ctx, which grows as needed; when p_ctx
+ *    is NULL a temporary context is used.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    sweep (for the prioritized order, every numStates updates and at
+ *    the end), given the largest utility change in it.
+ *
+ *  Authors
+ *    Daniel Nanetti-Palacios
+ *    Tyler Dewey
+ *
+ * Documentation adapted from Jerod Weinman's policy_iteration.c
+ */ 
+unsigned long value_iteration( solver_context* p_ctx, const mdp* p_mdp,
+			       double epsilon, double gamma,
+			       double *utilities, sweep_mode mode,
+			       solver_observer observer, void* observer_arg)
+{
+  // Run value iteration!
+
+  double *updated_utilities;
+  double max_utilities_change;
+  unsigned int num_states, num_threads, thread;
+  unsigned long backups, eu_count;
+  size_t utilities_size;
+  value_sweep_arg sweep;
+  solver_monitor monitor;
+  solver_context *p_owned = NULL;
+
+  if (NULL == p_ctx)
+    p_ctx = p_owned = solver_context_create(1);
+
+  num_states = p_mdp->numStates;
+  num_threads = thread_pool_size(p_ctx->p_pool);
+  utilities_size = sizeof(double) * num_states;
+
+  monitor_start(&monitor, observer, observer_arg);
+
+  if (SWEEP_JACOBI != mode)
+  { // In-place modes start from zero utilities too
+    bzero(utilities, utilities_size);
+
+    // The model may have been edited since the context last swept it
+    sweep_graph_clear(p_ctx->p_graph);
+
+    if (SWEEP_ASYNC == mode)
+    {
+      solver_context_reserve(p_ctx, num_states, p_mdp->numActions);
+      backups = value_iteration_async(p_ctx, p_mdp, 
+				      epsilon * (1 - gamma) / gamma,
+				      gamma, utilities, &monitor);
+    }
+    else if (SWEEP_TOPOLOGICAL == mode)
+      backups = sweep_topological(p_mdp, value_backup, &gamma,
+				  epsilon * (1 - gamma) / gamma, utilities,
+				  p_ctx->p_graph, p_ctx->p_pool,
+				  observer ? monitor_progress : NULL, 
+				  &monitor);
+    else if (SWEEP_GAUSS_SEIDEL == mode)
+      backups = sweep_gauss_seidel(p_mdp, value_backup, &gamma, 
+				   epsilon * (1 - gamma) / gamma, utilities,
+				   observer ? monitor_progress : NULL, 
+				   &monitor);
+    else
+      backups = sweep_prioritized(p_mdp, value_backup, &gamma, 
+				  epsilon * (1 - gamma) / gamma, utilities,
+				  p_ctx->p_graph,
+				  observer ? monitor_progress : NULL, 
+				  &monitor);
+
+    solver_context_free(p_owned);
+    return backups;
+  }
+
+  backups = 0;
+
+  solver_context_reserve(p_ctx, num_states, p_mdp->numActions);
+
+  updated_utilities = p_ctx->updated_utilities;
+  bzero(updated_utilities, utilities_size);
+
+  eu_count = 0;
+
+  sweep.p_mdp = p_mdp;
+  sweep.gamma = gamma;
+  sweep.utilities = utilities;
+  sweep.updated_utilities = updated_utilities;
+  sweep.max_change = p_ctx->max_change;
+  sweep.eu_count = p_ctx->eu_count;
+
+  do 
+  {
+    // update the old utilities
+    memcpy(utilities, updated_utilities, utilities_size);
+
+    thread_pool_run(p_ctx->p_pool, value_sweep, &sweep);
+    backups += num_states;
+
+    // Reduce the per-thread changes
+    max_utilities_change = 0;
+
+    for ( thread = 0 ; thread < num_threads ; thread++ )
+    {
+      if (p_ctx->max_change[thread] > max_utilities_change)
+	max_utilities_change = p_ctx->max_change[thread];
+
+      eu_count += p_ctx->eu_count[thread];
+    }
+
+    monitor_report(&monitor, max_utilities_change, backups, eu_count, 0);
+
+  } while(!(max_utilities_change < (epsilon * (1 - gamma) / gamma)));
+
+  // Clean up
+  solver_context_free(p_owned);
+
+  return backups;
+}
+
+/*  Procedure
+ *    value_iteration_resume
+ *
+ *  Purpose
+ *    Update utilities from an earlier solution after the model changed
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   changed
+ *   numChanged
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    utilities points to a valid array of length p_mdp->numStates
+ *      holding a starting estimate, e.g., from mdp_read_utilities
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    changed is NULL or points to numChanged states
+ *    p_ctx is NULL or a context not in use by another solver
+ *
+ *  Postconditions
+ *    utilities[s] contains the estimated utility value for the given
+ *    state, to the same tolerance as value_iteration.
+ *    Updates are made in prioritized order starting from the given
+ *    utilities. When changed is NULL every state is checked first (a
+ *    warm start). Otherwise utilities must have converged for p_mdp
+ *    before the rewards, terminal flags or transition rows of the
+ *    changed states were edited, and only those states and their
+ *    predecessors are checked first, so the updates needed grow with
+ *    the effect of the edit rather than with the size of p_mdp.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg every
+ *    numStates updates and at the end.
+ *    The prioritized order runs in the caller; the predecessors it needs
+ *    are kept in p_ctx (see value_iteration), or in a temporary context
+ *    when p_ctx is NULL.
+ */
+unsigned long value_iteration_resume( solver_context* p_ctx,
+				      const mdp* p_mdp, double epsilon,
+				      double gamma, double* utilities,
+				      const unsigned int* changed,
+				      unsigned int numChanged,
+				      solver_observer observer,
+				      void* observer_arg )
+{
+  unsigned long backups;
+  solver_monitor monitor;
+  solver_context *p_owned = NULL;
+
+  if (NULL == p_ctx)
+    p_ctx = p_owned = solver_context_create(1);
+
+  // The model has been edited since the context last swept it
+  sweep_graph_clear(p_ctx->p_graph);
+
+  monitor_start(&monitor, observer, observer_arg);
+
+  backups = sweep_prioritized_from(p_mdp, value_backup, &gamma,
+				   epsilon * (1 - gamma) / gamma, utilities,
+				   changed, numChanged, p_ctx->p_graph,
+				   observer ? monitor_progress : NULL, &monitor);
+
+  solver_context_free(p_owned);
+
+  return backups;
+}
+
+/* Shared state for one parallel sweep of value_iteration_eliminate */
+typedef struct {
+  const mdp* p_mdp;
+  double gamma;
+  double margin;              /* Expected utility gap that eliminates */
+  const double *utilities;    /* Utilities from the previous sweep */
+  double *updated_utilities;  /* Utilities produced by this sweep */
+  unsigned int *active;       /* Remaining actions, listed by state */
+  const unsigned int *active_start; /* Start of each state's list */
+  unsigned int *num_active;   /* Length of each state's list */
+  double *low_change;         /* Per-thread smallest signed change */
+  double *high_change;        /* Per-thread largest signed change */
+  unsigned long *eu_count;    /* Per-thread expected utilities computed */
+  unsigned int *eliminated;   /* Per-thread actions eliminated */
+} eliminate_sweep_arg;
+
+/*  Procedure
+ *    eliminate_sweep
+ *
+ *  Purpose
+ *    Apply the Bellman update over the remaining actions to one
+ *    thread's share of the states, eliminating suboptimal actions
+ *
+ *  Parameters
+ *   p_arg, an eliminate_sweep_arg*
+ *   thread
+ *   numThreads
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_arg points to a valid eliminate_sweep_arg
+ *
+ *  Postconditions
+ *    updated_utilities[s] holds the update of utilities[s] for every
+ *    state s in this thread's share, whose action lists keep only the
+ *    actions within margin of the best. low_change[thread] and
+ *    high_change[thread] hold the smallest and largest signed changes
+ *    (bounded by zero), eliminated[thread] the number of actions
+ *    dropped, and eu_count[thread] the expected utilities computed.
+ */
+static void eliminate_sweep( void* p_arg, unsigned int thread,
+			     unsigned int numThreads )
+{
+  eliminate_sweep_arg *p_sweep = p_arg;
+  const mdp *p_mdp = p_sweep->p_mdp;
+  double low, high, change, meu;
+  unsigned int state, first, last, action, kept, eliminated;
+
+  unsigned long eu_start = calc_eu_count();
+
+  thread_pool_range(p_mdp->numStates, thread, numThreads, &first, &last);
+
+  low = high = 0;
+  eliminated = 0;
+
+  for ( state = first; state < last ; state++ )
+  {
+    if (p_mdp->terminal[state])
+      p_sweep->updated_utilities[state] = p_mdp->rewards[state];
+    else
+    {
+      kept = calc_meu_eliminate(p_mdp, state, p_sweep->utilities,
+				p_sweep->active + p_sweep->active_start[state],
+				p_sweep->num_active[state], p_sweep->margin,
+				&meu, &action);
+
+      eliminated += p_sweep->num_active[state] - kept;
+      p_sweep->num_active[state] = kept;
+
+      p_sweep->updated_utilities[state] = p_mdp->rewards[state] + 
+	p_sweep->gamma * meu;
+    }
+
+    change = p_sweep->updated_utilities[state] - p_sweep->utilities[state];
+
+    if (change < low)
+      low = change;
+    else if (change > high)
+      high = change;
+  }
+
+  p_sweep->low_change[thread] = low;
+  p_sweep->high_change[thread] = high;
+  p_sweep->eliminated[thread] = eliminated;
+  p_sweep->eu_count[thread] = calc_eu_count() - eu_start;
+}
+
+/*  Procedure
+ *    value_iteration_eliminate
+ *
+ *  Purpose
+ *    Estimate utilities with Jacobi sweeps that permanently eliminate
+ *    actions proven suboptimal by bounds on the utilities
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp whose transition rows
+ *      each sum to at most one
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    p_ctx is NULL or a context not in use by another solver
+ *
+ *  Postconditions
+ *    utilities[s] contains the estimated utility value for the given
+ *    state, to the same tolerance as a SWEEP_JACOBI value_iteration.
+ *    After each sweep, the smallest and largest changes bound the true
+ *    utilities (MacQueen's bounds, widened to include zero because
+ *    terminal utilities do not move), and in the next sweep an action
+ *    whose expected utility under the upper bound falls below the best
+ *    under the lower bound is dropped from its state for good. Optimal
+ *    actions are never dropped, so sweeps compute fewer expected
+ *    utilities as the bounds tighten. Sweeps are split over the threads
+ *    of p_ctx; results do not depend on the number of threads.
+ *    Scratch space comes from p_ctx, which grows as needed; when p_ctx
+ *    is NULL a temporary context is used.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    sweep, given the largest utility change and the number of actions
+ *    eliminated in it (as changes).
+ */
+unsigned long value_iteration_eliminate( solver_context* p_ctx,
+					 const mdp* p_mdp, double epsilon,
+					 double gamma, double *utilities,
+					 solver_observer observer,
+					 void* observer_arg )
+{
+  double *updated_utilities, low, high, residual;
+  unsigned int *active, *active_start, *num_active;
+  unsigned int num_states, num_threads, thread, state, eliminated;
+  unsigned long backups, eu_count;
+  size_t utilities_size;
+  eliminate_sweep_arg sweep;
+  solver_monitor monitor;
+  solver_context *p_owned = NULL;
+
+  if (NULL == p_ctx)
+    p_ctx = p_owned = solver_context_create(1);
+
+  num_states = p_mdp->numStates;
+  num_threads = thread_pool_size(p_ctx->p_pool);
+  utilities_size = sizeof(double) * num_states;
+
+  double low_change[num_threads];
+
+  // Every state starts with all of its available actions
+  active_start = malloc(sizeof(unsigned int) * (num_states + 1));
+  num_active = malloc(sizeof(unsigned int) * (num_states ? num_states : 1));
+
+  if (NULL == active_start || NULL == num_active)
+  {
+    fprintf(stderr,"value_iteration_eliminate failed: %s (%s)\n",
+	    "Could not allocate action lists", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  active_start[0] = 0;
+
+  for (state = 0 ; state < num_states ; state++)
+  {
+    num_active[state] = p_mdp->numAvailableActions[state];
+    active_start[state + 1] = active_start[state] + num_active[state];
+  }
+
+  active = malloc(sizeof(unsigned int) * 
+		  (active_start[num_states] ? active_start[num_states] : 1));
+
+  if (NULL == active)
+  {
+    fprintf(stderr,"value_iteration_eliminate failed: %s (%s)\n",
+	    "Could not allocate action lists", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  for (state = 0 ; state < num_states ; state++)
+    memcpy(active + active_start[state], p_mdp->actions[state],
+	   sizeof(unsigned int) * num_active[state]);
+
+  monitor_start(&monitor, observer, observer_arg);
+
+  solver_context_reserve(p_ctx, num_states, p_mdp->numActions);
+
+  updated_utilities = p_ctx->updated_utilities;
+  bzero(updated_utilities, utilities_size);
+
+  backups = 0;
+  eu_count = 0;
+
+  sweep.p_mdp = p_mdp;
+  sweep.gamma = gamma;
+  sweep.margin = INFINITY;    // No bounds before the first sweep
+  sweep.utilities = utilities;
+  sweep.updated_utilities = updated_utilities;
+  sweep.active = active;
+  sweep.active_start = active_start;
+  sweep.num_active = num_active;
+  sweep.low_change = low_change;
+  sweep.high_change = p_ctx->max_change;
+  sweep.eu_count = p_ctx->eu_count;
+  sweep.eliminated = p_ctx->changes;
+
+  do 
+  {
+    memcpy(utilities, updated_utilities, utilities_size);
+
+    thread_pool_run(p_ctx->p_pool, eliminate_sweep, &sweep);
+    backups += num_states;
+
+    // Reduce the per-thread changes
+    low = high = 0;
+    eliminated = 0;
+
+    for ( thread = 0 ; thread < num_threads ; thread++ )
+    {
+      if (low_change[thread] < low)
+	low = low_change[thread];
+
+      if (p_ctx->max_change[thread] > high)
+	high = p_ctx->max_change[thread];
+
+      eliminated += p_ctx->changes[thread];
+      eu_count += p_ctx->eu_count[thread];
+    }
+
+    // The true utilities lie within [gamma/(1-gamma)] * [low, high] of
+    // the updated ones, and expected utilities (rows summing to at most
+    // one) within the same interval, so an action more than its width
+    // below the best cannot be optimal
+    sweep.margin = gamma / (1 - gamma) * (high - low);
+
+    residual = (high > -low) ? high : -low;
+
+    monitor_report(&monitor, residual, backups, eu_count, eliminated);
+
+  } while(!(residual < (epsilon * (1 - gamma) / gamma)));
+
+  // Clean up
+  free(active);
+  free(num_active);
+  free(active_start);
+  solver_context_free(p_owned);
+
+  return backups;
+}
+
+/*  Procedure
+ *    value_iteration_batch
+ *
+ *  Purpose
+ *    Estimate utilities for several discounts and reward vectors of one
+ *    transition model at once
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   count
+ *   gammas
+ *   rewards
+ *   epsilon
+ *   utilities
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_ctx is NULL or a context not in use by another solver
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    count > 0
+ *    gammas points to count discounts, each 0 < gammas[k] < 1
+ *    rewards is NULL or points to count reward vectors of length
+ *      p_mdp->numStates, vector k starting at rewards[k*numStates]
+ *    epsilon > 0
+ *    utilities points to a valid array of p_mdp->numStates * count
+ *
+ *  Postconditions
+ *    utilities[s*count + k] is the utility of state s for problem k,
+ *    which discounts by gammas[k] and takes its rewards from vector k
+ *    (or from p_mdp when rewards is NULL). Each problem is identical to
+ *    a SWEEP_JACOBI value_iteration; it stops being updated once it
+ *    converges, while every sweep reads each transition once for all
+ *    unconverged problems. Sweeps are split over the threads of p_ctx.
+ *    backups is the number of single-state Bellman updates performed,
+ *    summed over the problems.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    sweep, given the largest utility change among unconverged problems.
+ */
+unsigned long value_iteration_batch( solver_context* p_ctx, const mdp* p_mdp,
+				     unsigned int count, const double* gammas,
+				     const double* rewards, double epsilon,
+				     double* utilities, 
+				     solver_observer observer,
+				     void* observer_arg )
+{
+  double *work, *updated_work, max_utilities_change, column_change;
+  unsigned int num_states, num_threads, thread, k, kept, state, active;
+  unsigned long backups, eu_count;
+  unsigned int column[count];
+  unsigned char keep[count];
+  size_t length, i;
+  batch_sweep_arg sweep;
+  solver_monitor monitor;
+  solver_context *p_owned = NULL;
+
+  if (NULL == p_ctx)
+    p_ctx = p_owned = solver_context_create(1);
+
+  num_states = p_mdp->numStates;
+  num_threads = thread_pool_size(p_ctx->p_pool);
+  length = (size_t)num_states * count;
+
+  monitor_start(&monitor, observer, observer_arg);
+
+  // Scratch: this and the next sweep's utilities of the unconverged
+  // problems, then per-thread changes, then per-thread expected
+  // utilities of every action and problem (each a whole number of cache
+  // lines, so threads never share one)
+  sweep.eu_stride = ((size_t)p_mdp->numActions * count + CONTEXT_ALIGN - 1) /
+    CONTEXT_ALIGN * CONTEXT_ALIGN;
+  context_reserve_batch(p_ctx, 2 * length + (size_t)num_threads * count +
+			num_threads * sweep.eu_stride + CONTEXT_ALIGN);
+
+  work = p_ctx->batch;
+  updated_work = work + length;
+
+  bzero(updated_work, sizeof(double) * length);
+
+  for ( k = 0 ; k < count ; k++ )
+    column[k] = k;
+
+  sweep.p_mdp = p_mdp;
+  sweep.column = column;
+  sweep.gammas = gammas;
+  sweep.rewards = rewards;
+  sweep.utilities = work;
+  sweep.updated_utilities = updated_work;
+  sweep.max_change = updated_work + length;
+  sweep.eu = sweep.max_change +
+    ((size_t)num_threads * count + CONTEXT_ALIGN - 1) / CONTEXT_ALIGN * 
+    CONTEXT_ALIGN;
+  sweep.eu_count = p_ctx->eu_count;
+
+  backups = 0;
+  eu_count = 0;
+  active = count;
+
+  do
+  {
+    // update the old utilities
+    memcpy(work, updated_work, sizeof(double) * num_states * active);
+
+    sweep.count = active;
+    thread_pool_run(p_ctx->p_pool, batch_sweep, &sweep);
+    backups += (unsigned long)num_states * active;
+
+    max_utilities_change = 0;
+
+    for ( thread = 0 ; thread < num_threads ; thread++ )
+      eu_count += p_ctx->eu_count[thread];
+
+    // Reduce the per-thread changes of each column, moving the problems
+    // that are still unconverged to the front
+    kept = 0;
+
+    for ( k = 0 ; k < active ; k++ )
+    {
+      column_change = 0;
+
+      for ( thread = 0 ; thread < num_threads ; thread++ )
+	if (sweep.max_change[thread * active + k] > column_change)
+	  column_change = sweep.max_change[thread * active + k];
+
+      if (column_change > max_utilities_change)
+	max_utilities_change = column_change;
+
+      keep[k] = !(column_change < 
+		  epsilon * (1 - gammas[column[k]]) / gammas[column[k]]);
+
+      if (keep[k])
+	column[kept++] = column[k];
+      else
+	// Return the utilities value_iteration would, the ones this
+	// sweep started from
+	for ( state = 0 ; state < num_states ; state++ )
+	  utilities[(size_t)state * count + column[k]] = 
+	    work[(size_t)state * active + k];
+    }
+
+    monitor_report(&monitor, max_utilities_change, backups, eu_count, 0);
+
+    // Drop converged columns from the latest sweep; this is safe in
+    // place since no entry moves to a later position
+    if (kept < active)
+      for ( state = 0, i = 0 ; state < num_states ; state++ )
+	for ( k = 0 ; k < active ; k++ )
+	  if (keep[k])
+	    updated_work[i++] = updated_work[(size_t)state * active + k];
+
+    active = kept;
+
+  } while (active > 0);
+
+  // Clean up
+  solver_context_free(p_owned);
+
+  return backups;
+}
+
+/* Shared state for one parallel policy improvement step */
+typedef struct {
+  const mdp* p_mdp;
+  double gamma;
+  const double *utilities;    /* Utilities of the current policy */
+  double *updated_utilities;  /* Full Bellman update, or NULL */
+  unsigned int *policy;       /* Policy, improved in place */
+  double *max_change;         /* Per-thread Bellman residual */
+  double *eu;                 /* Per-thread expected utilities of a state */
+  unsigned int eu_stride;     /* Doubles of eu each thread owns */
+  unsigned long *eu_count;    /* Per-thread expected utilities computed */
+  unsigned int *changes;      /* Per-thread policy changes */
+} improvement_sweep_arg;
+
+/*  Procedure
+ *    improvement_sweep
+ *
+ *  Purpose
+ *    Improve the policy in one thread's share of the states
+ *
+ *  Parameters
+ *   p_arg, an improvement_sweep_arg*
+ *   thread
+ *   numThreads
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_arg points to a valid improvement_sweep_arg
+ *
+ *  Postconditions
+ *    For every state s in this thread's share, policy[s] is changed to
+ *    the action of maximum expected utility when that is strictly
+ *    greater than the expected utility of policy[s], and
+ *    updated_utilities[s] (when not NULL) holds the full Bellman update.
+ *    changes[thread], max_change[thread] and eu_count[thread] hold the
+ *    number of policy entries changed, the largest change the update
+ *    makes, and the expected utilities computed, over the share.
+ */
+static void improvement_sweep( void* p_arg, unsigned int thread,
+			       unsigned int numThreads )
+{
+  improvement_sweep_arg *p_sweep = p_arg;
+  const mdp *p_mdp = p_sweep->p_mdp;
+  const double *utilities = p_sweep->utilities;
+  unsigned int *policy = p_sweep->policy;
+  double *eu = p_sweep->eu + (size_t)thread * p_sweep->eu_stride;
+  double current_eu, meu, updated, change, residual;
+  unsigned int state, first, last, i, action, maximizing_action, changes;
+  unsigned long eu_start = calc_eu_count();
+
+  thread_pool_range(p_mdp->numStates, thread, numThreads, &first, &last);
+
+  changes = 0;
+  residual = 0;
+
+  for ( state = first; state < last ; state++ )
+  {
+    if (p_mdp->terminal[state] || 0 == p_mdp->numAvailableActions[state])
+      meu = 0;
+    else
+    {
+      calc_eu_all(p_mdp, state, utilities, eu);
+
+      current_eu = eu[policy[state]];
+      
+      meu = -INFINITY;
+      maximizing_action = 0;
+      
+      for (i = 0 ; i < p_mdp->numAvailableActions[state] ; i++)
+      {
+	action = p_mdp->actions[state][i];
+	
+	if (eu[action] > meu)
+	{
+	  meu = eu[action];
+	  maximizing_action = action;
+	}
+      }
+
+      if (meu > current_eu)
+      {
+	policy[state] = maximizing_action;
+	changes++;
+      }
+    }
+
+    if (p_mdp->terminal[state])
+      updated = p_mdp->rewards[state];
+    else
+      updated = p_mdp->rewards[state] + p_sweep->gamma * meu;
+
+    change = fabs(updated - utilities[state]);
+
+    if (change > residual)
+      residual = change;
+
+    if (NULL != p_sweep->updated_utilities)
+      p_sweep->updated_utilities[state] = updated;
+  }
+
+  p_sweep->changes[thread] = changes;
+  p_sweep->max_change[thread] = residual;
+  p_sweep->eu_count[thread] = calc_eu_count() - eu_start;
+}
+
+/*  Procedure
+ *    policy_improvement
+ *
+ *  Purpose
+ *    Make a policy greedy with respect to the given utilities
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   gamma
+ *   utilities
+ *   updated_utilities
+ *   policy
+ *   residual
+ *
+ *  Produces,
+ *   changes, an unsigned int
+ *
+ *  Preconditions
+ *    p_ctx is a context not in use by another solver, reserved for
+ *    p_mdp->numActions actions (see solver_context_reserve)
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    utilities and updated_utilities point to distinct valid arrays of 
+ *    length p_mdp->numStates, or updated_utilities is NULL
+ *    policy points to a valid array of length p_mdp->numStates
+ *    residual != NULL
+ *
+ *  Postconditions
+ *    policy[s] is changed to the action of maximum expected utility 
+ *    when that is strictly greater than the expected utility of policy[s]
+ *    changes is the number of policy entries changed
+ *    *residual is the largest change the full Bellman update makes to
+ *    utilities, and updated_utilities (when not NULL) holds that update.
+ *    Each state's expected utilities are computed once, serving both the
+ *    current action and the maximization. The states are split over the
+ *    threads of p_ctx; as each depends only on utilities, the results
+ *    do not depend on the number of threads.
+ */
+static unsigned int policy_improvement( solver_context* p_ctx,
+					const mdp* p_mdp, double gamma,
+					const double* utilities,
+					double* updated_utilities,
+					unsigned int *policy, double *residual)
+{
+  improvement_sweep_arg sweep;
+  unsigned int thread, num_threads, changes;
+
+  num_threads = thread_pool_size(p_ctx->p_pool);
+
+  sweep.p_mdp = p_mdp;
+  sweep.gamma = gamma;
+  sweep.utilities = utilities;
+  sweep.updated_utilities = updated_utilities;
+  sweep.policy = policy;
+  sweep.max_change = p_ctx->max_change;
+  sweep.eu = p_ctx->eu;
+  sweep.eu_stride = p_ctx->actionCapacity;
+  sweep.eu_count = p_ctx->eu_count;
+  sweep.changes = p_ctx->changes;
+
+  thread_pool_run(p_ctx->p_pool, improvement_sweep, &sweep);
+
+  // Reduce the per-thread results; the caller's share is already counted
+  changes = p_ctx->changes[0];
+  *residual = p_ctx->max_change[0];
+
+  for ( thread = 1 ; thread < num_threads ; thread++ )
+  {
+    changes += p_ctx->changes[thread];
+
+    if (p_ctx->max_change[thread] > *residual)
+      *residual = p_ctx->max_change[thread];
+
+    calc_eu_credit(p_ctx->eu_count[thread]);
+  }
+
+  return changes;
+}
+
+/* Shared state for one parallel sweep of lazy_value_iteration */
+typedef struct {
+  double gamma;
+  unsigned int numStates;
+  lazy_cache **caches;        /* One cache per thread */
+  const double *utilities;    /* Utilities from the previous sweep */
+  double *updated_utilities;  /* Utilities produced by this sweep */
+  double *max_change;         /* Per-thread maximum utility change */
+  unsigned long *eu_count;    /* Per-thread expected utilities computed */
+} lazy_sweep_arg;
+
+/*  Procedure
+ *    lazy_backup
+ *
+ *  Purpose
+ *    Apply the Bellman update to one state of a lazy MDP
+ *
+ *  Produces
+ *   utility, a double
+ *
+ *  Postconditions
+ *    utility = R(state) for terminal states, and
+ *    R(state) + gamma * MEU(state) otherwise
+ */
+static double lazy_backup( lazy_cache* p_cache, unsigned int state,
+			   const double* utilities, double gamma )
+{
+  const lazy_state *p_state = lazy_cache_get(p_cache, state);
+  double reward = p_state->reward, meu;
+  unsigned int action;
+
+  if (p_state->terminal)
+    return reward;
+
+  lazy_calc_meu(p_cache, state, utilities, &meu, &action);
+
+  return reward + gamma * meu;
+}
+
+/* Update one thread's share of the states, as value_sweep does */
+static void lazy_sweep( void* p_arg, unsigned int thread,
+			unsigned int numThreads )
+{
+  lazy_sweep_arg *p_sweep = p_arg;
+  double max_utilities_change, utilities_change;
+  unsigned int state, first, last;
+
+  unsigned long eu_start = calc_eu_count();
+
+  thread_pool_range(p_sweep->numStates, thread, numThreads, &first, &last);
+
+  max_utilities_change = 0;
+
+  for ( state = first; state < last ; state++ )
+  {
+    p_sweep->updated_utilities[state] = 
+      lazy_backup(p_sweep->caches[thread], state, p_sweep->utilities,
+		  p_sweep->gamma);
+
+    utilities_change = fabs(p_sweep->updated_utilities[state] - 
+			    p_sweep->utilities[state]);
+
+    if (utilities_change > max_utilities_change)
+      max_utilities_change = utilities_change;
+  }
+
+  p_sweep->max_change[thread] = max_utilities_change;
+  p_sweep->eu_count[thread] = calc_eu_count() - eu_start;
+}
+
+/*  Procedure
+ *    lazy_value_iteration
+ *
+ *  Purpose
+ *    Estimate utilities of an MDP whose transitions are generated on
+ *    demand
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_lazy
+ *   cacheStates
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   mode
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_lazy points to a valid lazy_mdp
+ *    utilities points to a valid array of length p_lazy->numStates
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    p_ctx is NULL or a context not in use by another solver
+ *
+ *  Postconditions
+ *    utilities[s] contains the estimated utility value for the given
+ *    state, identical to what value_iteration computes for the same
+ *    model stored as an mdp. SWEEP_JACOBI sweeps are split over the
+ *    threads of p_ctx; every other mode runs SWEEP_GAUSS_SEIDEL in the
+ *    caller. Transitions are regenerated as each state is updated, so
+ *    only the utilities grow with the number of states.
+ *    Each thread keeps the cacheStates/threads states it used most
+ *    recently (see lazy_cache_create). Sweeps visit their states in a
+ *    cycle, so the cache only saves work when it holds all of them.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    sweep, given the largest utility change in it.
+ *    Any failure causes program exit.
+ */
+unsigned long lazy_value_iteration( solver_context* p_ctx,
+				    const lazy_mdp* p_lazy,
+				    unsigned int cacheStates, double epsilon,
+				    double gamma, double *utilities,
+				    sweep_mode mode, solver_observer observer,
+				    void* observer_arg )
+{
+  double *updated_utilities, max_utilities_change, utilities_change, updated;
+  double threshold = epsilon * (1 - gamma) / gamma;
+  unsigned int num_states, num_threads, thread, state;
+  unsigned long backups, eu_count;
+  size_t utilities_size;
+  lazy_sweep_arg sweep;
+  solver_monitor monitor;
+  solver_context *p_owned = NULL;
+
+  if (NULL == p_ctx)
+    p_ctx = p_owned = solver_context_create(1);
+
+  num_states = p_lazy->numStates;
+  num_threads = thread_pool_size(p_ctx->p_pool);
+  utilities_size = sizeof(double) * num_states;
+
+  lazy_cache *caches[num_threads];
+
+  for ( thread = 0 ; thread < num_threads ; thread++ )
+    caches[thread] = lazy_cache_create(p_lazy, (cacheStates + num_threads - 1)
+				       / num_threads);
+
+  monitor_start(&monitor, observer, observer_arg);
+
+  backups = 0;
+  bzero(utilities, utilities_size);
+
+  if (SWEEP_JACOBI != mode)
+  { // In place, in state order, as sweep_gauss_seidel does
+    do
+    {
+      max_utilities_change = 0;
+
+      for ( state = 0 ; state < num_states ; state++ )
+      {
+	updated = lazy_backup(caches[0], state, utilities, gamma);
+
+	utilities_change = fabs(updated - utilities[state]);
+	utilities[state] = updated;
+
+	if (utilities_change > max_utilities_change)
+	  max_utilities_change = utilities_change;
+      }
+
+      backups += num_states;
+      monitor_report(&monitor, max_utilities_change, backups, 0, 0);
+
+    } while (max_utilities_change > threshold);
+  }
+  else
+  {
+    // Not from p_ctx, whose scratch would add several arrays of this size
+    updated_utilities = calloc(num_states ? num_states : 1, sizeof(double));
+
+    if (NULL == updated_utilities)
+    {
+      fprintf(stderr,"lazy_value_iteration failed: %s (%s)\n",
+	      "Could not allocate utilities", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    eu_count = 0;
+
+    sweep.gamma = gamma;
+    sweep.numStates = num_states;
+    sweep.caches = caches;
+    sweep.utilities = utilities;
+    sweep.updated_utilities = updated_utilities;
+    sweep.max_change = p_ctx->max_change;
+    sweep.eu_count = p_ctx->eu_count;
+
+    do 
+    {
+      memcpy(utilities, updated_utilities, utilities_size);
+
+      thread_pool_run(p_ctx->p_pool, lazy_sweep, &sweep);
+      backups += num_states;
+
+      // Reduce the per-thread changes
+      max_utilities_change = 0;
+
+      for ( thread = 0 ; thread < num_threads ; thread++ )
+      {
+	if (p_ctx->max_change[thread] > max_utilities_change)
+	  max_utilities_change = p_ctx->max_change[thread];
+
+	eu_count += p_ctx->eu_count[thread];
+      }
+
+      monitor_report(&monitor, max_utilities_change, backups, eu_count, 0);
+
+    } while(!(max_utilities_change < threshold));
+
+    free(updated_utilities);
+  }
+
+  // Clean up
+  for ( thread = 0 ; thread < num_threads ; thread++ )
+    lazy_cache_free(caches[thread]);
+
+  solver_context_free(p_owned);
+
+  return backups;
+}
+
+/*  Procedure
+ *    policy_iteration
+ *
+ *  Purpose
+ *    Optimize policy by alternating evaluation and improvement steps
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   policy
+ *   mode
+ *   sweeps
+ *   exact
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_ctx is NULL or a context not in use by another solver
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    policy points to a valid array of length p_mdp->numStates
+ *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
+ *       and policy[s] is an entry in p_mdp->actions[s]
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *
+ *  Postconditions
+ *    When sweeps is 0, each policy is evaluated until no update exceeds
+ *    epsilon, and iteration stops once improvement leaves it unchanged.
+ *    If exact is nonzero, that evaluation instead solves the linear
+ *    system for the policy's utilities (policy_evaluation_exact).
+ *    Otherwise (modified policy iteration) each improvement step also
+ *    applies the full Bellman update, which is followed by sweeps
+ *    evaluation sweeps under the improved policy; iteration stops once
+ *    that update changes no utility by epsilon*(1-gamma)/gamma or more,
+ *    as in value iteration.
+ *    policy[s] contains the optimal policy for the given mdp
+ *    Each iterative policy evaluation orders its updates according to mode
+ *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
+ *       and policy[s] is an entry in p_mdp->actions[s]
+ *    backups is the number of single-state updates performed, counting
+ *    each improvement step as one update per state
+ *    Improvement steps and Jacobi evaluation sweeps are split over the
+ *    threads of p_ctx; the policy, utilities and statistics do not
+ *    depend on the number of threads.
+ *    Scratch space comes from p_ctx, which grows as needed; when p_ctx
+ *    is NULL a temporary context is used.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    improvement step, given the Bellman residual of the utilities that
+ *    step improved upon and the number of policy changes it made.
+ *
+ *  Authors
+ *    Jerod Weinman (documentation & skeleton)
+ *    Daniel NP & Tyler D (implementation)
+ */			
+unsigned long policy_iteration( solver_context* p_ctx, const mdp* p_mdp,
+				double epsilon, double gamma,
+				unsigned int *policy, sweep_mode mode,
+				unsigned int sweeps, int exact,
+				solver_observer observer, void* observer_arg)
+{
+  double *utilities, *updated_utilities, *swap;
+  double residual;
+
+  unsigned int num_states, utilities_size, changes;
+  unsigned long backups;
+  solver_monitor monitor;
+  solver_context *p_owned = NULL;
+
+  if (NULL == p_ctx)
+    p_ctx = p_owned = solver_context_create(1);
+
+  num_states = p_mdp->numStates;
+  utilities_size = sizeof(double) * num_states;
+
+  solver_context_reserve(p_ctx, num_states, p_mdp->numActions);
+
+  // Every evaluation shares the structure found for this model
+  sweep_graph_clear(p_ctx->p_graph);
+
+  utilities = p_ctx->utilities;
+  bzero(utilities, utilities_size);
+
+  backups = 0;
+
+  monitor_start(&monitor, observer, observer_arg);
+
+  if (0 == sweeps)
+  {
+    do {
+      // evaluate our current policy, storing the updated utilities
+      // in utilities
+      if (exact)
+	backups += policy_evaluation_exact(policy, p_mdp, epsilon, gamma,
+					   utilities, p_ctx->work);
+      else
+	backups += policy_evaluation(policy, p_mdp, epsilon, gamma, utilities,
+				     mode, p_ctx->work, p_ctx->p_graph,
+				     p_ctx->p_pool);
+
+      changes = policy_improvement(p_ctx, p_mdp, gamma, utilities, NULL,
+				   policy, &residual);
+      backups += num_states;
+
+      monitor_report(&monitor, residual, backups, 0, changes);
+
+    } while (changes);
+  }
+  else
+  {
+    updated_utilities = p_ctx->updated_utilities;
+
+    while (1)
+    {
+      changes = policy_improvement(p_ctx, p_mdp, gamma, utilities, 
+				   updated_utilities, policy, &residual);
+      backups += num_states;
+
+      monitor_report(&monitor, residual, backups, 0, changes);
+
+      swap = utilities;
+      utilities = updated_utilities;
+      updated_utilities = swap;
+
+      if (residual < epsilon * (1 - gamma) / gamma)
+	break;
+
+      // partially evaluate the improved policy
+      backups += policy_evaluation_sweeps(policy, p_mdp, gamma, utilities,
+					  sweeps, mode, p_ctx->work,
+					  p_ctx->p_pool);
+    }
+  }
+
+  // Clean up
+  solver_context_free(p_owned);
+
+  return backups;
+}
+
+// Seed of the successors sampled by lrtdp's trials
+#define LRTDP_SEED 0x5DEECE66DULL
+
+// Marks a state lrtdp's label check has not reached
+#define LRTDP_NONE ((unsigned int)-1)
+
+/* State shared by the trials and label checks of one lrtdp run */
+typedef struct {
+  const mdp* p_mdp;
+  double gamma;
+  double threshold;           /* Largest residual of a solved state */
+  double *utilities;
+  unsigned char *solved;      /* Whether each state is labeled solved */
+  unsigned int *mark;         /* Label check that last reached each state */
+  unsigned int *open;         /* States a label check has yet to expand */
+  unsigned int *closed;       /* States a label check has expanded */
+  unsigned int numSolved;
+  unsigned long backups;
+} lrtdp_run;
+
+/*  Procedure
+ *    lrtdp_backup
+ *
+ *  Purpose
+ *    Compute a state's Bellman update and greedy action
+ *
+ *  Produces
+ *   utility, a double
+ *
+ *  Postconditions
+ *    utility = R(state) for terminal states, and
+ *    R(state) + gamma * MEU(state) otherwise; *p_action is the action
+ *    that attains it (0 when none is available). utilities is unchanged.
+ */
+static double lrtdp_backup( lrtdp_run* p_run, unsigned int state,
+			    unsigned int* p_action )
+{
+  const mdp *p_mdp = p_run->p_mdp;
+  double meu;
+
+  *p_action = 0;
+
+  if (p_mdp->terminal[state])
+    return p_mdp->rewards[state];
+
+  calc_meu(p_mdp, state, p_run->utilities, &meu, p_action);
+
+  return p_mdp->rewards[state] + p_run->gamma * meu;
+}
+
+/*  Procedure
+ *    lrtdp_check
+ *
+ *  Purpose
+ *    Label a state solved when its greedy envelope has converged
+ *
+ *  Produces
+ *   solved, an int
+ *
+ *  Postconditions
+ *    Unsolved states the greedy policy reaches from state are visited
+ *    depth first, not expanding past one whose residual exceeds the
+ *    threshold, nor past terminal or action-less states. When none does, solved is nonzero and every visited
+ *    state is labeled solved; otherwise the visited states are updated
+ *    in reverse order. epoch distinguishes this check's marks.
+ */
+static int lrtdp_check( lrtdp_run* p_run, unsigned int state,
+			unsigned int epoch )
+{
+  const mdp *p_mdp = p_run->p_mdp;
+  unsigned int num_open = 0, num_closed = 0, action, i, row, successor;
+  double updated;
+  int converged = 1;
+
+  if (p_run->solved[state])
+    return 1;
+
+  p_run->mark[state] = epoch;
+  p_run->open[num_open++] = state;
+
+  while (num_open > 0)
+  {
+    state = p_run->open[--num_open];
+    p_run->closed[num_closed++] = state;
+
+    updated = lrtdp_backup(p_run, state, &action);
+    p_run->backups++;
+
+    if (fabs(updated - p_run->utilities[state]) > p_run->threshold)
+    {
+      converged = 0;
+      continue;
+    }
+
+    // Terminal and action-less states lead nowhere
+    if (p_mdp->terminal[state] || 0 == p_mdp->numAvailableActions[state])
+      continue;
+
+    row = state * p_mdp->numActions + action;
+
+    for (i = p_mdp->transitionStart[row] ; 
+	 i < p_mdp->transitionStart[row + 1] ; i++)
+    {
+      successor = p_mdp->successor[i];
+
+      if (!p_run->solved[successor] && p_run->mark[successor] != epoch)
+      {
+	p_run->mark[successor] = epoch;
+	p_run->open[num_open++] = successor;
+      }
+    }
+  }
+
+  if (converged)
+  {
+    for (i = 0 ; i < num_closed ; i++)
+      p_run->solved[p_run->closed[i]] = 1;
+
+    p_run->numSolved += num_closed;
+  }
+  else
+    while (num_closed > 0)
+    {
+      state = p_run->closed[--num_closed];
+      p_run->utilities[state] = lrtdp_backup(p_run, state, &action);
+      p_run->backups++;
+    }
+
+  return converged;
+}
+
+/*  Procedure
+ *    lrtdp_levels
+ *
+ *  Purpose
+ *    Find how many steps each state is from leaving the model
+ *
+ *  Produces
+ *   reached, an unsigned int
+ *
+ *  Postconditions
+ *    level[s] is 0 for terminal states, for states without actions and
+ *    for states with an action whose row sums below one (where a
+ *    trajectory may end), and otherwise one more than the least level
+ *    of any successor of any action; LRTDP_NONE when no such state is
+ *    reachable. queue (of length numStates) begins with the reached
+ *    states in order of level, and reached is their number.
+ */
+static unsigned int lrtdp_levels( const mdp* p_mdp, unsigned int* level,
+				  unsigned int* queue )
+{
+  unsigned int *predecessor_start, *predecessor;
+  unsigned int state, action, head = 0, tail = 0, i, j;
+  double sum;
+
+  mdp_predecessors(p_mdp, &predecessor_start, &predecessor);
+
+  for (state = 0 ; state < p_mdp->numStates ; state++)
+  {
+    level[state] = LRTDP_NONE;
+
+    if (p_mdp->terminal[state] || 0 == p_mdp->numAvailableActions[state])
+      level[state] = 0;
+
+    for (i = 0 ; i < p_mdp->numAvailableActions[state] && level[state] ; i++)
+    {
+      action = p_mdp->actions[state][i];
+      sum = 0;
+
+      for (j = p_mdp->transitionStart[state * p_mdp->numActions + action] ;
+	   j < p_mdp->transitionStart[state * p_mdp->numActions + action + 1] ;
+	   j++)
+	sum += p_mdp->transitionProb[j];
+
+      if (sum < 1 - MDP_ROW_SLACK)
+	level[state] = 0;
+    }
+
+    if (0 == level[state])
+      queue[tail++] = state;
+  }
+
+  // Breadth first from the exits, backward along transitions
+  while (head < tail)
+  {
+    state = queue[head++];
+
+    for (i = predecessor_start[state] ; i < predecessor_start[state + 1] ; i++)
+      if (LRTDP_NONE == level[predecessor[i]])
+      {
+	level[predecessor[i]] = level[state] + 1;
+	queue[tail++] = predecessor[i];
+      }
+  }
+
+  free(predecessor_start);
+  free(predecessor);
+
+  return tail;
+}
+
+/*  Procedure
+ *    lrtdp
+ *
+ *  Purpose
+ *    Find a policy for the states reachable from the start, with labeled
+ *    real-time dynamic programming
+ *
+ *  Parameters
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   policy
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp whose transition rows
+ *      each sum to at most one
+ *    utilities and policy point to valid arrays of length
+ *      p_mdp->numStates
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *
+ *  Postconditions
+ *    Utilities start from an admissible (never too low) heuristic:
+ *    R(s) for terminal states and R(s) + gamma * H otherwise, where H
+ *    bounds every utility from the largest rewards. When every
+ *    nonterminal reward is negative, H also counts the least number of
+ *    such rewards collected before a trajectory can reach a terminal
+ *    state or end, found by one backward pass over the transitions.
+ *    Trials follow the greedy policy from p_mdp->start, sampling
+ *    successors from a fixed seed, and update each state they visit. A
+ *    trial stops at a terminal or solved state, or after as many steps
+ *    as it takes gamma's powers to fall below epsilon*(1-gamma)/gamma.
+ *    Walking back, a state is labeled solved once every state its
+ *    greedy policy can reach has a residual below that threshold. This
+ *    repeats until the start is solved (Bonet and Geffner, 2003).
+ *    policy[s] is the greedy action of every state the resulting
+ *    policy reaches from the start; other entries are unchanged.
+ *    utilities[s] is within the tolerance of value_iteration for those
+ *    states, and remains an upper bound for the rest.
+ *    Only states the trials and label checks reach are updated, so on
+ *    large models whose start leads to a small region this is much
+ *    faster than solving every state.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg after the
+ *    trial that brings the updates past each multiple of numStates, and
+ *    at the end, given the start's residual and the number of states
+ *    labeled solved so far (as changes).
+ *    Any failure causes program exit.
+ */
+unsigned long lrtdp( const mdp* p_mdp, double epsilon, double gamma,
+		     double* utilities, unsigned int* policy,
+		     solver_observer observer, void* observer_arg )
+{
+  unsigned int num_states, state, action, depth, max_depth, i, row, epoch;
+  unsigned int reached, *visited, *block;
+  unsigned long long seed = LRTDP_SEED;
+  unsigned long reported = 0;
+  double max_reward_terminal, max_reward, bound, draw, threshold, steps;
+  lrtdp_run run;
+  solver_monitor monitor;
+
+  num_states = p_mdp->numStates;
+  threshold = epsilon * (1 - gamma) / gamma;
+
+  // Beyond this many steps, a trial's updates barely reach the start
+  for (max_depth = 1, steps = gamma ; steps > threshold ; max_depth++)
+    steps *= gamma;
+
+  block = malloc(sizeof(unsigned int) * (3 * (size_t)num_states + max_depth));
+  run.solved = calloc(num_states ? num_states : 1, 1);
+
+  if (NULL == block || NULL == run.solved)
+  {
+    fprintf(stderr,"lrtdp failed: %s (%s)\n",
+	    "Could not allocate search state", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  run.mark = block;
+  run.open = block + num_states;
+  run.closed = block + 2 * (size_t)num_states;
+  visited = block + 3 * (size_t)num_states;
+
+  // No utility exceeds the largest terminal reward, the largest other
+  // reward earned forever, or zero (an action-less state's expectation)
+  max_reward_terminal = max_reward = -INFINITY;
+
+  for (state = 0 ; state < num_states ; state++)
+  {
+    if (p_mdp->terminal[state])
+    {
+      if (p_mdp->rewards[state] > max_reward_terminal)
+	max_reward_terminal = p_mdp->rewards[state];
+    }
+    else if (p_mdp->rewards[state] > max_reward)
+      max_reward = p_mdp->rewards[state];
+  }
+
+  bound = max_reward / (1 - gamma);
+
+  if (max_reward_terminal > bound)
+    bound = max_reward_terminal;
+
+  if (bound < 0)
+    bound = 0;
+
+  for (state = 0 ; state < num_states ; state++)
+    utilities[state] = p_mdp->terminal[state] ? p_mdp->rewards[state] :
+      p_mdp->rewards[state] + gamma * bound;
+
+  // When every step costs, a state d steps from any exit can earn at
+  // most bound after paying the largest reward d times
+  if (max_reward < 0)
+  {
+    reached = lrtdp_levels(p_mdp, run.mark, run.open);
+
+    for (state = 0 ; state < num_states ; state++)
+      if (LRTDP_NONE == run.mark[state])
+	utilities[state] = p_mdp->rewards[state] + 
+	  gamma * max_reward / (1 - gamma);
+
+    // States come in order of level; steps bounds the utility one less
+    for (i = 0, depth = 1, steps = bound ; i < reached ; i++)
+    {
+      state = run.open[i];
+
+      for ( ; depth < run.mark[state] ; depth++)
+	steps = max_reward + gamma * steps;
+
+      if (run.mark[state] > 0)
+	utilities[state] = p_mdp->rewards[state] + gamma * steps;
+    }
+  }
+
+  for (state = 0 ; state < num_states ; state++)
+    run.mark[state] = LRTDP_NONE;
+
+  run.p_mdp = p_mdp;
+  run.gamma = gamma;
+  run.threshold = threshold;
+  run.utilities = utilities;
+  run.numSolved = 0;
+  run.backups = 0;
+
+  monitor_start(&monitor, observer, observer_arg);
+
+  epoch = 0;
+
+  while (!run.solved[p_mdp->start])
+  {
+    // Follow the greedy policy from the start, updating as we go
+    state = p_mdp->start;
+    depth = 0;
+
+    while (!run.solved[state])
+    {
+      visited[depth++] = state;
+      utilities[state] = lrtdp_backup(&run, state, &action);
+      run.backups++;
+
+      if (p_mdp->terminal[state] || 0 == p_mdp->numAvailableActions[state] ||
+	  depth == max_depth)
+	break;
+
+      // Sample a successor; a row summing below one may end the trial
+      row = state * p_mdp->numActions + action;
+      draw = random_uniform(&seed);
+
+      for (i = p_mdp->transitionStart[row] ; 
+	   i < p_mdp->transitionStart[row + 1] && 
+	     draw >= p_mdp->transitionProb[i] ; i++)
+	draw -= p_mdp->transitionProb[i];
+
+      if (i == p_mdp->transitionStart[row + 1])
+	break;
+
+      state = p_mdp->successor[i];
+    }
+
+    // Label the visited states, latest first, until one is unconverged
+    while (depth > 0)
+      if (!lrtdp_check(&run, visited[--depth], epoch++))
+	break;
+
+    if (NULL != observer && run.backups - reported >= num_states)
+    {
+      monitor_report(&monitor, fabs(lrtdp_backup(&run, p_mdp->start, &action)
+				    - utilities[p_mdp->start]),
+		     run.backups, 0, run.numSolved);
+      reported = run.backups;
+    }
+  }
+
+  // Record the greedy action of every state the policy reaches
+  epoch++;
+  run.mark[p_mdp->start] = epoch;
+  run.open[0] = p_mdp->start;
+  depth = 1;
+
+  while (depth > 0)
+  {
+    state = run.open[--depth];
+    lrtdp_backup(&run, state, &action);
+    policy[state] = action;
+
+    if (p_mdp->terminal[state] || 0 == p_mdp->numAvailableActions[state])
+      continue;
+
+    row = state * p_mdp->numActions + action;
+
+    for (i = p_mdp->transitionStart[row] ; 
+	 i < p_mdp->transitionStart[row + 1] ; i++)
+      if (run.mark[p_mdp->successor[i]] != epoch)
+      {
+	run.mark[p_mdp->successor[i]] = epoch;
+	run.open[depth++] = p_mdp->successor[i];
+      }
+  }
+
+  if (NULL != observer)
+    monitor_report(&monitor, fabs(lrtdp_backup(&run, p_mdp->start, &action)
+				  - utilities[p_mdp->start]),
+		   run.backups, 0, run.numSolved);
+
+  free(block);
+  free(run.solved);
+
+  return run.backups;
+}
+
+/*  Procedure
+ *    randomize_policy
+ *
+ *  Purpose
+ *    Initialize policy to random actions
+ *
+ *  Parameters
+ *   p_mdp
+ *   policy
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    policy points to a valid array of length p_mdp->numStates
+ *
+ *  Postconditions
+ *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
+ *       and policy[s] is an entry in p_mdp->actions[s]
+ *    when p_mdp->numAvailableActions[s] > 0.
+ */
+void randomize_policy( const mdp* p_mdp, unsigned int* policy)
+{
+  srandom(42);
+  unsigned int state;
+  unsigned int action;
+
+  for ( state=0 ; state < p_mdp->numStates ; state++)
+  {
+    if (p_mdp->numAvailableActions[state] > 0)
+    {
+      action = (unsigned int)(random() % (p_mdp->numAvailableActions[state]));
+      policy[state] = p_mdp->actions[state][action];
+    }
+  }
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void solver_print_stats( const solver_stats* p_stats, void* stream )
+{
+  if (1 == p_stats->iteration)
+    fprintf(stream, "%9s %12s %10s %12s %12s %8s\n", "iteration",
+	    "residual", "seconds", "backups", "eu", "changes");
+
+  fprintf(stream, "%9lu %12.6g %10.6f %12lu %12lu %8u\n",
+	  p_stats->iteration, p_stats->residual, p_stats->seconds,
+	  p_stats->backups, p_stats->eu_count, p_stats->changes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+solver_context* solver_context_create( unsigned int numThreads )
+{
+  solver_context *p_ctx;
+
+  p_ctx = malloc(sizeof(solver_context));
+
+  if (NULL == p_ctx)
+  {
+    fprintf(stderr,"solver_context_create failed: %s (%s)\n",
+	    "Could not allocate context", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  // Workers share the kernel choice, so make it before any of them run
+  calc_init_kernel();
+
+  p_ctx->p_pool = (numThreads > 1) ? thread_pool_create(numThreads) : NULL;
+  p_ctx->capacity = 0;
+  p_ctx->utilities = NULL;
+  p_ctx->updated_utilities = NULL;
+  p_ctx->work = NULL;
+  p_ctx->batch = NULL;
+  p_ctx->batchCapacity = 0;
+  p_ctx->eu = NULL;
+  p_ctx->actionCapacity = 0;
+  p_ctx->p_graph = sweep_graph_create();
+
+  numThreads = thread_pool_size(p_ctx->p_pool);
+
+  p_ctx->max_change = malloc(sizeof(double) * numThreads);
+  p_ctx->eu_count = malloc(sizeof(unsigned long) * numThreads);
+  p_ctx->changes = malloc(sizeof(unsigned int) * numThreads);
+
+  if (NULL == p_ctx->max_change || NULL == p_ctx->eu_count ||
+      NULL == p_ctx->changes)
+  {
+    fprintf(stderr,"solver_context_create failed: %s (%s)\n",
+	    "Could not allocate per-thread results", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  return p_ctx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void solver_context_reserve( solver_context* p_ctx, unsigned int numStates,
+			     unsigned int numActions )
+{
+  size_t capacity;
+  void *block;
+  int status;
+
+  if (numActions > p_ctx->actionCapacity)
+  {
+    capacity = ((size_t)numActions + CONTEXT_ALIGN - 1) / CONTEXT_ALIGN *
+      CONTEXT_ALIGN;
+
+    // Whole cache lines per thread, so workers never share one
+    status = posix_memalign(&block, CONTEXT_ALIGN * sizeof(double),
+			    thread_pool_size(p_ctx->p_pool) * capacity *
+			    sizeof(double));
+
+    if (0 != status)
+    {
+      fprintf(stderr,"solver_context_reserve failed: %s (%s)\n",
+	      "Could not allocate expected utilities", strerror(status));
+      exit(EXIT_FAILURE);
+    }
+
+    free(p_ctx->eu);
+
+    p_ctx->eu = block;
+    p_ctx->actionCapacity = capacity;
+  }
+
+  if (numStates <= p_ctx->capacity)
+    return;
+
+  capacity = (numStates + CONTEXT_ALIGN - 1) / CONTEXT_ALIGN * CONTEXT_ALIGN;
+
+  // One block: utilities, updated utilities, then six evaluation vectors
+  status = posix_memalign(&block, CONTEXT_ALIGN * sizeof(double),
+			  8 * capacity * sizeof(double));
+
+  if (0 != status)
+  {
+    fprintf(stderr,"solver_context_reserve failed: %s (%s)\n",
+	    "Could not allocate scratch utilities", strerror(status));
+    exit(EXIT_FAILURE);
+  }
+
+  free(p_ctx->utilities);
+
+  p_ctx->capacity = capacity;
+  p_ctx->utilities = block;
+  p_ctx->updated_utilities = p_ctx->utilities + capacity;
+  p_ctx->work = p_ctx->updated_utilities + capacity;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void solver_context_free( solver_context* p_ctx )
+{
+  if (NULL == p_ctx)
+    return;
+
+  thread_pool_free(p_ctx->p_pool);
+  free(p_ctx->utilities);
+  free(p_ctx->batch);
+  free(p_ctx->eu);
+  sweep_graph_free(p_ctx->p_graph);
+  free(p_ctx->max_change);
+  free(p_ctx->eu_count);
+  free(p_ctx->changes);
+  free(p_ctx);
+}
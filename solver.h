@@ -0,0 +1,541 @@
+/* solver.h
+ *
+ * Declarations for the value iteration and policy iteration solvers.
+ *
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "mdp.h"
+#include "lazy.h"
+#include "sweep.h"
+#include "thread_pool.h"
+
+/* Progress of a solver at the end of one iteration */
+typedef struct {
+  unsigned long iteration;  /* Iterations completed, counting from 1 */
+  double residual;          /* Largest utility change in the iteration */
+  double seconds;           /* Wall time since the solver started */
+  unsigned long backups;    /* Single-state updates so far */
+  unsigned long eu_count;   /* Expected utilities computed so far */
+  unsigned int changes;     /* Policy entries changed (policy iteration),
+			       actions eliminated or states solved */
+} solver_stats;
+
+/* Called by a solver after each iteration; arg is passed through */
+typedef void (*solver_observer)( const solver_stats* p_stats, void* arg );
+
+/* Threads and scratch space reused across solver calls */
+typedef struct {
+  thread_pool *p_pool;        /* Threads for Jacobi sweeps, or NULL */
+  unsigned int capacity;      /* States each scratch array can hold */
+  double *utilities;          /* Policy iteration's utilities */
+  double *updated_utilities;  /* Utilities of the next sweep */
+  double *work;               /* 6*capacity doubles for policy evaluation */
+  double *max_change;         /* Per-thread maximum utility change */
+  unsigned long *eu_count;    /* Per-thread expected utilities computed */
+  unsigned int *changes;      /* Per-thread policy changes */
+  double *batch;              /* Scratch for value_iteration_batch */
+  size_t batchCapacity;       /* Doubles batch can hold */
+  double *eu;                 /* Per-thread expected utilities of a state */
+  unsigned int actionCapacity;/* Actions each thread's share of eu holds */
+  sweep_graph *p_graph;       /* Structure of the model being solved, found
+				 at most once per solver call */
+} solver_context;
+
+/*  Procedure
+ *    solver_context_create
+ *
+ *  Purpose
+ *    Allocate a context for running solvers
+ *
+ *  Parameters
+ *   numThreads
+ *
+ *  Produces,
+ *   p_ctx, a solver_context*
+ *
+ *  Preconditions
+ *    numThreads > 0
+ *
+ *  Postconditions
+ *    p_ctx splits Jacobi sweeps over numThreads threads (including the
+ *    caller). Its scratch arrays are empty until the first solver call,
+ *    and are then kept, so solving many MDPs of similar size through one
+ *    context does not allocate. The expected-utility kernel is chosen
+ *    (see calc_init_kernel) before the threads start.
+ *    Any failure causes program exit.
+ */
+solver_context* solver_context_create( unsigned int numThreads );
+
+/*  Procedure
+ *    solver_context_reserve
+ *
+ *  Purpose
+ *    Ensure a context's scratch arrays hold a number of states and actions
+ *
+ *  Parameters
+ *   p_ctx
+ *   numStates
+ *   numActions
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    p_ctx->capacity >= numStates and p_ctx->actionCapacity >= numActions;
+ *    thread t of p_ctx owns p_ctx->eu[t*actionCapacity] up to (but
+ *    excluding) p_ctx->eu[(t+1)*actionCapacity]. Scratch arrays start on
+ *    cache-line boundaries; their contents are undefined after they grow.
+ *    Any failure causes program exit.
+ */
+void solver_context_reserve( solver_context* p_ctx, unsigned int numStates,
+			     unsigned int numActions );
+
+/*  Procedure
+ *    solver_context_free
+ *
+ *  Purpose
+ *    Release a context and its threads
+ *
+ *  Parameters
+ *   p_ctx
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    All memory and threads of p_ctx are released; NULL is ignored
+ */
+void solver_context_free( solver_context* p_ctx );
+
+/*  Procedure
+ *    value_iteration
+ *
+ *  Purpose
+ *    Estimate utilities with iterative updates
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   mode
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    p_ctx is NULL or a context not in use by another solver
+ *
+ *  Postconditions
+ *    utilities[s] contains the estimated utility value for the given state
+ *    Updates are ordered according to mode. SWEEP_JACOBI sweeps are split
+ *    over the threads of p_ctx (the caller alone when NULL); results do
+ *    not depend on the number of threads. SWEEP_ASYNC has the threads
+ *    claim blocks of states and update them in place, stealing blocks
+ *    from each other, and stops revisiting blocks whose neighborhood
+ *    has settled; its results vary within the tolerance from run to
+ *    run. SWEEP_TOPOLOGICAL solves the strongly connected components of
+ *    the transition graph successors first, splitting components that
+ *    cannot reach each other over the threads; its results do not
+ *    depend on the number of threads. Other modes run in the caller.
+ *    Scratch space comes from p_ctx, which grows as needed; when p_ctx
+ *    is NULL a temporary context is used.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    sweep (for the prioritized order, every numStates updates and at
+ *    the end), given the largest utility change in it.
+ *
+ *  Authors
+ *    Daniel Nanetti-Palacios
+ *    Tyler Dewey
+ *
+ * Documentation adapted from Jerod Weinman's policy_iteration.c
+ */ 
+unsigned long value_iteration( solver_context* p_ctx, const mdp* p_mdp,
+			       double epsilon, double gamma,
+			       double *utilities, sweep_mode mode,
+			       solver_observer observer, void* observer_arg);
+
+/*  Procedure
+ *    value_iteration_resume
+ *
+ *  Purpose
+ *    Update utilities from an earlier solution after the model changed
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   changed
+ *   numChanged
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    utilities points to a valid array of length p_mdp->numStates
+ *      holding a starting estimate, e.g., from mdp_read_utilities
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    changed is NULL or points to numChanged states
+ *    p_ctx is NULL or a context not in use by another solver
+ *
+ *  Postconditions
+ *    utilities[s] contains the estimated utility value for the given
+ *    state, to the same tolerance as value_iteration.
+ *    Updates are made in prioritized order starting from the given
+ *    utilities. When changed is NULL every state is checked first (a
+ *    warm start). Otherwise utilities must have converged for p_mdp
+ *    before the rewards, terminal flags or transition rows of the
+ *    changed states were edited, and only those states and their
+ *    predecessors are checked first, so the updates needed grow with
+ *    the effect of the edit rather than with the size of p_mdp.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg every
+ *    numStates updates and at the end.
+ *    The prioritized order runs in the caller; the predecessors it needs
+ *    are kept in p_ctx (see value_iteration), or in a temporary context
+ *    when p_ctx is NULL.
+ */
+unsigned long value_iteration_resume( solver_context* p_ctx,
+				      const mdp* p_mdp, double epsilon,
+				      double gamma, double* utilities,
+				      const unsigned int* changed,
+				      unsigned int numChanged,
+				      solver_observer observer,
+				      void* observer_arg );
+
+/*  Procedure
+ *    value_iteration_eliminate
+ *
+ *  Purpose
+ *    Estimate utilities with Jacobi sweeps that permanently eliminate
+ *    actions proven suboptimal by bounds on the utilities
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp whose transition rows
+ *      each sum to at most one
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    p_ctx is NULL or a context not in use by another solver
+ *
+ *  Postconditions
+ *    utilities[s] contains the estimated utility value for the given
+ *    state, to the same tolerance as a SWEEP_JACOBI value_iteration.
+ *    After each sweep, the smallest and largest changes bound the true
+ *    utilities (MacQueen's bounds, widened to include zero because
+ *    terminal utilities do not move), and in the next sweep an action
+ *    whose expected utility under the upper bound falls below the best
+ *    under the lower bound is dropped from its state for good. Optimal
+ *    actions are never dropped, so sweeps compute fewer expected
+ *    utilities as the bounds tighten. Sweeps are split over the threads
+ *    of p_ctx; results do not depend on the number of threads.
+ *    Scratch space comes from p_ctx, which grows as needed; when p_ctx
+ *    is NULL a temporary context is used.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    sweep, given the largest utility change and the number of actions
+ *    eliminated in it (as changes).
+ */
+unsigned long value_iteration_eliminate( solver_context* p_ctx,
+					 const mdp* p_mdp, double epsilon,
+					 double gamma, double *utilities,
+					 solver_observer observer,
+					 void* observer_arg );
+
+/*  Procedure
+ *    value_iteration_batch
+ *
+ *  Purpose
+ *    Estimate utilities for several discounts and reward vectors of one
+ *    transition model at once
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   count
+ *   gammas
+ *   rewards
+ *   epsilon
+ *   utilities
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_ctx is NULL or a context not in use by another solver
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    count > 0
+ *    gammas points to count discounts, each 0 < gammas[k] < 1
+ *    rewards is NULL or points to count reward vectors of length
+ *      p_mdp->numStates, vector k starting at rewards[k*numStates]
+ *    epsilon > 0
+ *    utilities points to a valid array of p_mdp->numStates * count
+ *
+ *  Postconditions
+ *    utilities[s*count + k] is the utility of state s for problem k,
+ *    which discounts by gammas[k] and takes its rewards from vector k
+ *    (or from p_mdp when rewards is NULL). Each problem is identical to
+ *    a SWEEP_JACOBI value_iteration; it stops being updated once it
+ *    converges, while every sweep reads each transition once for all
+ *    unconverged problems. Sweeps are split over the threads of p_ctx.
+ *    backups is the number of single-state Bellman updates performed,
+ *    summed over the problems.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    sweep, given the largest utility change among unconverged problems.
+ */
+unsigned long value_iteration_batch( solver_context* p_ctx, const mdp* p_mdp,
+				     unsigned int count, const double* gammas,
+				     const double* rewards, double epsilon,
+				     double* utilities, 
+				     solver_observer observer,
+				     void* observer_arg );
+
+/*  Procedure
+ *    lazy_value_iteration
+ *
+ *  Purpose
+ *    Estimate utilities of an MDP whose transitions are generated on
+ *    demand
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_lazy
+ *   cacheStates
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   mode
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_lazy points to a valid lazy_mdp
+ *    utilities points to a valid array of length p_lazy->numStates
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *    p_ctx is NULL or a context not in use by another solver
+ *
+ *  Postconditions
+ *    utilities[s] contains the estimated utility value for the given
+ *    state, identical to what value_iteration computes for the same
+ *    model stored as an mdp. SWEEP_JACOBI sweeps are split over the
+ *    threads of p_ctx; every other mode runs SWEEP_GAUSS_SEIDEL in the
+ *    caller. Transitions are regenerated as each state is updated, so
+ *    only the utilities grow with the number of states.
+ *    Each thread keeps the cacheStates/threads states it used most
+ *    recently (see lazy_cache_create). Sweeps visit their states in a
+ *    cycle, so the cache only saves work when it holds all of them.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    sweep, given the largest utility change in it.
+ *    Any failure causes program exit.
+ */
+unsigned long lazy_value_iteration( solver_context* p_ctx,
+				    const lazy_mdp* p_lazy,
+				    unsigned int cacheStates, double epsilon,
+				    double gamma, double *utilities,
+				    sweep_mode mode, solver_observer observer,
+				    void* observer_arg );
+
+/*  Procedure
+ *    policy_iteration
+ *
+ *  Purpose
+ *    Optimize policy by alternating evaluation and improvement steps
+ *
+ *  Parameters
+ *   p_ctx
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   policy
+ *   mode
+ *   sweeps
+ *   exact
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_ctx is NULL or a context not in use by another solver
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    policy points to a valid array of length p_mdp->numStates
+ *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
+ *       and policy[s] is an entry in p_mdp->actions[s]
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *
+ *  Postconditions
+ *    When sweeps is 0, each policy is evaluated until no update exceeds
+ *    epsilon, and iteration stops once improvement leaves it unchanged.
+ *    If exact is nonzero, that evaluation instead solves the linear
+ *    system for the policy's utilities (policy_evaluation_exact).
+ *    Otherwise (modified policy iteration) each improvement step also
+ *    applies the full Bellman update, which is followed by sweeps
+ *    evaluation sweeps under the improved policy; iteration stops once
+ *    that update changes no utility by epsilon*(1-gamma)/gamma or more,
+ *    as in value iteration.
+ *    policy[s] contains the optimal policy for the given mdp
+ *    Each iterative policy evaluation orders its updates according to mode
+ *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
+ *       and policy[s] is an entry in p_mdp->actions[s]
+ *    backups is the number of single-state updates performed, counting
+ *    each improvement step as one update per state
+ *    Improvement steps and Jacobi evaluation sweeps are split over the
+ *    threads of p_ctx; the policy, utilities and statistics do not
+ *    depend on the number of threads.
+ *    Scratch space comes from p_ctx, which grows as needed; when p_ctx
+ *    is NULL a temporary context is used.
+ *    Unless observer is NULL, it is called with observer_arg after each
+ *    improvement step, given the Bellman residual of the utilities that
+ *    step improved upon and the number of policy changes it made.
+ *
+ *  Authors
+ *    Jerod Weinman (documentation & skeleton)
+ *    Daniel NP & Tyler D (implementation)
+ */			
+unsigned long policy_iteration( solver_context* p_ctx, const mdp* p_mdp,
+				double epsilon, double gamma,
+				unsigned int *policy, sweep_mode mode,
+				unsigned int sweeps, int exact,
+				solver_observer observer, void* observer_arg);
+
+/*  Procedure
+ *    lrtdp
+ *
+ *  Purpose
+ *    Find a policy for the states reachable from the start, with labeled
+ *    real-time dynamic programming
+ *
+ *  Parameters
+ *   p_mdp
+ *   epsilon
+ *   gamma
+ *   utilities
+ *   policy
+ *   observer
+ *   observer_arg
+ *
+ *  Produces,
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp whose transition rows
+ *      each sum to at most one
+ *    utilities and policy point to valid arrays of length
+ *      p_mdp->numStates
+ *    epsilon > 0
+ *    0 < gamma < 1
+ *
+ *  Postconditions
+ *    Utilities start from an admissible (never too low) heuristic:
+ *    R(s) for terminal states and R(s) + gamma * H otherwise, where H
+ *    bounds every utility from the largest rewards. When every
+ *    nonterminal reward is negative, H also counts the least number of
+ *    such rewards collected before a trajectory can reach a terminal
+ *    state or end, found by one backward pass over the transitions.
+ *    Trials follow the greedy policy from p_mdp->start, sampling
+ *    successors from a fixed seed, and update each state they visit. A
+ *    trial stops at a terminal or solved state, or after as many steps
+ *    as it takes gamma's powers to fall below epsilon*(1-gamma)/gamma.
+ *    Walking back, a state is labeled solved once every state its
+ *    greedy policy can reach has a residual below that threshold. This
+ *    repeats until the start is solved (Bonet and Geffner, 2003).
+ *    policy[s] is the greedy action of every state the resulting
+ *    policy reaches from the start; other entries are unchanged.
+ *    utilities[s] is within the tolerance of value_iteration for those
+ *    states, and remains an upper bound for the rest.
+ *    Only states the trials and label checks reach are updated, so on
+ *    large models whose start leads to a small region this is much
+ *    faster than solving every state.
+ *    backups is the number of single-state Bellman updates performed.
+ *    Unless observer is NULL, it is called with observer_arg after the
+ *    trial that brings the updates past each multiple of numStates, and
+ *    at the end, given the start's residual and the number of states
+ *    labeled solved so far (as changes).
+ *    Any failure causes program exit.
+ */
+unsigned long lrtdp( const mdp* p_mdp, double epsilon, double gamma,
+		     double* utilities, unsigned int* policy,
+		     solver_observer observer, void* observer_arg );
+
+/*  Procedure
+ *    randomize_policy
+ *
+ *  Purpose
+ *    Initialize policy to random actions
+ *
+ *  Parameters
+ *   p_mdp
+ *   policy
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    policy points to a valid array of length p_mdp->numStates
+ *
+ *  Postconditions
+ *    Each policy entry respects 0 <= policy[s] < p_mdp->numActions
+ *       and policy[s] is an entry in p_mdp->actions[s]
+ *    when p_mdp->numAvailableActions[s] > 0.
+ */
+void randomize_policy( const mdp* p_mdp, unsigned int* policy);
+
+/*  Procedure
+ *    solver_print_stats
+ *
+ *  Purpose
+ *    Print solver statistics, one line per iteration
+ *
+ *  Parameters
+ *   p_stats
+ *   stream, a FILE*
+ *
+ *  Produces,
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    A line for the iteration, preceded on the first iteration by a
+ *    header, is written to stream. Usable as a solver_observer.
+ */
+void solver_print_stats( const solver_stats* p_stats, void* stream );
+
+#endif // SOLVER_H
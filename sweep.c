@@ -0,0 +1,796 @@
+/* sweep.c
+ *
+ * Implementation of in-place, prioritized and topological Bellman update
+ * orders.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+
+#include "mdp.h"
+#include "pqueue.h"
+#include "sweep.h"
+#include "thread_pool.h"
+#include "utilities.h"
+
+// Marks a state not yet reached (or assigned) by sweep_components
+#define SWEEP_NONE UINT_MAX
+
+////////////////////////////////////////////////////////////////////////////////
+int sweep_mode_parse( const char* name, sweep_mode* p_mode )
+{
+  if (0 == strcmp(name, "jacobi"))
+    *p_mode = SWEEP_JACOBI;
+  else if (0 == strcmp(name, "gauss-seidel"))
+    *p_mode = SWEEP_GAUSS_SEIDEL;
+  else if (0 == strcmp(name, "prioritized"))
+    *p_mode = SWEEP_PRIORITIZED;
+  else if (0 == strcmp(name, "async"))
+    *p_mode = SWEEP_ASYNC;
+  else if (0 == strcmp(name, "topological"))
+    *p_mode = SWEEP_TOPOLOGICAL;
+  else
+    return 0;
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned long sweep_gauss_seidel( const mdp* p_mdp, sweep_backup backup,
+				  const void* arg, double threshold,
+				  double* utilities, sweep_progress progress,
+				  void* progress_arg )
+{
+  double max_utilities_change, utilities_change, updated;
+  unsigned int state;
+  unsigned long backups = 0;
+
+  do
+  {
+    max_utilities_change = 0;
+
+    for ( state = 0 ; state < p_mdp->numStates ; state++ )
+    {
+      // Later states in this pass see the new utility immediately
+      updated = backup(p_mdp, state, utilities, arg);
+      backups++;
+
+      utilities_change = fabs(updated - utilities[state]);
+      utilities[state] = updated;
+
+      if (utilities_change > max_utilities_change)
+	max_utilities_change = utilities_change;
+    }
+
+    if (NULL != progress)
+      progress(max_utilities_change, backups, progress_arg);
+
+  } while (max_utilities_change > threshold);
+
+  return backups;
+}
+
+/*  Procedure
+ *    sweep_check
+ *
+ *  Purpose
+ *    Measure a state's residual, queueing the state when it is too large
+ *
+ *  Produces
+ *   backups, an unsigned long (always 1)
+ *
+ *  Postconditions
+ *    bound[state] is |backup(state) - utilities[state]|, and state is in
+ *    p_queue with that priority when it exceeds threshold
+ */
+static unsigned long sweep_check( const mdp* p_mdp, sweep_backup backup,
+				  const void* arg, double threshold,
+				  const double* utilities, unsigned int state,
+				  double* bound, pqueue* p_queue )
+{
+  bound[state] = fabs(backup(p_mdp, state, utilities, arg) - utilities[state]);
+
+  if (bound[state] > threshold)
+    pqueue_set(p_queue, state, bound[state]);
+
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+sweep_graph* sweep_graph_create( void )
+{
+  sweep_graph *p_graph = malloc(sizeof(sweep_graph));
+
+  if (NULL == p_graph)
+  {
+    fprintf(stderr, "sweep_graph_create failed: %s (%s)\n",
+	    "Could not allocate graph", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  p_graph->p_mdp = NULL;
+  p_graph->predecessorStart = p_graph->predecessor = NULL;
+  p_graph->weight = NULL;
+  p_graph->order = p_graph->componentStart = p_graph->levelStart = NULL;
+  p_graph->numLevels = 0;
+
+  return p_graph;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void sweep_graph_clear( sweep_graph* p_graph )
+{
+  free(p_graph->predecessorStart);
+  free(p_graph->predecessor);
+  free(p_graph->weight);
+  free(p_graph->order);
+  free(p_graph->componentStart);
+  free(p_graph->levelStart);
+
+  p_graph->p_mdp = NULL;
+  p_graph->predecessorStart = p_graph->predecessor = NULL;
+  p_graph->weight = NULL;
+  p_graph->order = p_graph->componentStart = p_graph->levelStart = NULL;
+  p_graph->numLevels = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void sweep_graph_free( sweep_graph* p_graph )
+{
+  if (NULL == p_graph)
+    return;
+
+  sweep_graph_clear(p_graph);
+  free(p_graph);
+}
+
+/*  Procedure
+ *    sweep_graph_bind
+ *
+ *  Purpose
+ *    Make a graph describe an MDP, forgetting any other model's structure
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    p_graph->p_mdp == p_mdp; structure already found for p_mdp is kept
+ */
+static void sweep_graph_bind( sweep_graph* p_graph, const mdp* p_mdp )
+{
+  if (p_graph->p_mdp != p_mdp)
+  {
+    sweep_graph_clear(p_graph);
+    p_graph->p_mdp = p_mdp;
+  }
+}
+
+/*  Procedure
+ *    sweep_graph_weights
+ *
+ *  Purpose
+ *    Find the predecessors of each state and how strongly each feeds them
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_graph is bound to a valid, complete mdp
+ *
+ *  Postconditions
+ *    p_graph's predecessor lists (see mdp_predecessors) and weights are
+ *    set, unless they already were.
+ *    Any failure causes program exit.
+ */
+static void sweep_graph_weights( sweep_graph* p_graph )
+{
+  const mdp *p_mdp = p_graph->p_mdp;
+  unsigned int *predecessor_start, *predecessor;
+  unsigned int state, successor, i, low, high, mid, row_end;
+  double *weight;
+
+  if (NULL != p_graph->weight)
+    return;
+
+  mdp_predecessors(p_mdp, &predecessor_start, &predecessor);
+
+  weight = calloc( predecessor_start[p_mdp->numStates] ? 
+		   predecessor_start[p_mdp->numStates] : 1, sizeof(double) );
+
+  if (NULL == weight)
+  {
+    fprintf(stderr, "sweep_prioritized failed: %s\n",
+	    "Could not allocate residual bounds");
+    exit(EXIT_FAILURE);
+  }
+
+  // Find how strongly each successor's utility feeds each predecessor
+  for ( state = 0 ; state < p_mdp->numStates ; state++ )
+  {
+    row_end = p_mdp->transitionStart[(state + 1) * p_mdp->numActions];
+
+    for ( i = p_mdp->transitionStart[state * p_mdp->numActions] ; 
+	  i < row_end ; i++ )
+    {
+      successor = p_mdp->successor[i];
+
+      // Binary search for state among the (ascending) predecessors
+      low = predecessor_start[successor];
+      high = predecessor_start[successor + 1];
+
+      while (low < high)
+      {
+	mid = low + (high - low) / 2;
+
+	if (predecessor[mid] < state)
+	  low = mid + 1;
+	else
+	  high = mid;
+      }
+
+      if (p_mdp->transitionProb[i] > weight[low])
+	weight[low] = p_mdp->transitionProb[i];
+    }
+  }
+
+  p_graph->predecessorStart = predecessor_start;
+  p_graph->predecessor = predecessor;
+  p_graph->weight = weight;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned long sweep_prioritized( const mdp* p_mdp, sweep_backup backup,
+				 const void* arg, double threshold,
+				 double* utilities, sweep_graph* p_graph,
+				 sweep_progress progress, void* progress_arg )
+{
+  return sweep_prioritized_from(p_mdp, backup, arg, threshold, utilities,
+				NULL, 0, p_graph, progress, progress_arg);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned long sweep_prioritized_from( const mdp* p_mdp, sweep_backup backup,
+				      const void* arg, double threshold,
+				      double* utilities,
+				      const unsigned int* seeds,
+				      unsigned int numSeeds,
+				      sweep_graph* p_graph,
+				      sweep_progress progress,
+				      void* progress_arg )
+{
+  const unsigned int *predecessor_start, *predecessor;
+  const double *weight; // Per predecessor entry: max_a P(state|predecessor,a)
+  unsigned int state, prior, i, j;
+  double *bound;   // Upper bound on each state's Bellman residual
+  double updated, change;
+  unsigned long backups = 0;
+  unsigned char *checked;
+  pqueue *p_queue;
+  sweep_graph scratch = { NULL };
+
+  if (NULL == p_graph)
+    p_graph = &scratch;
+
+  sweep_graph_bind(p_graph, p_mdp);
+  sweep_graph_weights(p_graph);
+
+  predecessor_start = p_graph->predecessorStart;
+  predecessor = p_graph->predecessor;
+  weight = p_graph->weight;
+
+  bound = calloc( p_mdp->numStates ? p_mdp->numStates : 1, sizeof(double) );
+
+  if (NULL == bound)
+  {
+    fprintf(stderr, "sweep_prioritized failed: %s\n",
+	    "Could not allocate residual bounds");
+    exit(EXIT_FAILURE);
+  }
+
+  p_queue = pqueue_create(p_mdp->numStates);
+
+  // Seed the queue with every state whose residual is too large
+  if (NULL == seeds)
+    for ( state = 0 ; state < p_mdp->numStates ; state++ )
+      backups += sweep_check(p_mdp, backup, arg, threshold, utilities,
+			     state, bound, p_queue);
+  else
+  { // Only the seeds and their predecessors may have large residuals
+    checked = calloc( p_mdp->numStates ? p_mdp->numStates : 1, 1 );
+
+    if (NULL == checked)
+    {
+      fprintf(stderr, "sweep_prioritized failed: %s\n",
+	      "Could not allocate seed marks");
+      exit(EXIT_FAILURE);
+    }
+
+    for ( j = 0 ; j < numSeeds ; j++ )
+    {
+      state = seeds[j];
+
+      if (!checked[state])
+	backups += sweep_check(p_mdp, backup, arg, threshold, utilities,
+			       state, bound, p_queue);
+      checked[state] = 1;
+
+      for ( i = predecessor_start[seeds[j]] ; 
+	    i < predecessor_start[seeds[j] + 1] ; i++ )
+      {
+	prior = predecessor[i];
+
+	if (!checked[prior])
+	  backups += sweep_check(p_mdp, backup, arg, threshold, utilities,
+				 prior, bound, p_queue);
+	checked[prior] = 1;
+      }
+    }
+
+    free(checked);
+  }
+
+  while (p_queue->size > 0)
+  {
+    if (NULL != progress && 0 == backups % p_mdp->numStates)
+      progress(p_queue->priority[p_queue->heap[0]], backups, progress_arg);
+
+    state = pqueue_pop(p_queue);
+
+    updated = backup(p_mdp, state, utilities, arg);
+    backups++;
+
+    change = fabs(updated - utilities[state]);
+    utilities[state] = updated;
+    bound[state] = 0;
+
+    // A change in state's utility can raise a predecessor's residual by
+    // at most the change times the probability of reaching state
+    for ( i = predecessor_start[state] ; i < predecessor_start[state+1] ; i++ )
+    {
+      prior = predecessor[i];
+
+      bound[prior] += weight[i] * change;
+
+      if (bound[prior] > threshold)
+	pqueue_set(p_queue, prior, bound[prior]);
+    }
+  }
+
+  if (NULL != progress)
+  {
+    change = 0;
+
+    for ( state = 0 ; state < p_mdp->numStates ; state++ )
+      if (bound[state] > change)
+	change = bound[state];
+
+    progress(change, backups, progress_arg);
+  }
+
+  // Clean up
+  pqueue_free(p_queue);
+  free(bound);
+  sweep_graph_clear(&scratch);
+
+  return backups;
+}
+
+/*  Procedure
+ *    sweep_components
+ *
+ *  Purpose
+ *    Find the strongly connected components of an MDP's transition graph
+ *    and group them into levels that can be solved independently
+ *
+ *  Parameters
+ *   p_mdp
+ *   order
+ *   component_start
+ *   level_start
+ *
+ *  Produces
+ *   numLevels, an unsigned int
+ *
+ *  Preconditions
+ *    order points to numStates entries, component_start and level_start
+ *    to numStates+1 entries each
+ *
+ *  Postconditions
+ *    Component c holds the states order[component_start[c]] up to (but
+ *    excluding) order[component_start[c+1]], in ascending order.
+ *    Components are numbered so that every state a component can reach
+ *    (through transitions out of nonterminal states) lies in it or in a
+ *    component of a lower level, and level l holds components level_start[l] up to level_start[l+1].
+ *    Uses Tarjan's algorithm with an explicit stack.
+ *    Any failure causes program exit.
+ */
+static unsigned int sweep_components( const mdp* p_mdp, unsigned int* order,
+				      unsigned int* component_start,
+				      unsigned int* level_start )
+{
+  unsigned int num_states = p_mdp->numStates, num_actions = p_mdp->numActions;
+  unsigned int *index, *low, *edge, *component, *stack, *call, *level;
+  unsigned int *found_start;
+  unsigned int root, state, successor, depth, height, counter, next;
+  unsigned int num_components, num_levels, c, i, j, l;
+  size_t size = sizeof(unsigned int) * (num_states ? num_states : 1);
+
+  index = malloc(size);
+  low = malloc(size);
+  edge = malloc(size);
+  component = malloc(size);
+  stack = malloc(size);
+  call = malloc(size);
+  found_start = malloc(size + sizeof(unsigned int));
+
+  if (NULL == index || NULL == low || NULL == edge || NULL == component ||
+      NULL == stack || NULL == call || NULL == found_start)
+  {
+    fprintf(stderr, "sweep_topological failed: %s (%s)\n",
+	    "Could not allocate components", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  for ( state = 0 ; state < num_states ; state++ )
+    index[state] = component[state] = SWEEP_NONE;
+
+  counter = height = num_components = next = 0;
+
+  // Components are found sinks first, each listed in stack order
+  for ( root = 0 ; root < num_states ; root++ )
+  {
+    if (SWEEP_NONE != index[root])
+      continue;
+
+    depth = 0;
+    call[depth++] = root;
+    index[root] = low[root] = counter++;
+    stack[height++] = root;
+    edge[root] = p_mdp->terminal[root] ? 0 :
+      p_mdp->transitionStart[root * num_actions];
+
+    while (depth > 0)
+    {
+      state = call[depth - 1];
+
+      if (!p_mdp->terminal[state] &&
+	  edge[state] < p_mdp->transitionStart[(state + 1) * num_actions])
+      {
+	successor = p_mdp->successor[edge[state]++];
+
+	if (SWEEP_NONE == index[successor])
+	{ // Descend into an unvisited successor
+	  call[depth++] = successor;
+	  index[successor] = low[successor] = counter++;
+	  stack[height++] = successor;
+	  edge[successor] = p_mdp->terminal[successor] ? 0 :
+	    p_mdp->transitionStart[successor * num_actions];
+	}
+	else if (SWEEP_NONE == component[successor] &&
+		 index[successor] < low[state])
+	  low[state] = index[successor]; // Still on the stack
+      }
+      else
+      {
+	depth--;
+
+	if (low[state] == index[state])
+	{ // state roots a component: pop it off the stack
+	  found_start[num_components] = next;
+
+	  do
+	  {
+	    successor = stack[--height];
+	    component[successor] = num_components;
+	    order[next++] = successor;
+	  } while (successor != state);
+
+	  num_components++;
+	}
+
+	if (depth > 0 && low[state] < low[call[depth - 1]])
+	  low[call[depth - 1]] = low[state];
+      }
+    }
+  }
+
+  found_start[num_components] = next;
+
+  // A component's level is one more than the highest it can reach
+  level = index;  // No longer needed
+  num_levels = 0;
+
+  for ( c = 0 ; c < num_components ; c++ )
+  {
+    level[c] = 0;
+
+    for ( i = found_start[c] ; i < found_start[c + 1] ; i++ )
+    {
+      state = order[i];
+
+      if (p_mdp->terminal[state])
+	continue;
+
+      for ( j = p_mdp->transitionStart[state * num_actions] ;
+	    j < p_mdp->transitionStart[(state + 1) * num_actions] ; j++ )
+      {
+	successor = component[p_mdp->successor[j]];
+
+	if (successor != c && level[successor] + 1 > level[c])
+	  level[c] = level[successor] + 1;
+      }
+    }
+
+    if (level[c] + 1 > num_levels)
+      num_levels = level[c] + 1;
+  }
+
+  // Sort the components by level, keeping their order within a level
+  for ( l = 0 ; l <= num_levels ; l++ )
+    level_start[l] = 0;
+
+  for ( c = 0 ; c < num_components ; c++ )
+    level_start[level[c] + 1]++;
+
+  for ( l = 0 ; l < num_levels ; l++ )
+    level_start[l + 1] += level_start[l];
+
+  for ( c = 0 ; c < num_components ; c++ )
+    low[c] = level_start[level[c]]++;  // New number of component c
+
+  for ( l = num_levels ; l > 0 ; l-- )
+    level_start[l] = level_start[l - 1];
+  level_start[0] = 0;
+
+  // Lay out the states of the renumbered components in index order,
+  // which keeps a large component's passes close to a Gauss-Seidel sweep
+  for ( c = 0 ; c < num_components ; c++ )
+    call[low[c]] = found_start[c + 1] - found_start[c];
+
+  component_start[0] = 0;
+
+  for ( c = 0 ; c < num_components ; c++ )
+  {
+    component_start[c + 1] = component_start[c] + call[c];
+    call[c] = component_start[c];  // Next free entry of component c
+  }
+
+  for ( state = 0 ; state < num_states ; state++ )
+    order[call[low[component[state]]]++] = state;
+
+  free(index);
+  free(low);
+  free(edge);
+  free(component);
+  free(stack);
+  free(call);
+  free(found_start);
+
+  return num_levels;
+}
+
+/*  Procedure
+ *    sweep_graph_components
+ *
+ *  Purpose
+ *    Find the components of a graph's MDP and their levels
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_graph is bound to a valid, complete mdp
+ *
+ *  Postconditions
+ *    p_graph's components and levels (see sweep_components) are set,
+ *    unless they already were.
+ *    Any failure causes program exit.
+ */
+static void sweep_graph_components( sweep_graph* p_graph )
+{
+  size_t size = sizeof(unsigned int) * (p_graph->p_mdp->numStates + 1);
+
+  if (NULL != p_graph->order)
+    return;
+
+  p_graph->order = malloc(size);
+  p_graph->componentStart = malloc(size);
+  p_graph->levelStart = malloc(size);
+
+  if (NULL == p_graph->order || NULL == p_graph->componentStart ||
+      NULL == p_graph->levelStart)
+  {
+    fprintf(stderr, "sweep_topological failed: %s (%s)\n",
+	    "Could not allocate components", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  p_graph->numLevels = sweep_components(p_graph->p_mdp, p_graph->order,
+					p_graph->componentStart,
+					p_graph->levelStart);
+}
+
+/*  Procedure
+ *    sweep_component
+ *
+ *  Purpose
+ *    Update one strongly connected component in place until it converges
+ *
+ *  Produces
+ *   backups, an unsigned long
+ *
+ *  Postconditions
+ *    A Gauss-Seidel pass over states[0..count) changed no utility by more
+ *    than threshold (a single state without a self-transition needs one
+ *    update). *p_max_change is raised to the largest change made.
+ */
+static unsigned long sweep_component( const mdp* p_mdp, sweep_backup backup,
+				      const void* arg, double threshold,
+				      double* utilities,
+				      const unsigned int* states,
+				      unsigned int count, double* p_max_change )
+{
+  double max_utilities_change, utilities_change, updated;
+  unsigned int i, cyclic;
+  unsigned long backups = 0;
+
+  cyclic = (count > 1);
+
+  if (!cyclic && !p_mdp->terminal[states[0]])
+    for ( i = p_mdp->transitionStart[states[0] * p_mdp->numActions] ;
+	  i < p_mdp->transitionStart[(states[0] + 1) * p_mdp->numActions] ;
+	  i++ )
+      cyclic |= (p_mdp->successor[i] == states[0]);
+
+  do
+  {
+    max_utilities_change = 0;
+
+    for ( i = 0 ; i < count ; i++ )
+    {
+      updated = backup(p_mdp, states[i], utilities, arg);
+      backups++;
+
+      utilities_change = fabs(updated - utilities[states[i]]);
+      utilities[states[i]] = updated;
+
+      if (utilities_change > max_utilities_change)
+	max_utilities_change = utilities_change;
+    }
+
+    if (max_utilities_change > *p_max_change)
+      *p_max_change = max_utilities_change;
+
+  } while (cyclic && max_utilities_change > threshold);
+
+  return backups;
+}
+
+/* Shared state for solving one level of components in parallel */
+typedef struct {
+  const mdp* p_mdp;
+  sweep_backup backup;
+  const void* arg;
+  double threshold;
+  double* utilities;
+  const unsigned int *order;           /* States grouped by component */
+  const unsigned int *component_start; /* Start of each component */
+  unsigned int next;                   /* Next unclaimed component (atomic) */
+  unsigned int end;                    /* End of the level's components */
+  unsigned long *backups;              /* Per-thread updates */
+  double *max_change;                  /* Per-thread largest change */
+  unsigned long *eu_count;             /* Per-thread expected utilities */
+} sweep_level_arg;
+
+/* Claim and solve components of a level until none are left */
+static void sweep_level( void* p_arg, unsigned int thread,
+			 unsigned int numThreads )
+{
+  sweep_level_arg *p_level = p_arg;
+  unsigned long backups = 0, eu_start = calc_eu_count();
+  double max_change = 0;
+  unsigned int c;
+
+  while ((c = __atomic_fetch_add(&p_level->next, 1, __ATOMIC_RELAXED)) <
+	 p_level->end)
+    backups += sweep_component(p_level->p_mdp, p_level->backup, p_level->arg,
+			       p_level->threshold, p_level->utilities,
+			       p_level->order + p_level->component_start[c],
+			       p_level->component_start[c + 1] - 
+			       p_level->component_start[c], &max_change);
+
+  p_level->backups[thread] = backups;
+  p_level->max_change[thread] = max_change;
+  p_level->eu_count[thread] = calc_eu_count() - eu_start;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned long sweep_topological( const mdp* p_mdp, sweep_backup backup,
+				 const void* arg, double threshold,
+				 double* utilities, sweep_graph* p_graph,
+				 thread_pool* p_pool,
+				 sweep_progress progress, void* progress_arg )
+{
+  const unsigned int *order, *component_start, *level_start;
+  unsigned int num_levels, num_threads, l, c, thread;
+  unsigned long backups = 0, reported = 0;
+  double max_change = 0;
+  sweep_level_arg level;
+  sweep_graph scratch = { NULL };
+
+  num_threads = thread_pool_size(p_pool);
+
+  unsigned long thread_backups[num_threads], thread_eu[num_threads];
+  double thread_change[num_threads];
+
+  if (NULL == p_graph)
+    p_graph = &scratch;
+
+  sweep_graph_bind(p_graph, p_mdp);
+  sweep_graph_components(p_graph);
+
+  order = p_graph->order;
+  component_start = p_graph->componentStart;
+  level_start = p_graph->levelStart;
+  num_levels = p_graph->numLevels;
+
+  level.p_mdp = p_mdp;
+  level.backup = backup;
+  level.arg = arg;
+  level.threshold = threshold;
+  level.utilities = utilities;
+  level.order = order;
+  level.component_start = component_start;
+  level.backups = thread_backups;
+  level.max_change = thread_change;
+  level.eu_count = thread_eu;
+
+  for ( l = 0 ; l < num_levels ; l++ )
+  {
+    if (1 == num_threads || level_start[l + 1] - level_start[l] == 1)
+    { // Too little to share: solve the level in the caller
+      for ( c = level_start[l] ; c < level_start[l + 1] ; c++ )
+	backups += sweep_component(p_mdp, backup, arg, threshold, utilities,
+				   order + component_start[c],
+				   component_start[c + 1] - component_start[c],
+				   &max_change);
+    }
+    else
+    {
+      level.next = level_start[l];
+      level.end = level_start[l + 1];
+
+      thread_pool_run(p_pool, sweep_level, &level);
+
+      for ( thread = 0 ; thread < num_threads ; thread++ )
+      {
+	backups += thread_backups[thread];
+
+	if (thread_change[thread] > max_change)
+	  max_change = thread_change[thread];
+
+	if (thread > 0)
+	  calc_eu_credit(thread_eu[thread]);
+      }
+    }
+
+    if (NULL != progress && backups - reported >= p_mdp->numStates)
+    {
+      progress(max_change, backups, progress_arg);
+      reported = backups;
+      max_change = 0;
+    }
+  }
+
+  if (NULL != progress)
+    progress(max_change, backups, progress_arg);
+
+  sweep_graph_clear(&scratch);
+
+  return backups;
+}
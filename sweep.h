@@ -0,0 +1,306 @@
+/* sweep.h
+ *
+ * Declarations for the orders in which the iterative solvers apply
+ * Bellman updates to the states of an MDP.
+ *
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "mdp.h"
+#include "thread_pool.h"
+
+typedef enum {
+  SWEEP_JACOBI,       /* Update every state from the previous sweep */
+  SWEEP_GAUSS_SEIDEL, /* Update states in place, in index order */
+  SWEEP_PRIORITIZED,  /* Update the state of largest residual first */
+  SWEEP_ASYNC,        /* Update blocks of states in place, from several
+			 threads at once (value iteration only; others
+			 treat it as SWEEP_GAUSS_SEIDEL) */
+  SWEEP_TOPOLOGICAL   /* Solve strongly connected components in place,
+			 successors first */
+} sweep_mode;
+
+/* Structure of an MDP's transition graph that the prioritized and
+   topological orders need but no policy or utility affects, so solvers
+   that sweep the same model repeatedly can find it once. Each part is
+   found when first needed; the graph describes one model at a time. */
+typedef struct {
+  const mdp *p_mdp;               /* Model described, or NULL */
+  unsigned int *predecessorStart; /* Predecessors of each state, as from */
+  unsigned int *predecessor;      /* mdp_predecessors, or NULL */
+  double *weight;                 /* Per predecessor entry: the largest
+				     probability of reaching the state from
+				     the predecessor, or NULL */
+  unsigned int *order;            /* States grouped by strongly connected
+				     component, or NULL */
+  unsigned int *componentStart;   /* Start of each component in order */
+  unsigned int *levelStart;       /* Start of each level of components
+				     that cannot reach each other */
+  unsigned int numLevels;         /* Levels of components */
+} sweep_graph;
+
+/* A Bellman update: the new utility of state given utilities */
+typedef double (*sweep_backup)( const mdp* p_mdp, unsigned int state,
+				const double* utilities, const void* arg );
+
+/* Progress of an in-place order: the largest utility change (or bound on
+   it) since the last report, and the updates applied so far */
+typedef void (*sweep_progress)( double residual, unsigned long backups,
+				void* arg );
+
+/*  Procedure
+ *    sweep_mode_parse
+ *
+ *  Purpose
+ *    Translate the name of a sweep mode
+ *
+ *  Parameters
+ *   name
+ *   p_mode
+ *
+ *  Produces
+ *   ok, an int
+ *
+ *  Preconditions
+ *    name is a null-terminated string
+ *
+ *  Postconditions
+ *    When name is one of "jacobi", "gauss-seidel", "prioritized",
+ *    "async" or "topological", *p_mode is the corresponding mode and ok is nonzero;
+ *    otherwise ok is zero.
+ */
+int sweep_mode_parse( const char* name, sweep_mode* p_mode );
+
+/*  Procedure
+ *    sweep_graph_create
+ *
+ *  Purpose
+ *    Allocate an empty graph
+ *
+ *  Produces
+ *   p_graph, a sweep_graph*
+ *
+ *  Postconditions
+ *    p_graph describes no model.
+ *    Any failure causes program exit.
+ */
+sweep_graph* sweep_graph_create( void );
+
+/*  Procedure
+ *    sweep_graph_clear
+ *
+ *  Purpose
+ *    Forget the structure a graph holds
+ *
+ *  Parameters
+ *   p_graph
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    p_graph describes no model and its arrays are released, so the next
+ *    order given p_graph finds the structure afresh. Call this after
+ *    editing the transitions or terminal flags of the model it describes.
+ */
+void sweep_graph_clear( sweep_graph* p_graph );
+
+/*  Procedure
+ *    sweep_graph_free
+ *
+ *  Purpose
+ *    Release a graph
+ *
+ *  Parameters
+ *   p_graph
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    All memory of p_graph is released; NULL is ignored
+ */
+void sweep_graph_free( sweep_graph* p_graph );
+
+/*  Procedure
+ *    sweep_gauss_seidel
+ *
+ *  Purpose
+ *    Apply updates in place, in state order, until they converge
+ *
+ *  Parameters
+ *   p_mdp
+ *   backup
+ *   arg
+ *   threshold
+ *   utilities
+ *   progress
+ *   progress_arg
+ *
+ *  Produces
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    backup is a contraction in utilities
+ *    utilities points to a valid array of length p_mdp->numStates
+ *
+ *  Postconditions
+ *    A full pass changed no utility by more than threshold.
+ *    backups is the number of calls made to backup.
+ *    Unless progress is NULL, it is called with progress_arg after each
+ *    pass, given the largest change in that pass.
+ */
+unsigned long sweep_gauss_seidel( const mdp* p_mdp, sweep_backup backup,
+				  const void* arg, double threshold,
+				  double* utilities, sweep_progress progress,
+				  void* progress_arg );
+
+/*  Procedure
+ *    sweep_prioritized
+ *
+ *  Purpose
+ *    Apply updates in order of largest residual until they converge
+ *
+ *  Parameters
+ *   p_mdp
+ *   backup
+ *   arg
+ *   threshold
+ *   utilities
+ *   p_graph
+ *   progress
+ *   progress_arg
+ *
+ *  Produces
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    backup is a contraction in utilities whose result for a state
+ *      depends only on the utilities of that state's successors
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    p_graph is NULL or was produced by sweep_graph_create, and has
+ *      been cleared since the transitions or terminal flags of p_mdp
+ *      last changed
+ *
+ *  Postconditions
+ *    |backup(s) - utilities[s]| <= threshold for every state s.
+ *    Each state's residual is bounded without calling backup: an update
+ *    that changes a state's utility by d raises the bound of each
+ *    predecessor by d times its largest probability of reaching that
+ *    state, and the state with the largest bound is updated next.
+ *    backups is the number of calls made to backup.
+ *    Unless progress is NULL, it is called with progress_arg after every
+ *    numStates updates and once at the end, given the largest bound
+ *    still outstanding.
+ *    The predecessors and their weights are read from p_graph, found
+ *    there first unless it already describes p_mdp; when p_graph is
+ *    NULL they are found for this call alone.
+ */
+unsigned long sweep_prioritized( const mdp* p_mdp, sweep_backup backup,
+				 const void* arg, double threshold,
+				 double* utilities, sweep_graph* p_graph,
+				 sweep_progress progress, void* progress_arg );
+
+/*  Procedure
+ *    sweep_prioritized_from
+ *
+ *  Purpose
+ *    Restore convergence after a few states' updates have changed
+ *
+ *  Parameters
+ *   p_mdp
+ *   backup
+ *   arg
+ *   threshold
+ *   utilities
+ *   seeds
+ *   numSeeds
+ *   p_graph
+ *   progress
+ *   progress_arg
+ *
+ *  Produces
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    As for sweep_prioritized
+ *    seeds is NULL or points to numSeeds states, which may repeat
+ *    |backup(s) - utilities[s]| <= threshold already holds for every
+ *      state s that is neither a seed nor a predecessor of a seed
+ *
+ *  Postconditions
+ *    As for sweep_prioritized, which this is when seeds is NULL.
+ *    Otherwise only the seeds and their predecessors are checked at the
+ *    start, so when utilities come from an earlier solution and only the
+ *    rewards or transitions of the seeds have since changed, the updates
+ *    made grow with the size of the change rather than of p_mdp.
+ *    Finding predecessors still reads every transition once, unless
+ *    p_graph already holds them.
+ */
+unsigned long sweep_prioritized_from( const mdp* p_mdp, sweep_backup backup,
+				      const void* arg, double threshold,
+				      double* utilities,
+				      const unsigned int* seeds,
+				      unsigned int numSeeds,
+				      sweep_graph* p_graph,
+				      sweep_progress progress,
+				      void* progress_arg );
+
+/*  Procedure
+ *    sweep_topological
+ *
+ *  Purpose
+ *    Apply updates in place, one strongly connected component at a time,
+ *    solving each component after the components it can reach
+ *
+ *  Parameters
+ *   p_mdp
+ *   backup
+ *   arg
+ *   threshold
+ *   utilities
+ *   p_graph
+ *   p_pool
+ *   progress
+ *   progress_arg
+ *
+ *  Produces
+ *   backups, an unsigned long
+ *
+ *  Preconditions
+ *    p_mdp is a pointer to a valid, complete mdp
+ *    backup is a contraction in utilities whose result for a state
+ *      depends only on the utilities of that state's successors (none
+ *      for terminal states), and is safe to call from several threads
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    p_graph is as for sweep_prioritized
+ *    p_pool is NULL or not already running a task
+ *
+ *  Postconditions
+ *    The states are split into the strongly connected components of the
+ *    graph of nonzero transitions out of nonterminal states. Each
+ *    component is updated in Gauss-Seidel passes until a pass changes no
+ *    utility in it by more than threshold, once every component it can
+ *    reach is done, so no pass revisits a converged region; a component
+ *    of one state without a self-transition takes a single update.
+ *    Components that cannot reach each other are split over the threads
+ *    of p_pool (the caller alone when NULL); results do not depend on
+ *    the number of threads.
+ *    backups is the number of calls made to backup.
+ *    Unless progress is NULL, it is called with progress_arg whenever
+ *    another numStates updates have been made and once at the end, given
+ *    the largest change made since the last call.
+ *    The components are read from p_graph as sweep_prioritized reads
+ *    the predecessors.
+ */
+unsigned long sweep_topological( const mdp* p_mdp, sweep_backup backup,
+				 const void* arg, double threshold,
+				 double* utilities, sweep_graph* p_graph,
+				 thread_pool* p_pool,
+				 sweep_progress progress, void* progress_arg );
+
+#endif // SWEEP_H
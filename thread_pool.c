@@ -0,0 +1,204 @@
+/* thread_pool.c
+ *
+ * Implementation of a fixed-size, fork-join pool of worker threads.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "thread_pool.h"
+
+struct thread_pool {
+  unsigned int numThreads;   /* Threads running each task, including caller */
+  pthread_t *workers;        /* A numThreads-1 length array of workers */
+  pthread_mutex_t lock;      /* Guards every field below */
+  pthread_cond_t start;      /* Signaled when a task is posted */
+  pthread_cond_t done;       /* Signaled when the last worker finishes */
+  thread_pool_task task;     /* Current task */
+  void *arg;                 /* Argument to the current task */
+  unsigned long generation;  /* Incremented as each task is posted */
+  unsigned int running;      /* Workers yet to finish the current task */
+  int shutdown;              /* Nonzero when workers should exit */
+};
+
+/* Argument handed to each worker when it is created */
+typedef struct {
+  thread_pool *p_pool;
+  unsigned int thread;
+} worker_arg;
+
+////////////////////////////////////////////////////////////////////////////////
+static void* worker_main( void* p_arg )
+{
+  worker_arg *p_worker = p_arg;
+  thread_pool *p_pool = p_worker->p_pool;
+  unsigned int thread = p_worker->thread;
+  unsigned long seen = 0;
+  thread_pool_task task;
+  void *arg;
+
+  free(p_worker);
+
+  pthread_mutex_lock(&p_pool->lock);
+
+  while (1)
+  {
+    while (!p_pool->shutdown && p_pool->generation == seen)
+      pthread_cond_wait(&p_pool->start, &p_pool->lock);
+
+    if (p_pool->shutdown)
+      break;
+
+    seen = p_pool->generation;
+    task = p_pool->task;
+    arg = p_pool->arg;
+
+    pthread_mutex_unlock(&p_pool->lock);
+    task(arg, thread, p_pool->numThreads);
+    pthread_mutex_lock(&p_pool->lock);
+
+    if (0 == --p_pool->running)
+      pthread_cond_signal(&p_pool->done);
+  }
+
+  pthread_mutex_unlock(&p_pool->lock);
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+thread_pool* thread_pool_create( unsigned int numThreads )
+{
+  thread_pool *p_pool;
+  worker_arg *p_worker;
+  unsigned int i;
+  int ret;
+
+  p_pool = malloc( sizeof(thread_pool) );
+
+  if (NULL == p_pool)
+  {
+    fprintf(stderr, "thread_pool_create failed: %s\n",
+	    "Could not allocate thread pool");
+    exit(EXIT_FAILURE);
+  }
+
+  p_pool->numThreads = numThreads;
+  p_pool->task = NULL;
+  p_pool->arg = NULL;
+  p_pool->generation = 0;
+  p_pool->running = 0;
+  p_pool->shutdown = 0;
+
+  pthread_mutex_init(&p_pool->lock, NULL);
+  pthread_cond_init(&p_pool->start, NULL);
+  pthread_cond_init(&p_pool->done, NULL);
+
+  p_pool->workers = malloc( sizeof(pthread_t) * (numThreads > 1 ? 
+						 numThreads - 1 : 1) );
+
+  if (NULL == p_pool->workers)
+  {
+    fprintf(stderr, "thread_pool_create failed: %s\n",
+	    "Could not allocate workers");
+    exit(EXIT_FAILURE);
+  }
+
+  for (i = 1 ; i < numThreads ; i++)
+  {
+    p_worker = malloc( sizeof(worker_arg) );
+
+    if (NULL == p_worker)
+    {
+      fprintf(stderr, "thread_pool_create failed: %s\n",
+	      "Could not allocate worker");
+      exit(EXIT_FAILURE);
+    }
+
+    p_worker->p_pool = p_pool;
+    p_worker->thread = i;
+
+    ret = pthread_create(&p_pool->workers[i-1], NULL, worker_main, p_worker);
+
+    if (0 != ret)
+    {
+      fprintf(stderr, "thread_pool_create failed: %s\n", strerror(ret));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return p_pool;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void thread_pool_run( thread_pool* p_pool, thread_pool_task task, void* arg )
+{
+  if (NULL == p_pool || p_pool->numThreads <= 1)
+  {
+    task(arg, 0, 1);
+    return;
+  }
+
+  // Post the task to the workers
+  pthread_mutex_lock(&p_pool->lock);
+  p_pool->task = task;
+  p_pool->arg = arg;
+  p_pool->running = p_pool->numThreads - 1;
+  p_pool->generation++;
+  pthread_cond_broadcast(&p_pool->start);
+  pthread_mutex_unlock(&p_pool->lock);
+
+  // Take a share of the work ourselves
+  task(arg, 0, p_pool->numThreads);
+
+  // Wait for the workers to finish theirs
+  pthread_mutex_lock(&p_pool->lock);
+  while (p_pool->running > 0)
+    pthread_cond_wait(&p_pool->done, &p_pool->lock);
+  pthread_mutex_unlock(&p_pool->lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int thread_pool_size( const thread_pool* p_pool )
+{
+  return (NULL == p_pool) ? 1 : p_pool->numThreads;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void thread_pool_free( thread_pool* p_pool )
+{
+  unsigned int i;
+
+  if (NULL == p_pool)
+    return;
+
+  pthread_mutex_lock(&p_pool->lock);
+  p_pool->shutdown = 1;
+  pthread_cond_broadcast(&p_pool->start);
+  pthread_mutex_unlock(&p_pool->lock);
+
+  for (i = 1 ; i < p_pool->numThreads ; i++)
+    pthread_join(p_pool->workers[i-1], NULL);
+
+  pthread_mutex_destroy(&p_pool->lock);
+  pthread_cond_destroy(&p_pool->start);
+  pthread_cond_destroy(&p_pool->done);
+
+  free(p_pool->workers);
+  free(p_pool);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void thread_pool_range( unsigned int length, unsigned int thread,
+			unsigned int numThreads,
+			unsigned int *p_first, unsigned int *p_last )
+{
+  // Spread the remainder over the first threads
+  unsigned int share = length / numThreads;
+  unsigned int extra = length % numThreads;
+
+  *p_first = thread * share + (thread < extra ? thread : extra);
+  *p_last = *p_first + share + (thread < extra ? 1 : 0);
+}
@@ -0,0 +1,129 @@
+/* thread_pool.h
+ *
+ * Declarations for a fixed-size pool of worker threads that run a task
+ * in fork-join fashion, used by the solvers to split sweeps over states.
+ *
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+typedef struct thread_pool thread_pool;
+
+/* A task run by every thread of a pool. thread is the index of the
+ * running thread (0 <= thread < numThreads); the caller of
+ * thread_pool_run is always thread 0. */
+typedef void (*thread_pool_task)( void* arg, unsigned int thread,
+				  unsigned int numThreads );
+
+/*  Procedure
+ *    thread_pool_create
+ *
+ *  Purpose
+ *    Start a pool of worker threads
+ *
+ *  Parameters
+ *   numThreads
+ *
+ *  Produces
+ *   p_pool, a thread_pool*
+ *
+ *  Preconditions
+ *    numThreads > 0
+ *
+ *  Postconditions
+ *    p_pool runs tasks on numThreads threads: the calling thread plus
+ *    numThreads-1 workers, which wait idle between tasks.
+ *    Any failure causes program exit.
+ */
+thread_pool* thread_pool_create( unsigned int numThreads );
+
+/*  Procedure
+ *    thread_pool_run
+ *
+ *  Purpose
+ *    Run a task on every thread of a pool and wait for all to finish
+ *
+ *  Parameters
+ *   p_pool
+ *   task
+ *   arg
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_pool is NULL or was produced by thread_pool_create
+ *    thread_pool_run is not already running on p_pool
+ *
+ *  Postconditions
+ *    task(arg, t, n) has returned for every thread t of the n threads
+ *    in p_pool. A NULL pool runs task(arg, 0, 1) in the caller.
+ */
+void thread_pool_run( thread_pool* p_pool, thread_pool_task task, void* arg );
+
+/*  Procedure
+ *    thread_pool_size
+ *
+ *  Purpose
+ *    Report the number of threads in a pool
+ *
+ *  Parameters
+ *   p_pool
+ *
+ *  Produces
+ *   numThreads, an unsigned int
+ *
+ *  Postconditions
+ *    numThreads is the count given to thread_pool_create, or 1 for NULL
+ */
+unsigned int thread_pool_size( const thread_pool* p_pool );
+
+/*  Procedure
+ *    thread_pool_free
+ *
+ *  Purpose
+ *    Stop and free a pool of worker threads
+ *
+ *  Parameters
+ *   p_pool
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_pool is NULL or was produced by thread_pool_create, and is idle
+ *
+ *  Postconditions
+ *    All workers have exited and memory for p_pool is freed
+ */
+void thread_pool_free( thread_pool* p_pool );
+
+/*  Procedure
+ *    thread_pool_range
+ *
+ *  Purpose
+ *    Partition a range of indices among the threads of a pool
+ *
+ *  Parameters
+ *   length
+ *   thread
+ *   numThreads
+ *   p_first
+ *   p_last
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    0 <= thread < numThreads
+ *
+ *  Postconditions
+ *    [*p_first, *p_last) is the contiguous share of [0, length) that
+ *    belongs to thread; the shares of all threads tile [0, length).
+ */
+void thread_pool_range( unsigned int length, unsigned int thread,
+			unsigned int numThreads,
+			unsigned int *p_first, unsigned int *p_last );
+
+#endif // THREAD_POOL_H
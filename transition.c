@@ -47,7 +47,7 @@ int main(int argc, char* argv[])
 
   for (successor=0 ; successor < p_mdp->numStates ; successor++)
   {
-    transition = p_mdp->transitionProb[successor][state][action];
+    transition = mdp_transition(p_mdp, successor, state, action);
     printf("%u\t%.2lf\n", successor, transition);
   }
 
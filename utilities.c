@@ -1,7 +1,412 @@
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "mdp.h"
 #include "utilities.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTILITIES_X86
+#endif
+
+// Number of transition terms gathered per kernel call
+#define EU_CHUNK 64
+
+/* Kernel signature: products[i] = prob[i] * utilities[successor[i]],
+ * 0 <= i < n. Kernels only multiply; callers sum the products in
+ * order, so every kernel yields bit-identical expected utilities. */
+typedef void (*gather_mul_kernel)( const double* prob,
+				   const unsigned int* successor,
+				   unsigned int n, const double* utilities,
+				   double* products );
+
+/* As gather_mul_kernel, for probabilities stored as floats */
+typedef void (*gather_mul_float_kernel)( const float* prob,
+					 const unsigned int* successor,
+					 unsigned int n, const double* utilities,
+					 double* products );
+
+/* As gather_mul_kernel, with prob[i] = palette[index[i]] */
+typedef void (*gather_mul_palette_kernel)( const double* palette,
+					   const unsigned char* index,
+					   const unsigned int* successor,
+					   unsigned int n,
+					   const double* utilities,
+					   double* products );
+
+////////////////////////////////////////////////////////////////////////////////
+static void gather_mul_scalar( const double* prob,
+			       const unsigned int* successor, unsigned int n,
+			       const double* utilities, double* products )
+{
+  unsigned int i;
+
+  for (i = 0 ; i < n ; i++)
+    products[i] = prob[i] * utilities[successor[i]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void gather_mul_float_scalar( const float* prob,
+				     const unsigned int* successor,
+				     unsigned int n, const double* utilities,
+				     double* products )
+{
+  unsigned int i;
+
+  for (i = 0 ; i < n ; i++)
+    products[i] = (double)prob[i] * utilities[successor[i]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void gather_mul_palette_scalar( const double* palette,
+				       const unsigned char* index,
+				       const unsigned int* successor,
+				       unsigned int n, const double* utilities,
+				       double* products )
+{
+  unsigned int i;
+
+  for (i = 0 ; i < n ; i++)
+    products[i] = palette[index[i]] * utilities[successor[i]];
+}
+
+#ifdef UTILITIES_X86
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2")))
+static void gather_mul_avx2( const double* prob,
+			     const unsigned int* successor, unsigned int n,
+			     const double* utilities, double* products )
+{
+  unsigned int i;
+
+  for (i = 0 ; i + 4 <= n ; i += 4)
+  {
+    __m128i index = _mm_loadu_si128( (const __m128i*)(successor + i) );
+    __m256d u = _mm256_i32gather_pd( utilities, index, sizeof(double) );
+    __m256d p = _mm256_loadu_pd( prob + i );
+    _mm256_storeu_pd( products + i, _mm256_mul_pd(p, u) );
+  }
+
+  for ( ; i < n ; i++)
+    products[i] = prob[i] * utilities[successor[i]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx512f")))
+static void gather_mul_avx512( const double* prob,
+			       const unsigned int* successor, unsigned int n,
+			       const double* utilities, double* products )
+{
+  unsigned int i;
+
+  for (i = 0 ; i + 8 <= n ; i += 8)
+  {
+    __m256i index = _mm256_loadu_si256( (const __m256i*)(successor + i) );
+    __m512d u = _mm512_i32gather_pd( index, utilities, sizeof(double) );
+    __m512d p = _mm512_loadu_pd( prob + i );
+    _mm512_storeu_pd( products + i, _mm512_mul_pd(p, u) );
+  }
+
+  for ( ; i < n ; i++)
+    products[i] = prob[i] * utilities[successor[i]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2")))
+static void gather_mul_float_avx2( const float* prob,
+				   const unsigned int* successor,
+				   unsigned int n, const double* utilities,
+				   double* products )
+{
+  unsigned int i;
+
+  for (i = 0 ; i + 4 <= n ; i += 4)
+  {
+    __m128i index = _mm_loadu_si128( (const __m128i*)(successor + i) );
+    __m256d u = _mm256_i32gather_pd( utilities, index, sizeof(double) );
+    __m256d p = _mm256_cvtps_pd( _mm_loadu_ps(prob + i) );
+    _mm256_storeu_pd( products + i, _mm256_mul_pd(p, u) );
+  }
+
+  for ( ; i < n ; i++)
+    products[i] = (double)prob[i] * utilities[successor[i]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2")))
+static void gather_mul_palette_avx2( const double* palette,
+				     const unsigned char* index,
+				     const unsigned int* successor,
+				     unsigned int n, const double* utilities,
+				     double* products )
+{
+  unsigned int i;
+  int bytes;
+
+  for (i = 0 ; i + 4 <= n ; i += 4)
+  {
+    memcpy( &bytes, index + i, sizeof(bytes) );
+
+    __m128i entry = _mm_cvtepu8_epi32( _mm_cvtsi32_si128(bytes) );
+    __m128i state = _mm_loadu_si128( (const __m128i*)(successor + i) );
+    __m256d u = _mm256_i32gather_pd( utilities, state, sizeof(double) );
+    __m256d p = _mm256_i32gather_pd( palette, entry, sizeof(double) );
+    _mm256_storeu_pd( products + i, _mm256_mul_pd(p, u) );
+  }
+
+  for ( ; i < n ; i++)
+    products[i] = palette[index[i]] * utilities[successor[i]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx512f")))
+static void gather_mul_float_avx512( const float* prob,
+				     const unsigned int* successor,
+				     unsigned int n, const double* utilities,
+				     double* products )
+{
+  unsigned int i;
+
+  for (i = 0 ; i + 8 <= n ; i += 8)
+  {
+    __m256i index = _mm256_loadu_si256( (const __m256i*)(successor + i) );
+    __m512d u = _mm512_i32gather_pd( index, utilities, sizeof(double) );
+    __m512d p = _mm512_cvtps_pd( _mm256_loadu_ps(prob + i) );
+    _mm512_storeu_pd( products + i, _mm512_mul_pd(p, u) );
+  }
+
+  for ( ; i < n ; i++)
+    products[i] = (double)prob[i] * utilities[successor[i]];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx512f")))
+static void gather_mul_palette_avx512( const double* palette,
+				       const unsigned char* index,
+				       const unsigned int* successor,
+				       unsigned int n, const double* utilities,
+				       double* products )
+{
+  unsigned int i;
+
+  for (i = 0 ; i + 8 <= n ; i += 8)
+  {
+    __m256i entry = _mm256_cvtepu8_epi32( 
+      _mm_loadl_epi64( (const __m128i*)(index + i) ) );
+    __m256i state = _mm256_loadu_si256( (const __m256i*)(successor + i) );
+    __m512d u = _mm512_i32gather_pd( state, utilities, sizeof(double) );
+    __m512d p = _mm512_i32gather_pd( entry, palette, sizeof(double) );
+    _mm512_storeu_pd( products + i, _mm512_mul_pd(p, u) );
+  }
+
+  for ( ; i < n ; i++)
+    products[i] = palette[index[i]] * utilities[successor[i]];
+}
+#endif
+
+/* The kernels of one instruction set, selected together */
+typedef struct {
+  const char *name;
+  gather_mul_kernel gather_mul;
+  gather_mul_float_kernel gather_mul_float;
+  gather_mul_palette_kernel gather_mul_palette;
+} gather_mul_set;
+
+static const gather_mul_set gather_mul_sets[] = {
+  { "scalar", gather_mul_scalar, gather_mul_float_scalar,
+    gather_mul_palette_scalar },
+#ifdef UTILITIES_X86
+  { "avx2", gather_mul_avx2, gather_mul_float_avx2, gather_mul_palette_avx2 },
+  { "avx512", gather_mul_avx512, gather_mul_float_avx512,
+    gather_mul_palette_avx512 },
+#endif
+};
+
+#define NUM_GATHER_MUL_SETS \
+  (sizeof(gather_mul_sets) / sizeof(gather_mul_sets[0]))
+
+/* The selected kernels, published whole (release) and read with acquire
+   so that no thread sees a partial selection */
+static const gather_mul_set* gather_mul_selected = NULL;
+
+/* Guards choosing the default kernels */
+static pthread_once_t gather_mul_once = PTHREAD_ONCE_INIT;
+
+/* Expected utilities computed by the calling thread */
+static __thread unsigned long eu_count = 0;
+
+/* The kernels named by name (the widest supported when NULL), or NULL
+   when the processor lacks them */
+static const gather_mul_set* calc_find_kernel( const char* name )
+{
+  unsigned int k;
+
+  if (NULL == name)
+  { // Pick the widest kernel this processor supports
+#ifdef UTILITIES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return calc_find_kernel("avx512");
+    if (__builtin_cpu_supports("avx2"))
+      return calc_find_kernel("avx2");
+#endif
+    return calc_find_kernel("scalar");
+  }
+
+#ifdef UTILITIES_X86
+  __builtin_cpu_init();
+  if ((0 == strcmp(name, "avx2") && !__builtin_cpu_supports("avx2")) ||
+      (0 == strcmp(name, "avx512") && !__builtin_cpu_supports("avx512f")))
+    return NULL;
+#endif
+
+  for (k = 0 ; k < NUM_GATHER_MUL_SETS ; k++)
+    if (0 == strcmp(name, gather_mul_sets[k].name))
+      return gather_mul_sets + k;
+
+  return NULL;
+}
+
+/* Select the default kernels, unless calc_set_kernel already chose some */
+static void calc_default_kernel( void )
+{
+  const gather_mul_set *p_set = calc_find_kernel(getenv("MDP_KERNEL"));
+  const gather_mul_set *p_none = NULL;
+
+  if (NULL == p_set) // An unavailable MDP_KERNEL falls back to the widest
+    p_set = calc_find_kernel(NULL);
+
+  __atomic_compare_exchange_n(&gather_mul_selected, &p_none, p_set, 0,
+			      __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/* The selected kernels, choosing the default on first use */
+static const gather_mul_set* calc_kernel( void )
+{
+  const gather_mul_set *p_set =
+    __atomic_load_n(&gather_mul_selected, __ATOMIC_ACQUIRE);
+
+  if (NULL == p_set)
+  {
+    pthread_once(&gather_mul_once, calc_default_kernel);
+    p_set = __atomic_load_n(&gather_mul_selected, __ATOMIC_ACQUIRE);
+  }
+
+  return p_set;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int calc_set_kernel( const char* name )
+{
+  const gather_mul_set *p_set = calc_find_kernel(name);
+
+  if (NULL == p_set)
+    return 0;
+
+  __atomic_store_n(&gather_mul_selected, p_set, __ATOMIC_RELEASE);
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void calc_init_kernel( void )
+{
+  calc_kernel();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const char* calc_kernel_name( void )
+{
+  return calc_kernel()->name;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned long calc_eu_count( void )
+{
+  return eu_count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void calc_eu_credit( unsigned long count )
+{
+  eu_count += count;
+}
+
+/*  Procedure
+ *    sum_rows
+ *
+ *  Purpose
+ *    Sum the expected utilities of consecutive transition rows
+ *
+ *  Parameters
+ *   p_mdp
+ *   first_row
+ *   num_rows
+ *   utilities
+ *   eu
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    first_row + num_rows <= p_mdp->numStates * p_mdp->numActions
+ *    eu points to a valid array of length num_rows
+ *
+ *  Postconditions
+ *    eu[r] = sum_{i in row first_row+r} P_i * utilities(successor_i),
+ *    accumulated in successor order, with P_i read from the storage
+ *    that p_mdp->precision selects
+ *    The calling thread's count of expected utilities grows by num_rows
+ */
+static void sum_rows( const mdp* p_mdp, unsigned int first_row,
+		      unsigned int num_rows, const double* utilities,
+		      double* eu )
+{
+  const gather_mul_set *p_set = calc_kernel();
+  double products[EU_CHUNK];
+  unsigned int i, j, n, last, row, row_end;
+
+  i = p_mdp->transitionStart[first_row];
+  last = p_mdp->transitionStart[first_row + num_rows];
+
+  for (row = 0 ; row < num_rows ; row++)
+    eu[row] = 0;
+
+  eu_count += num_rows;
+
+  row = 0;
+  row_end = p_mdp->transitionStart[first_row + 1];
+
+  // One pass over the successors of all rows, a chunk at a time
+  for ( ; i < last ; i += n)
+  {
+    n = (last - i < EU_CHUNK) ? last - i : EU_CHUNK;
+
+    switch (p_mdp->precision)
+    {
+    case MDP_PRECISION_FLOAT:
+      p_set->gather_mul_float( p_mdp->transitionFloat + i,
+			       p_mdp->successor + i, n, utilities, products );
+      break;
+    case MDP_PRECISION_PALETTE:
+      p_set->gather_mul_palette( p_mdp->palette, p_mdp->transitionIndex + i,
+				 p_mdp->successor + i, n, utilities, products );
+      break;
+    default:
+      p_set->gather_mul( p_mdp->transitionProb + i, p_mdp->successor + i, n,
+			 utilities, products );
+    }
+
+    for (j = 0 ; j < n ; j++)
+    {
+      while (i + j >= row_end) // Advance past finished (or empty) rows
+	row_end = p_mdp->transitionStart[first_row + (++row) + 1];
+
+      eu[row] += products[j];
+    }
+  }
+}
+
 /*  Procedure
  *    calc_eu
  *
@@ -42,7 +447,6 @@ double calc_eu( const mdp*  p_mdp, unsigned int state, const double* utilities,
 	      const unsigned int action)
 {
   double eu;   // Expected utility
-  int successor;
 
   // if a state has no successors
   if (p_mdp->terminal[state] || p_mdp->numAvailableActions[state] <= 0)
@@ -50,15 +454,9 @@ double calc_eu( const mdp*  p_mdp, unsigned int state, const double* utilities,
     return 0; // any action has no expected utility
   }
 
-  eu = 0;
-
   // Calculate expected utility: sum_{s'} P(s'|s,a)*U(s')
-
-  // Go through every successor state
-  for (successor = 0 ; successor < p_mdp->numStates ; successor++)
-  {
-     eu += p_mdp->transitionProb[successor][state][action] * utilities[successor];
-  }
+  // over every successor state with nonzero probability
+  sum_rows(p_mdp, state * p_mdp->numActions + action, 1, utilities, &eu);
 
   return eu;
 }
@@ -102,36 +500,239 @@ double calc_eu( const mdp*  p_mdp, unsigned int state, const double* utilities,
 void calc_meu( const mdp* p_mdp, unsigned int state, const double* utilities,
 	       double *meu, unsigned int *action )
 {
-  // Calculated maximum expected utility (use calc_eu):
-  unsigned int i, current_action, num_available_actions, max_action;
+  unsigned int i, j, run, row, num_available_actions;
   unsigned int *available_actions;
-  double eu, max_eu;
+  double eu[EU_CHUNK], max_eu;
 
   num_available_actions = p_mdp->numAvailableActions[state];
   available_actions = p_mdp->actions[state];
 
-  max_eu = -INFINITY;
-  max_action = 0;
-
   if (num_available_actions == 0) {
     *meu = 0; // max utility of no actions is zero
     *action = 0;
     return;
   }
 
-  for (i = 0 ; i < num_available_actions ; i++)
+  max_eu = -INFINITY;
+  *action = 0;
+  row = state * p_mdp->numActions;
+
+  // Sum each run of consecutive available actions, whose rows are
+  // adjacent, at once; a bounded buffer holds at most EU_CHUNK of them
+  for (i = 0 ; i < num_available_actions ; i += run)
   {
-    current_action = available_actions[i];
+    for (run = 1 ; run < EU_CHUNK && i + run < num_available_actions &&
+	   available_actions[i + run] == available_actions[i] + run ; run++)
+      ;
+
+    sum_rows(p_mdp, row + available_actions[i], run, utilities, eu);
+
+    for (j = 0 ; j < run ; j++)
+      if (eu[j] > max_eu)
+      {
+	max_eu = eu[j];
+	*action = available_actions[i + j];
+      }
+  }
 
-    eu = calc_eu(p_mdp, state, utilities, current_action);
+  *meu = max_eu;
+}
 
-    if (eu > max_eu)
+/*  Procedure
+ *    calc_meu_eliminate
+ *
+ *  Purpose
+ *    Calculate the action of maximum expected utility among a state's
+ *    remaining actions, dropping those that can no longer be optimal
+ *
+ *  Parameters
+ *   p_mdp
+ *   state
+ *   utilities
+ *   actions
+ *   numActions
+ *   margin
+ *   meu
+ *   action
+ *
+ *  Produces
+ *   kept, an unsigned int
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struc
+ *    0 <= state < p_mdp->numStates
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    actions points to numActions entries of p_mdp->actions[state]
+ *    margin >= 0 (INFINITY keeps every action)
+ *    meu != NULL
+ *    action != NULL
+ *
+ *  Postconditions
+ *    *meu is max_{a in actions} EU(state,a) and *action the first listed
+ *    action that yields it (0 and 0 when numActions is 0).
+ *    The first kept entries of actions are, in their original order,
+ *    the actions with EU(state,a) >= *meu - margin; *action is among
+ *    them. Only the listed actions' expected utilities are computed.
+ */
+unsigned int calc_meu_eliminate( const mdp* p_mdp, unsigned int state,
+				 const double* utilities, unsigned int* actions,
+				 unsigned int numActions, double margin,
+				 double *meu, unsigned int *action )
+{
+  unsigned int i, run, kept, row;
+  double eu[numActions ? numActions : 1], max_eu;
+
+  *meu = 0;
+  *action = 0;
+
+  if (0 == numActions)
+    return 0;
+
+  row = state * p_mdp->numActions;
+
+  // Sum each run of consecutive actions, whose rows are adjacent, at once
+  for (i = 0 ; i < numActions ; i += run)
+  {
+    for (run = 1 ; i + run < numActions && 
+	   actions[i + run] == actions[i] + run ; run++)
+      ;
+
+    sum_rows(p_mdp, row + actions[i], run, utilities, eu + i);
+  }
+
+  max_eu = -INFINITY;
+
+  for (i = 0 ; i < numActions ; i++)
+  {
+    if (eu[i] > max_eu)
     {
-      max_eu = eu;
-      max_action = current_action;
+      max_eu = eu[i];
+      *action = actions[i];
     }
   }
 
+  // Keep the actions whose expected utility is within margin of the best
+  kept = 0;
+
+  for (i = 0 ; i < numActions ; i++)
+    if (!(eu[i] < max_eu - margin))
+      actions[kept++] = actions[i];
+
   *meu = max_eu;
-  *action = max_action;
+
+  return kept;
+}
+
+/*  Procedure
+ *    calc_eu_all
+ *
+ *  Purpose
+ *    Calculate the expected utility of every action in a state of an MDP
+ *
+ *  Parameters
+ *   p_mdp
+ *   state
+ *   utilities
+ *   eu
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struc
+ *    0 <= state < p_mdp->numStates
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    eu points to a valid array of length p_mdp->numActions
+ *
+ *  Postconditions
+ *    eu[a] = calc_eu(p_mdp, state, utilities, a) for every action a,
+ *    computed in a single pass over the successors of state
+ */
+void calc_eu_all( const mdp* p_mdp, unsigned int state,
+		  const double* utilities, double *eu )
+{
+  unsigned int a;
+
+  // if a state has no successors, any action has no expected utility
+  if (p_mdp->terminal[state] || p_mdp->numAvailableActions[state] <= 0)
+  {
+    for (a = 0 ; a < p_mdp->numActions ; a++)
+      eu[a] = 0;
+    return;
+  }
+
+  sum_rows(p_mdp, state * p_mdp->numActions, p_mdp->numActions,
+	   utilities, eu);
+}
+
+/*  Procedure
+ *    calc_eu_batch
+ *
+ *  Purpose
+ *    Calculate the expected utility of every action in a state under
+ *    several utility vectors at once
+ *
+ *  Parameters
+ *   p_mdp
+ *   state
+ *   utilities
+ *   count
+ *   eu
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struc
+ *    0 <= state < p_mdp->numStates
+ *    utilities points to a valid array of p_mdp->numStates * count
+ *      doubles, holding the count utilities of state s at s*count
+ *    eu points to a valid array of p_mdp->numActions * count doubles
+ *
+ *  Postconditions
+ *    eu[a*count + k] is the expected utility of action a under the
+ *    utilities utilities[s*count + k], exactly as calc_eu_all computes
+ *    it for a single vector. Each transition is read once for all count
+ *    vectors.
+ */
+void calc_eu_batch( const mdp* p_mdp, unsigned int state,
+		    const double* utilities, unsigned int count, double *eu )
+{
+  unsigned int a, k, i, row, row_end;
+  const double *successor_utilities;
+  double *row_eu, prob;
+
+  for (i = 0 ; i < p_mdp->numActions * count ; i++)
+    eu[i] = 0;
+
+  // if a state has no successors, any action has no expected utility
+  if (p_mdp->terminal[state] || p_mdp->numAvailableActions[state] <= 0)
+    return;
+
+  row = state * p_mdp->numActions;
+
+  for (a = 0 ; a < p_mdp->numActions ; a++, row++)
+  {
+    row_eu = eu + a * count;
+    row_end = p_mdp->transitionStart[row + 1];
+
+    // Products are summed in successor order, matching sum_rows
+    for (i = p_mdp->transitionStart[row] ; i < row_end ; i++)
+    {
+      if (MDP_PRECISION_FLOAT == p_mdp->precision)
+	prob = p_mdp->transitionFloat[i];
+      else if (MDP_PRECISION_PALETTE == p_mdp->precision)
+	prob = p_mdp->palette[p_mdp->transitionIndex[i]];
+      else
+	prob = p_mdp->transitionProb[i];
+
+      successor_utilities = utilities + 
+	(size_t)p_mdp->successor[i] * count;
+
+      for (k = 0 ; k < count ; k++)
+	row_eu[k] += prob * successor_utilities[k];
+    }
+  }
+
+  eu_count += p_mdp->numActions * count;
 }
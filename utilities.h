@@ -93,4 +93,200 @@ double calc_eu( const mdp*  p_mdp, unsigned int state, const double* utilities,
 void calc_meu( const mdp*  p_mdp, unsigned int state, const double* utilities,
 	       double *meu, unsigned int *action );
 
+/*  Procedure
+ *    calc_meu_eliminate
+ *
+ *  Purpose
+ *    Calculate the action of maximum expected utility among a state's
+ *    remaining actions, dropping those that can no longer be optimal
+ *
+ *  Parameters
+ *   p_mdp
+ *   state
+ *   utilities
+ *   actions
+ *   numActions
+ *   margin
+ *   meu
+ *   action
+ *
+ *  Produces
+ *   kept, an unsigned int
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struc
+ *    0 <= state < p_mdp->numStates
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    actions points to numActions entries of p_mdp->actions[state]
+ *    margin >= 0 (INFINITY keeps every action)
+ *    meu != NULL
+ *    action != NULL
+ *
+ *  Postconditions
+ *    *meu is max_{a in actions} EU(state,a) and *action the first listed
+ *    action that yields it (0 and 0 when numActions is 0).
+ *    The first kept entries of actions are, in their original order,
+ *    the actions with EU(state,a) >= *meu - margin; *action is among
+ *    them. Only the listed actions' expected utilities are computed.
+ */
+unsigned int calc_meu_eliminate( const mdp* p_mdp, unsigned int state,
+				 const double* utilities, unsigned int* actions,
+				 unsigned int numActions, double margin,
+				 double *meu, unsigned int *action );
+
+/*  Procedure
+ *    calc_eu_all
+ *
+ *  Purpose
+ *    Calculate the expected utility of every action in a state of an MDP
+ *
+ *  Parameters
+ *   p_mdp
+ *   state
+ *   utilities
+ *   eu
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struc
+ *    0 <= state < p_mdp->numStates
+ *    utilities points to a valid array of length p_mdp->numStates
+ *    eu points to a valid array of length p_mdp->numActions
+ *
+ *  Postconditions
+ *    eu[a] = calc_eu(p_mdp, state, utilities, a) for every action a,
+ *    computed in a single pass over the successors of state
+ */
+void calc_eu_all( const mdp* p_mdp, unsigned int state,
+		  const double* utilities, double *eu );
+
+/*  Procedure
+ *    calc_eu_batch
+ *
+ *  Purpose
+ *    Calculate the expected utility of every action in a state under
+ *    several utility vectors at once
+ *
+ *  Parameters
+ *   p_mdp
+ *   state
+ *   utilities
+ *   count
+ *   eu
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Preconditions
+ *    p_mdp points to a valid mdp struc
+ *    0 <= state < p_mdp->numStates
+ *    utilities points to a valid array of p_mdp->numStates * count
+ *      doubles, holding the count utilities of state s at s*count
+ *    eu points to a valid array of p_mdp->numActions * count doubles
+ *
+ *  Postconditions
+ *    eu[a*count + k] is the expected utility of action a under the
+ *    utilities utilities[s*count + k], exactly as calc_eu_all computes
+ *    it for a single vector. Each transition is read once for all count
+ *    vectors.
+ */
+void calc_eu_batch( const mdp* p_mdp, unsigned int state,
+		    const double* utilities, unsigned int count, double *eu );
+
+/*  Procedure
+ *    calc_set_kernel
+ *
+ *  Purpose
+ *    Select the instruction set used to compute expected utilities
+ *
+ *  Parameters
+ *   name
+ *
+ *  Produces
+ *   ok, an int
+ *
+ *  Preconditions
+ *    name is NULL or one of "scalar", "avx2", "avx512"
+ *
+ *  Postconditions
+ *    When name is NULL, the widest kernel the processor supports is
+ *    selected. ok is nonzero when the requested kernel is selected, and
+ *    zero (leaving the selection unchanged) when it is unavailable.
+ *    By default the kernel is chosen on first use, honoring the
+ *    MDP_KERNEL environment variable. All kernels produce identical
+ *    results; they differ only in speed. The selection is published
+ *    whole, so threads computing expected utilities meanwhile use
+ *    either the old kernels or the new ones.
+ */
+int calc_set_kernel( const char* name );
+
+/*  Procedure
+ *    calc_init_kernel
+ *
+ *  Purpose
+ *    Choose the default kernel now rather than on first use
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    Unless calc_set_kernel already selected one, the kernel named by
+ *    MDP_KERNEL (or else the widest supported) is selected. Choosing
+ *    happens once however many threads call this, but solvers call it
+ *    before starting workers so the choice is never made mid-sweep.
+ */
+void calc_init_kernel( void );
+
+/*  Procedure
+ *    calc_kernel_name
+ *
+ *  Purpose
+ *    Name the instruction set used to compute expected utilities
+ *
+ *  Produces
+ *   name, a string
+ *
+ *  Postconditions
+ *    name is one of "scalar", "avx2", "avx512"
+ */
+const char* calc_kernel_name( void );
+
+/*  Procedure
+ *    calc_eu_count
+ *
+ *  Purpose
+ *    Count the expected utilities computed by the calling thread
+ *
+ *  Produces
+ *   count, an unsigned long
+ *
+ *  Postconditions
+ *    count is the number of state-action expected utilities computed
+ *    by calc_eu, calc_meu and calc_eu_all in the calling thread so far;
+ *    calc_meu counts every available action of the state and
+ *    calc_eu_all every action of the model. Solvers
+ *    difference the count around their work.
+ */
+unsigned long calc_eu_count( void );
+
+/*  Procedure
+ *    calc_eu_credit
+ *
+ *  Purpose
+ *    Add work done by other threads to the calling thread's count
+ *
+ *  Parameters
+ *   count
+ *
+ *  Produces
+ *   [Nothing.]
+ *
+ *  Postconditions
+ *    calc_eu_count() in the calling thread has grown by count, so that
+ *    a solver splitting work over a pool can report it from the caller
+ */
+void calc_eu_credit( unsigned long count );
+
 #endif // UTILITIES_H
@@ -1,110 +1,256 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <strings.h>
 #include <errno.h>
-#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
 
-#include "utilities.h"
+#include "sweep.h"
+#include "solver.h"
+#include "generate.h"
 #include "mdp.h"
 
 /*  Procedure
- *    value_iteration
+ *    read_rewards
  *
  *  Purpose
- *    Estimate utilities with iterative updates
+ *    Read a reward vector from a file
  *
  *  Parameters
- *   p_mdp
- *   epsilon
- *   gamma
- *   utilities
+ *   fileName
+ *   numStates
+ *   rewards
  *
  *  Produces,
  *   [Nothing.]
  *
  *  Preconditions
- *    p_mdp is a pointer to a valid, complete mdp
- *    utilities points to a valid array of length p_mdp->numStates
- *    epsilon > 0
- *    0 < gamma < 1
+ *    rewards points to a valid array of length numStates
  *
  *  Postconditions
- *    utilities[s] contains the estimated utility value for the given state
+ *    rewards holds the first numStates numbers in fileName.
+ *    Any failure causes program exit.
+ */
+static void read_rewards( const char* fileName, unsigned int numStates,
+			  double* rewards )
+{
+  FILE* stream;
+  unsigned int state;
+
+  stream = fopen(fileName, "r");
+
+  if (NULL == stream)
+  {
+    fprintf(stderr, "read_rewards(\"%s\") failed: %s\n", fileName,
+	    strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  for (state = 0 ; state < numStates ; state++)
+    if (1 != fscanf(stream, "%lf", rewards + state))
+    {
+      fprintf(stderr, "read_rewards(\"%s\") failed: %s\n", fileName,
+	      "Unable to match double for reward");
+      exit(EXIT_FAILURE);
+    }
+
+  fclose(stream);
+}
+
+/*  Procedure
+ *    read_states
  *
- *  Authors
- *    Daniel Nanetti-Palacios
- *    Tyler Dewey
+ *  Purpose
+ *    Read a list of states from a file
+ *
+ *  Parameters
+ *   fileName
+ *   numStates
+ *   p_count
+ *
+ *  Produces,
+ *   states, an unsigned int*
  *
- * Documentation adapted from Jerod Weinman's policy_iteration.c
- */ 
-void value_iteration( const mdp* p_mdp, double epsilon, double gamma,
-          double *utilities)
+ *  Postconditions
+ *    states holds the *p_count numbers in fileName, each less than
+ *    numStates; the caller frees it.
+ *    Any failure causes program exit.
+ */
+static unsigned int* read_states( const char* fileName, unsigned int numStates,
+				  unsigned int* p_count )
 {
-  // Run value iteration!
+  FILE* stream;
+  unsigned int *states = NULL, *grown, capacity = 0, state;
+  int matched;
 
-  double *updated_utilities;
-  double max_utilities_change, utilities_change;
-  unsigned int state, num_states;
-  size_t utilities_size;
+  stream = fopen(fileName, "r");
 
-  num_states = p_mdp->numStates;
-  utilities_size = sizeof(double) * num_states;
+  if (NULL == stream)
+  {
+    fprintf(stderr, "read_states(\"%s\") failed: %s\n", fileName,
+	    strerror(errno));
+    exit(EXIT_FAILURE);
+  }
 
-  updated_utilities = malloc(utilities_size);
-  bzero(updated_utilities, utilities_size);
+  *p_count = 0;
 
-  do 
+  while (1 == (matched = fscanf(stream, "%u", &state)))
   {
-    // update the old utilities
-    memcpy(utilities, updated_utilities, utilities_size);
-    max_utilities_change = 0;
-
-    for ( state = 0; state < num_states ; state++ )
+    if (state >= numStates)
     {
-      double meu;
-      unsigned int action;
-
-      if (p_mdp->terminal[state]) // if this is a terminal state
-      { 
-        // then the utility should be just the reward
-        updated_utilities[state] = p_mdp->rewards[state];
-      }
-      else
-      { 
-        // otherwise, it is reward + discount_rate * meu
-        calc_meu(p_mdp, state, utilities, &meu, &action);
+      fprintf(stderr, "read_states(\"%s\") failed: %s %u\n", fileName,
+	      "State out of range:", state);
+      exit(EXIT_FAILURE);
+    }
 
-        updated_utilities[state] = p_mdp->rewards[state] + gamma * meu;
-      }
-      
-      utilities_change = fabs(updated_utilities[state] - utilities[state]);
+    if (*p_count == capacity)
+    {
+      capacity = capacity ? 2 * capacity : 64;
+      grown = realloc(states, sizeof(unsigned int) * capacity);
 
-      if (utilities_change > max_utilities_change)
+      if (NULL == grown)
       {
-        max_utilities_change = utilities_change;
+	fprintf(stderr, "read_states(\"%s\") failed: %s\n", fileName,
+		strerror(errno));
+	exit(EXIT_FAILURE);
       }
+
+      states = grown;
     }
-  } while(!(max_utilities_change < (epsilon * (1 - gamma) / gamma)));
 
-  // Clean up
-  free(updated_utilities);
-}
+    states[(*p_count)++] = state;
+  }
+
+  if (EOF != matched)
+  {
+    fprintf(stderr, "read_states(\"%s\") failed: %s\n", fileName,
+	    "Unable to match unsigned int for state");
+    exit(EXIT_FAILURE);
+  }
 
+  fclose(stream);
+
+  // An empty list still means "nothing changed", not "check everything"
+  return states ? states : malloc(sizeof(unsigned int));
+}
 
 /*
- * Main: value_iteration gamma epsilon mdpfile
+ * Main: value_iteration [-j threads] [-m mode] [-r rewardfile ...]
+ *                       [-w utilityfile [-c changedfile]]
+ *                       [--precision=storage] [--eliminate] [--stats]
+ *                       [--lazy [--cache=states]]
+ *                       gamma[,gamma...] epsilon mdpfile
  *
  * Runs value_iteration algorithm using gamma and with max
- * error of epsilon on utilities of states using MDP in mdpfile.
+ * error of epsilon on utilities of states using MDP in mdpfile,
+ * splitting each sweep over the given number of threads (default 1).
+ * mode is jacobi (default), gauss-seidel, prioritized, async or topological
+ * (strongly connected components solved in turn, successors first). With
+ * --stats, the residual, time and work of each sweep are printed to stderr.
+ *
+ * Several comma-separated discounts, or one or more -r files each holding
+ * a reward per state, are solved together in one batch of Jacobi sweeps;
+ * a single discount or reward vector is shared by every problem. Each
+ * line of output then holds one state's utility in every problem.
+ *
+ * With -w, updates start from the utilities in utilityfile (e.g., the
+ * output of an earlier run) in prioritized order, which runs in one
+ * thread; -m may then only be prioritized. If changedfile lists the
+ * states whose rewards or transitions were edited since utilityfile was
+ * solved, only those states and their predecessors are checked first,
+ * so small edits are re-solved in a small number of updates.
+ *
+ * --precision=float or --precision=palette stores the transition
+ * probabilities in single precision or as byte indices into a table of
+ * their distinct values (see mdp_set_precision); double is the default.
+ *
+ * --eliminate runs jacobi sweeps that drop actions once bounds on the
+ * utilities prove them suboptimal (see value_iteration_eliminate), so
+ * models with many actions per state need less work per sweep; --stats
+ * then reports the actions eliminated in each sweep as changes.
+ *
+ * With --lazy, mdpfile is instead grid:WIDTH:HEIGHT, the grid world of
+ * mdp_generate_grid, whose transitions are generated as each state is
+ * updated rather than stored (see lazy_value_iteration), so grids of
+ * tens of millions of states fit in memory. --cache keeps the given
+ * number of generated states (split between threads) for reuse.
  *
  * Author: Jerod Weinman
  */
 int main(int argc, char* argv[])
 {
-  if (argc != 4)
+  unsigned int num_threads = 1;
+  sweep_mode mode = SWEEP_JACOBI;
+  static const struct option long_options[] = {
+    { "stats", no_argument, NULL, 'S' },
+    { "precision", required_argument, NULL, 'P' },
+    { "eliminate", no_argument, NULL, 'E' },
+    { "lazy", no_argument, NULL, 'L' },
+    { "cache", required_argument, NULL, 'C' },
+    { NULL, 0, NULL, 0 }
+  };
+  int stats = 0, eliminate = 0, lazy = 0, mode_given = 0;
+  unsigned int cache_states = 0;
+  mdp_precision precision = MDP_PRECISION_DOUBLE;
+  int opt, bad_option = 0;
+  const char * reward_files[argc];
+  unsigned int num_rewards = 0;
+  const char * warm_file = NULL, * changed_file = NULL;
+
+  while ((opt = getopt_long(argc, argv, "j:m:r:w:c:", long_options, NULL)) 
+	 != -1)
+  {
+    switch (opt)
+    {
+    case 'j':
+      num_threads = (unsigned int) strtoul(optarg, NULL, 10);
+      bad_option |= (0 == num_threads);
+      break;
+    case 'm':
+      bad_option |= !sweep_mode_parse(optarg, &mode);
+      mode_given = 1;
+      break;
+    case 'r':
+      reward_files[num_rewards++] = optarg;
+      break;
+    case 'w':
+      warm_file = optarg;
+      break;
+    case 'c':
+      changed_file = optarg;
+      break;
+    case 'P':
+      bad_option |= !mdp_precision_parse(optarg, &precision);
+      break;
+    case 'E':
+      eliminate = 1;
+      break;
+    case 'L':
+      lazy = 1;
+      break;
+    case 'C':
+      cache_states = (unsigned int) strtoul(optarg, NULL, 10);
+      break;
+    case 'S':
+      stats = 1;
+      break;
+    default:
+      bad_option = 1;
+    }
+  }
+
+  // Shift past the options so positional arguments start at argv[1]
+  argv[optind - 1] = argv[0];
+  argv += optind - 1;
+  argc -= optind - 1;
+
+  if (bad_option || (changed_file && !warm_file) || argc != 4)
   {
-    fprintf(stderr,"Usage: %s gamma epsilon mdpfile\n",argv[0]);
+    fprintf(stderr,"Usage: %s [-j threads] [-m mode] [-r rewardfile ...] "
+	    "[-w utilityfile [-c changedfile]] [--precision=storage] "
+	    "[--eliminate] [--stats] [--lazy [--cache=states]] "
+	    "gamma[,gamma...] epsilon mdpfile\n", argv[0]);
     exit(EXIT_FAILURE);
   }
 
@@ -112,17 +258,62 @@ int main(int argc, char* argv[])
   double gamma, epsilon;
   char* endptr; // String End Location for number parsing
   mdp *p_mdp;
+  solver_context *p_ctx;
+  double gammas[strlen(argv[1]) / 2 + 1];
+  unsigned int num_gammas, count;
 
-  // Read gamma, the discount factor, as a double
-  gamma = strtod(argv[1], &endptr);
+  // Read gamma, the discount factor, as a list of doubles
+  endptr = argv[1] - 1;
+  num_gammas = 0;
 
-  if ( (endptr - argv[1]) < strlen(argv[1]) )
+  do
+    gammas[num_gammas++] = strtod(endptr + 1, &endptr);
+  while (',' == *endptr);
+
+  if ( '\0' != *endptr )
   {
     fprintf(stderr, "%s: Illegal non-numeric value in argument gamma=%s\n",
             argv[0],argv[1]);
       exit(EXIT_FAILURE);
   }
 
+  gamma = gammas[0];
+  count = (num_gammas > num_rewards) ? num_gammas : num_rewards;
+
+  if ( (num_gammas > 1 && num_gammas != count) || 
+       (num_rewards > 1 && num_rewards != count) )
+  {
+    fprintf(stderr, "%s: %u discounts do not match %u reward files\n",
+            argv[0], num_gammas, num_rewards);
+      exit(EXIT_FAILURE);
+  }
+
+  if ( count > 1 && SWEEP_JACOBI != mode )
+  {
+    fprintf(stderr, "%s: Batches require jacobi mode\n", argv[0]);
+      exit(EXIT_FAILURE);
+  }
+
+  if ( count > 1 && warm_file )
+  {
+    fprintf(stderr, "%s: Batches cannot start from utilities\n", argv[0]);
+      exit(EXIT_FAILURE);
+  }
+
+  if ( warm_file && mode_given && SWEEP_PRIORITIZED != mode )
+  {
+    fprintf(stderr, "%s: Starting from utilities requires prioritized mode\n",
+	    argv[0]);
+      exit(EXIT_FAILURE);
+  }
+
+  if ( eliminate && (count > 1 || warm_file || SWEEP_JACOBI != mode) )
+  {
+    fprintf(stderr, "%s: Elimination requires jacobi mode and one problem\n",
+	    argv[0]);
+      exit(EXIT_FAILURE);
+  }
+
   // Read epsilon, maximum allowable state utility error, as a double
   epsilon = strtod(argv[2], &endptr); 
 
@@ -133,6 +324,57 @@ int main(int argc, char* argv[])
       exit(EXIT_FAILURE);
   }
 
+  if ( lazy )
+  { // Generate the model's transitions as they are needed
+    unsigned int width, height, state;
+    lazy_mdp * p_lazy;
+    double * utilities;
+    char tail;
+
+    if ( count > 1 || warm_file || eliminate ||
+	 MDP_PRECISION_DOUBLE != precision )
+    {
+      fprintf(stderr, "%s: Lazy models solve one problem in double "
+	      "precision\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+
+    if ( 2 != sscanf(argv[3], "grid:%u:%u%c", &width, &height, &tail) ||
+	 0 == width || 0 == height || height > UINT_MAX / width )
+    {
+      fprintf(stderr, "%s: Unrecognized lazy model %s\n", argv[0], argv[3]);
+      exit(EXIT_FAILURE);
+    }
+
+    p_lazy = mdp_generate_lazy_grid(width, height);
+    utilities = malloc( sizeof(double) * p_lazy->numStates );
+
+    if (NULL == utilities)
+    {
+      fprintf(stderr,
+	      "%s: Unable to allocate utilities (%s)",
+	      argv[0],
+	      strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    p_ctx = solver_context_create(num_threads);
+
+    lazy_value_iteration( p_ctx, p_lazy, cache_states, epsilon, gamma,
+			  utilities, mode, stats ? solver_print_stats : NULL,
+			  stderr );
+
+    solver_context_free(p_ctx);
+
+    for ( state=0 ; state < p_lazy->numStates ; state++)
+      printf("%f\n", utilities[state]);
+
+    free(utilities);
+    lazy_mdp_free(p_lazy);
+
+    exit(EXIT_SUCCESS);
+  }
+
   // Read the MDP file (exits with message if error)
   p_mdp = mdp_read(argv[3]);
 
@@ -141,10 +383,23 @@ int main(int argc, char* argv[])
     exit(EXIT_FAILURE);
   }
 
+  // Store transitions as requested, reporting the rounding when asked
+  double storage_error;
+
+  if (!mdp_set_precision(p_mdp, precision, &storage_error))
+  {
+    fprintf(stderr, "%s: Too many distinct probabilities for a palette\n",
+	    argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  if (stats && MDP_PRECISION_DOUBLE != precision)
+    fprintf(stderr, "largest transition row error %g\n", storage_error);
+
   // Allocate utility array
   double * utilities;
 
-  utilities = malloc( sizeof(double) * p_mdp->numStates );
+  utilities = malloc( sizeof(double) * p_mdp->numStates * count );
 
   // Verify we have memory for utility array
   if (NULL == utilities)
@@ -157,14 +412,83 @@ int main(int argc, char* argv[])
   }
 
   // Run value iteration!
-  value_iteration( p_mdp, epsilon, gamma, utilities );
+  p_ctx = solver_context_create(num_threads);
+
+  double * rewards = NULL;
+  unsigned int state, k;
+
+  if (NULL != warm_file)
+  {
+    FILE * stream = fopen(warm_file, "r");
+    unsigned int * changed = NULL, num_changed = 0;
+
+    if (NULL == stream)
+    {
+      fprintf(stderr, "%s: Unable to open %s (%s)\n", argv[0], warm_file,
+	      strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    mdp_read_utilities(stream, p_mdp, utilities);
+    fclose(stream);
+
+    if (NULL != changed_file)
+      changed = read_states(changed_file, p_mdp->numStates, &num_changed);
+
+    value_iteration_resume( p_ctx, p_mdp, epsilon, gamma, utilities, changed,
+			    num_changed, stats ? solver_print_stats : NULL,
+			    stderr );
+    free(changed);
+  }
+  else if (eliminate)
+    value_iteration_eliminate( p_ctx, p_mdp, epsilon, gamma, utilities,
+			       stats ? solver_print_stats : NULL, stderr );
+  else if (1 == num_gammas && 0 == num_rewards)
+    value_iteration( p_ctx, p_mdp, epsilon, gamma, utilities, mode,
+		     stats ? solver_print_stats : NULL, stderr );
+  else
+  {
+    // Broadcast a lone discount or reward vector over the batch
+    for (k = num_gammas ; k < count ; k++)
+      gammas[k] = gamma;
+
+    if (num_rewards > 0)
+    {
+      rewards = malloc( sizeof(double) * p_mdp->numStates * count );
+
+      if (NULL == rewards)
+      {
+	fprintf(stderr,
+		"%s: Unable to allocate rewards (%s)",
+		argv[0],
+		strerror(errno));
+	exit(EXIT_FAILURE);
+      }
+
+      for (k = 0 ; k < count ; k++)
+	if (k < num_rewards)
+	  read_rewards( reward_files[k], p_mdp->numStates,
+			rewards + (size_t)k * p_mdp->numStates );
+	else
+	  memcpy( rewards + (size_t)k * p_mdp->numStates, rewards,
+		  sizeof(double) * p_mdp->numStates );
+    }
+
+    value_iteration_batch( p_ctx, p_mdp, count, gammas, rewards, epsilon,
+			   utilities, stats ? solver_print_stats : NULL, 
+			   stderr );
+  }
+
+  solver_context_free(p_ctx);
 
   // Print utilities
-  unsigned int state;
   for ( state=0 ; state < p_mdp->numStates ; state++)
-    printf("%f\n",utilities[state]);
+    for ( k=0 ; k < count ; k++ )
+      printf((k + 1 < count) ? "%f " : "%f\n", 
+	     utilities[(size_t)state * count + k]);
   
   // Clean up
+  free (rewards);
   free (utilities);
   mdp_free(p_mdp);
 